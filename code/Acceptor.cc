@@ -0,0 +1,136 @@
+#include "Acceptor.h"
+
+#include <cassert>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Channel.h"
+#include "EventLoop.h"
+#include "macros.h"
+#include "utils.h"
+#include "config.h"
+
+namespace webserver
+{
+
+Acceptor::Acceptor(EventLoop *loop, const InetAddress &addr, bool reusePort)
+	: loop_(loop),
+	  listenFd_(utils::SocketBindListen(addr, reusePort)),	// SO_REUSEADDR(及SO_REUSEPORT)在bind之前设置
+	  acceptChannel_(new Channel(listenFd_, loop_)),
+	  idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),	// 打开空闲文件描述符
+	  listening_(false),
+	  accepted_(0),
+	  bursts_(0),
+	  burstQueued_(false)
+{
+	assert(listenFd_ > 0);
+	assert(idleFd_ > 0);
+}
+
+Acceptor::~Acceptor()
+{
+	::close(idleFd_);
+}
+
+void Acceptor::listen()
+{
+	assert(loop_->isInLoopThread());
+	assert(!listening_);
+	assert(newConnectionCallback_);
+	listening_ = true;
+
+	acceptChannel_->setReadCallback(std::bind(&Acceptor::handleRead, this));
+	if(loop_->completionIo())
+	{
+		/* multishot accept，每个连接一个完成事件，不再循环accept4 */
+		acceptChannel_->setAcceptCallback(std::bind(&Acceptor::onAccept, this, std::placeholders::_1));
+	}
+	acceptChannel_->enableReading();
+}
+
+// 使用非阻塞的 AcceptNb 方法接受新连接，并以边缘触发模式进行处理。
+void Acceptor::handleRead()
+{
+	InetAddress addr(0);
+	int connfd;
+	int inBurst = 0;
+
+	//edge trigger mode
+	for(;;)
+	{
+		/* 只有accept失败时errno才有意义，dropConnection之后它可能是旧值 */
+		connfd = utils::AcceptNb(listenFd_, addr);
+		if(connfd < 0)
+		{
+			/* File descriptor exhausted, per process or system-wide.
+			   accept先分配描述符再检查监听队列，队列为空时仍返回EMFILE，丢弃失败即结束 */
+			if(unlikely(errno == EMFILE || errno == ENFILE) && dropConnection())
+			{
+				continue;
+			}
+			break;
+		}
+
+		countAccepted();
+		newConnectionCallback_(connfd);
+
+#ifdef DEBUG
+	printf("fd=%d, %s1\n", connfd, addr.toIpPortString().c_str());
+#endif // DEBUG
+
+		if(++inBurst == kMaxBurst)
+		{
+			endBurst();
+			inBurst = 0;
+		}
+	}
+	
+	if(inBurst > 0)
+	{
+		endBurst();
+	}
+}
+
+void Acceptor::onAccept(int connfd)
+{
+	if(likely(connfd > 0))
+	{
+		countAccepted();
+		newConnectionCallback_(connfd);
+		
+		/* 排队的回调在本轮事件处理完之后执行，同一轮accept的连接成为一批 */
+		if(burstEndCallback_ && !burstQueued_)
+		{
+			burstQueued_ = true;
+			loop_->queueInLoop(std::bind(&Acceptor::endBurst, this));
+		}
+	}
+	else if(connfd == -EMFILE || connfd == -ENFILE)
+	{
+		dropConnection();
+	}
+}
+
+void Acceptor::endBurst()
+{
+	burstQueued_ = false;
+	if(burstEndCallback_)
+	{
+		++bursts_;
+		burstEndCallback_();
+	}
+}
+
+// 通过关闭一个空闲文件描述符并重新打开它，接受并关闭一个连接，避免ET模式下的忙循环。
+bool Acceptor::dropConnection()
+{
+	::close(idleFd_);
+	int connfd = ::accept(listenFd_, NULL, NULL);
+	if(connfd >= 0) ::close(connfd);
+	idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+	return connfd >= 0;
+}
+
+} //namespace webserver
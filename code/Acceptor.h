@@ -0,0 +1,91 @@
+#ifndef code_Acceptor_h
+#define code_Acceptor_h
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "InetAddress.h"
+#include "SmallFunction.h"
+#include "noncopyable.h"
+
+namespace webserver
+{
+
+class Channel;
+class EventLoop;
+
+/*
+ * listening socket bound to one event loop
+ *   epoll: edge-triggered accept4 loop; io_uring: multishot accept
+ *   EMFILE: close a reserved fd, accept and drop the connection
+ * with reusePort every loop may own one, the kernel spreads incoming
+ * connections over the SO_REUSEPORT group
+ */
+// 绑定在某个事件循环上的监听套接字
+// epoll：边缘触发，循环accept4；io_uring：multishot accept
+// 文件描述符耗尽时，关闭预留的fd，接受并立即关闭一个连接
+// reusePort时每个事件循环可以各有一个，由内核在SO_REUSEPORT组内分配新连接
+class Acceptor : noncopyable
+{
+public:
+	typedef SmallFunction<void (int connfd)> NewConnectionCallback;
+	typedef SmallFunction<void ()> BurstEndCallback;
+
+	/* epoll下一次可读事件中每accept这么多连接就结束一批，积压很深时先到的连接不必等全部accept完 */
+	static const int kMaxBurst = 64;
+
+	/* 创建、绑定并监听，绑定失败时打印错误(Bind:) */
+	Acceptor(EventLoop *loop, const InetAddress &addr, bool reusePort);
+	/* 须在所属事件循环的线程中析构，或在其退出之后 */
+	~Acceptor();
+
+	void setNewConnectionCallback(NewConnectionCallback cb)
+	{ newConnectionCallback_ = std::move(cb); }
+	/* 一批连接(一次可读事件中至多kMaxBurst个，或io_uring同一轮的完成事件)逐个交给上面的回调之后调用一次，
+	   可在此把攒下的连接成批转交 */
+	void setBurstEndCallback(BurstEndCallback cb)
+	{ burstEndCallback_ = std::move(cb); }
+
+	/* 开始接受连接，在所属事件循环的线程中调用 */
+	void listen();
+
+	int listenFd() const { return listenFd_; }
+	EventLoop *ownerLoop() const { return loop_; }
+	/* 已接受的连接数，只在所属线程中修改，可在任意线程中读取 */
+	uint64_t accepted() const { return accepted_.load(std::memory_order_relaxed); }
+	/* 调用burstEndCallback_的次数 */
+	uint64_t bursts() const { return bursts_; }
+
+private:
+	// 每次listenfd可读时调用
+	void handleRead();
+	// io_uring代为accept时，每个新连接(或-errno)调用一次
+	void onAccept(int connfd);
+	// 文件描述符耗尽时，接受并立即关闭一个连接；监听队列已空时返回false
+	bool dropConnection();
+	// 一批连接结束
+	void endBurst();
+	// 只有所属线程写，不需要原子的读-改-写
+	void countAccepted()
+	{ accepted_.store(accepted_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+private:
+	EventLoop *loop_;
+	int listenFd_;
+	// 监听fd的Channel，负责关闭listenFd_
+	std::shared_ptr<Channel> acceptChannel_;
+	// 预留的空闲文件描述符
+	int idleFd_;
+	bool listening_;
+	std::atomic<uint64_t> accepted_;
+	uint64_t bursts_;
+	// io_uring下已排队endBurst，本轮后续的完成事件属于同一批
+	bool burstQueued_;
+	NewConnectionCallback newConnectionCallback_;
+	BurstEndCallback burstEndCallback_;
+};
+
+} //namespace webserver
+
+#endif
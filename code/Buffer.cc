@@ -0,0 +1,66 @@
+#include "Buffer.h"
+
+#include <cerrno>
+
+#include <sys/uio.h>
+
+#include "macros.h"
+
+namespace webserver
+{
+
+const char Buffer::kCRLF[] = "\r\n";
+
+/* ET mode下由上层循环调用，直到EAGAIN */
+/* 缓冲区可写空间 + 64KB栈空间，一次readv尽量读完内核缓冲区 */
+ssize_t Buffer::readFd(int fd, int *savedErrno)
+{
+	char extrabuf[kExtraBufSize];
+	struct iovec vec[2];
+	const size_t writable = writableBytes();
+
+	vec[0].iov_base = beginWrite();
+	vec[0].iov_len = writable;
+	vec[1].iov_base = extrabuf;
+	vec[1].iov_len = sizeof(extrabuf);
+
+	/* 可写空间已经足够大时，不再使用栈空间 */
+	const int iovcnt = (writable < sizeof(extrabuf)) ? 2 : 1;
+	const ssize_t n = ::readv(fd, vec, iovcnt);
+	if(unlikely(n < 0))
+	{
+		*savedErrno = errno;
+	}
+	else if(static_cast<size_t>(n) <= writable)
+	{
+		writerIndex_ += n;
+	}
+	else
+	{
+		writerIndex_ = buffer_.size();
+		append(extrabuf, n - writable);
+	}
+
+	return n;
+}
+
+void Buffer::makeSpace(size_t len)
+{
+	if(writableBytes() + prependableBytes() < len + kCheapPrepend)
+	{
+		/* 空间不足，扩容 */
+		buffer_.resize(writerIndex_ + len);
+	}
+	else
+	{
+		/* 数据前移，复用已取走的空间 */
+		size_t readable = readableBytes();
+		std::copy(begin()+readerIndex_, begin()+writerIndex_,
+		          begin()+kCheapPrepend);
+		readerIndex_ = kCheapPrepend;
+		writerIndex_ = readerIndex_ + readable;
+		assert(readable == readableBytes());
+	}
+}
+
+} //namespace webserver
@@ -0,0 +1,172 @@
+#ifndef code_Buffer_h
+#define code_Buffer_h
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <sys/types.h>
+
+namespace webserver
+{
+
+/*
+ * growable I/O buffer
+ * +-------------------+------------------+------------------+
+ * | prependable bytes |  readable bytes  |  writable bytes  |
+ * |                   |     (CONTENT)    |                  |
+ * +-------------------+------------------+------------------+
+ * |                   |                  |                  |
+ * 0      <=      readerIndex   <=   writerIndex    <=     size
+ */
+// 网络I/O缓冲区
+// 读写下标分离：取走数据只移动readerIndex_，不拷贝、不释放
+// 空间不足时优先挪动已有数据到头部，否则扩容
+class Buffer
+{
+public:
+	// 头部预留空间，便于在数据前追加长度等信息
+	static const size_t kCheapPrepend = 8;
+	static const size_t kInitialSize = 1024;
+	// readFd时栈上溢出区大小
+	static const size_t kExtraBufSize = 65536;
+
+	explicit Buffer(size_t initialSize = kInitialSize)
+		: buffer_(kCheapPrepend + initialSize),
+		  readerIndex_(kCheapPrepend),
+		  writerIndex_(kCheapPrepend)
+	{}
+
+	size_t readableBytes() const { return writerIndex_ - readerIndex_; }
+	size_t writableBytes() const { return buffer_.size() - writerIndex_; }
+	size_t prependableBytes() const { return readerIndex_; }
+
+	// 可读数据的起始位置
+	const char *peek() const { return begin() + readerIndex_; }
+	char *peek() { return begin() + readerIndex_; }
+	char *beginWrite() { return begin() + writerIndex_; }
+	const char *beginWrite() const { return begin() + writerIndex_; }
+
+	/* 取走数据，仅移动下标 */
+	void retrieve(size_t len)
+	{
+		assert(len <= readableBytes());
+		if(len < readableBytes())
+		{
+			readerIndex_ += len;
+		}
+		else
+		{
+			retrieveAll();
+		}
+	}
+
+	void retrieveUntil(const char *end)
+	{
+		assert(peek() <= end);
+		assert(end <= beginWrite());
+		retrieve(end - peek());
+	}
+
+	void retrieveAll()
+	{
+		readerIndex_ = kCheapPrepend;
+		writerIndex_ = kCheapPrepend;
+	}
+
+	std::string retrieveAsString(size_t len)
+	{
+		assert(len <= readableBytes());
+		std::string result(peek(), len);
+		retrieve(len);
+		return result;
+	}
+
+	std::string retrieveAllAsString()
+	{ return retrieveAsString(readableBytes()); }
+
+	void append(const char *data, size_t len)
+	{
+		ensureWritableBytes(len);
+		std::copy(data, data+len, beginWrite());
+		hasWritten(len);
+	}
+
+	void append(const void *data, size_t len)
+	{ append(static_cast<const char *>(data), len); }
+
+	void append(const std::string &str)
+	{ append(str.data(), str.size()); }
+
+	void ensureWritableBytes(size_t len)
+	{
+		if(writableBytes() < len)
+		{
+			makeSpace(len);
+		}
+		assert(writableBytes() >= len);
+	}
+
+	void hasWritten(size_t len)
+	{
+		assert(len <= writableBytes());
+		writerIndex_ += len;
+	}
+
+	/* 撤销末尾len字节的写入 */
+	void unwrite(size_t len)
+	{
+		assert(len <= readableBytes());
+		writerIndex_ -= len;
+	}
+
+	/* 在可读数据前插入 */
+	void prepend(const void *data, size_t len)
+	{
+		assert(len <= prependableBytes());
+		readerIndex_ -= len;
+		const char *d = static_cast<const char *>(data);
+		std::copy(d, d+len, begin()+readerIndex_);
+	}
+
+	/* 查找"\r\n"，找不到返回nullptr */
+	const char *findCRLF() const
+	{ return findCRLF(peek()); }
+
+	const char *findCRLF(const char *start) const
+	{
+		assert(peek() <= start);
+		assert(start <= beginWrite());
+		const char *crlf = std::search(start, beginWrite(), kCRLF, kCRLF+2);
+		return crlf == beginWrite() ? nullptr : crlf;
+	}
+
+	/* 从fd读入数据，直接读到缓冲区，多余部分先读到栈上再追加 */
+	ssize_t readFd(int fd, int *savedErrno);
+
+	void swap(Buffer &rhs)
+	{
+		buffer_.swap(rhs.buffer_);
+		std::swap(readerIndex_, rhs.readerIndex_);
+		std::swap(writerIndex_, rhs.writerIndex_);
+	}
+
+private:
+	char *begin() { return &*buffer_.begin(); }
+	const char *begin() const { return &*buffer_.begin(); }
+
+	void makeSpace(size_t len);
+
+private:
+	std::vector<char> buffer_;
+	size_t readerIndex_;
+	size_t writerIndex_;
+
+	static const char kCRLF[];
+};
+
+} //namespace webserver
+
+#endif
@@ -13,14 +13,19 @@ Channel::Channel(int fd, EventLoop *loop)
 	: fd_(fd),
 	  events_(0),
 	  revents_(0),
-	  loop_(loop)	// 是Main函数中的 mainLoop_主循环 将监听的任务交给主函数 传入 Channel对象
+	  registeredEvents_(kNotRegistered),
+	  dirty_(false),
+	  ownsFd_(true),
+	  loop_(loop),	// 是Main函数中的 mainLoop_主循环 将监听的任务交给主函数 传入 Channel对象
+	  sendResult_(0),
+	  hasSendResult_(false)
 {}
 
 /* Channel负责关闭文件描述符 */
 Channel::~Channel()
 {
 	//printf("dtor channel\n");
-	utils::Close(fd_);
+	if(ownsFd_) utils::Close(fd_);
 }
 
 /* event dispatcher */
@@ -58,11 +63,10 @@ void Channel::handleEvent()
 }
 
 /* update state of the Channel in poller */
-/* may be ineffecient */
 // 更新函数
-// 调用 EventLoop 对象的 updateChannel 方法，以更新通道在轮询器中的状态。
-// 该函数使用 shared_from_this() 返回当前对象的 shared_ptr，以确保对象在更新期间不被销毁。
-// 注释中提到这可能是不高效的，因为这个操作可能会导致频繁的共享指针的创建和销毁。
+// 只在EventLoop中登记为待提交，一轮中多次enable/disable只产生一次epoll_ctl，
+// 最终与已登记的事件相同时不产生系统调用。
+// 已登记的Channel不再调用shared_from_this()。
 void Channel::update(void)
 {
 
@@ -70,9 +74,7 @@ void Channel::update(void)
 	printf("void Channel::update(void) \n");
 #endif // CHANNELDEBUG
 
-	// 调用更新Channel 参数是 本身对象
-	// 在这个里面调用 处理 handleEvent
-	loop_->updateChannel(shared_from_this());
+	loop_->updateChannel(this);
 }
  
 } //webserver
@@ -4,8 +4,12 @@
 #include <memory>
 #include <functional>
 
+#include <sys/types.h>
+
 #include <sys/epoll.h>
 
+#include "SmallFunction.h"
+
 namespace webserver
 {
 
@@ -26,7 +30,11 @@ struct channelCmp;
 class Channel : public std::enable_shared_from_this<Channel>
 {
 public:
-	typedef std::function<void ()> EventCallback;
+	typedef SmallFunction<void ()> EventCallback;
+	/* 完成式I/O(io_uring)：Poller代为recv，len为0表示对端关闭 */
+	typedef SmallFunction<void (const char *data, size_t len)> RecvCallback;
+	/* 完成式I/O(io_uring)：Poller代为accept，出错时为-errno */
+	typedef SmallFunction<void (int connfd)> AcceptCallback;
 
 	Channel(int fd, EventLoop *loop);
 	~Channel();
@@ -55,6 +63,29 @@ public:
 	void setErrorCallback(EventCallback cb)
 	{ errorCallback_ = std::move(cb); }
 	
+	// 仅在Poller支持完成式I/O时设置，Poller据此选择recv/accept代替可读通知
+	void setRecvCallback(RecvCallback cb)
+	{ recvCallback_ = std::move(cb); }
+	void setAcceptCallback(AcceptCallback cb)
+	{ acceptCallback_ = std::move(cb); }
+	bool hasRecvCallback() const { return static_cast<bool>(recvCallback_); }
+	bool hasAcceptCallback() const { return static_cast<bool>(acceptCallback_); }
+	
+	/* 由Poller在收割完成事件时调用 */
+	void handleRecv(const char *data, size_t len) { recvCallback_(data, len); }
+	void handleAccept(int connfd) { acceptCallback_(connfd); }
+	
+	/* 异步发送的结果，写回调中取走，<0为-errno */
+	void setSendResult(ssize_t result)
+	{ sendResult_ = result; hasSendResult_ = true; }
+	bool takeSendResult(ssize_t *result)
+	{
+		if(!hasSendResult_) return false;
+		*result = sendResult_;
+		hasSendResult_ = false;
+		return true;
+	}
+	
 	// 获取事件和状态信息的函数
 	int getFd() const { return fd_; }
 	int events() const { return events_; }
@@ -62,6 +93,14 @@ public:
 	void set_revents(int revt) { revents_ = revt; }
 	bool isNoneEvent() const { return events_ == kNoneEvent; }
 	
+	/* 兴趣集合的修改只做标记，由EventLoop在下一次poll之前统一提交 */
+	bool isDirty() const { return dirty_; }
+	void setDirty(bool dirty) { dirty_ = dirty; }
+	/* 已提交给Poller的兴趣集合，未加入Poller时为kNotRegistered */
+	int registeredEvents() const { return registeredEvents_; }
+	void setRegisteredEvents(int events) { registeredEvents_ = events; }
+	static const int kNotRegistered = -1;
+	
 	// 启用或禁用事件的函数
 	void enableReading() 
 	{ events_ |= (kReadEvent | EPOLLET); update(); }
@@ -92,6 +131,9 @@ public:
 	bool isEnableWriting() const
 	{ return events_ & kWriteEvent; }
 
+	// 析构时不再关闭文件描述符，连接迁移到其他事件循环时使用
+	void releaseFd() { ownsFd_ = false; }
+	
 	// Channel 拥有者是哪个 事件循环
 	EventLoop *ownerLoop() const 
 	{ return loop_; }
@@ -106,6 +148,12 @@ private:
 	int events_;
 	// 实际发生的事件。
 	int revents_;
+	// Poller中登记的事件。
+	int registeredEvents_;
+	// events_已修改，尚未提交。
+	bool dirty_;
+	// 析构时是否关闭fd_。
+	bool ownsFd_;
 	EventLoop * const loop_;
 	
 	// 四个回调函数
@@ -113,6 +161,11 @@ private:
 	EventCallback writeCallback_;
 	EventCallback closeCallback_;
 	EventCallback errorCallback_;
+	RecvCallback recvCallback_;
+	AcceptCallback acceptCallback_;
+	
+	ssize_t sendResult_;
+	bool hasSendResult_;
 	
 	/* ET mode */
 	// 不同类型事件的常量。
@@ -0,0 +1,370 @@
+#include "ContentCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <functional>
+#include <iterator>
+
+#include <unistd.h>
+
+#include "macros.h"
+
+namespace webserver
+{
+
+FrequencySketch::FrequencySketch(size_t expectedEntries)
+	: width_(64),
+	  samples_(0)
+{
+	while(width_ < expectedEntries) width_ <<= 1;
+	table_.assign(kDepth * width_, 0);
+	sampleSize_ = 10 * width_;
+}
+
+size_t FrequencySketch::indexOf(size_t hash, int row) const
+{
+	static const uint64_t kSeeds[kDepth] = {
+		0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL,
+		0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL
+	};
+
+	uint64_t h = (static_cast<uint64_t>(hash) + kSeeds[row]) * kSeeds[row];
+	h ^= h >> 32;
+	return row * width_ + (h & (width_ - 1));
+}
+
+void FrequencySketch::increment(size_t hash)
+{
+	for(int row=0; row<kDepth; ++row)
+	{
+		uint8_t &counter = table_[indexOf(hash, row)];
+		if(counter < kMaxCount) ++counter;
+	}
+
+	/* 老化：所有计数减半 */
+	if(unlikely(++samples_ >= sampleSize_))
+	{
+		reset();
+	}
+}
+
+int FrequencySketch::frequency(size_t hash) const
+{
+	int freq = kMaxCount;
+	for(int row=0; row<kDepth; ++row)
+	{
+		freq = std::min(freq, static_cast<int>(table_[indexOf(hash, row)]));
+	}
+	return freq;
+}
+
+void FrequencySketch::reset()
+{
+	for(auto &counter : table_)
+	{
+		counter >>= 1;
+	}
+	samples_ /= 2;
+}
+
+/* 窗口占1%，主区中受保护段占80% */
+ContentCache::ContentCache(size_t capacity, size_t maxObjectSize)
+	: capacity_(capacity),
+	  maxObjectSize_(std::min(maxObjectSize, capacity)),
+	  windowCapacity_(std::max<size_t>(capacity / 100, 1)),
+	  protectedCapacity_((capacity - windowCapacity_) / 5 * 4),
+	  sketch_(std::max<size_t>(capacity / 4096, 1024)),
+	  windowBytes_(0),
+	  probationBytes_(0),
+	  protectedBytes_(0),
+	  misses_(0),
+	  evictions_(0),
+	  rejections_(0)
+{
+	assert(capacity_ > windowCapacity_);
+	for(ReadBuffer &buffer : readBuffers_)
+	{
+		buffer.tail.store(0, std::memory_order_relaxed);
+		buffer.head = 0;
+		buffer.hits.store(0, std::memory_order_relaxed);
+	}
+}
+
+/* 线程按首次使用的顺序分到读缓冲，同一缓冲很少被多个线程同时写 */
+static size_t readBufferIndex(size_t buffers)
+{
+	static std::atomic<size_t> nextIndex(0);
+	static thread_local size_t t_index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+	return t_index % buffers;
+}
+
+ContentCache::~ContentCache()
+{
+}
+
+ContentCache::SP_ConstString ContentCache::get(const std::string &path,
+                                               const FileCache::SP_Entry &entry)
+{
+	if(entry->size > maxObjectSize_) return nullptr;
+
+	ReadBuffer &buffer = readBuffers_[readBufferIndex(kReadBuffers)];
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex_);
+		auto it = index_.find(path);
+		if(likely(it != index_.end()) && likely(it->second->etag == entry->etag))
+		{
+			buffer.hits.fetch_add(1, std::memory_order_relaxed);
+			SP_ConstString body = it->second->body;
+			bool drain = recordHit(buffer, it->second);
+			lock.unlock();
+			
+			if(drain) tryDrain();
+			return body;
+		}
+	}
+
+	size_t hash = std::hash<std::string>()(path);
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex_);
+		drainLocked();
+		sketch_.increment(hash);
+
+		auto it = index_.find(path);
+		if(it != index_.end())
+		{
+			/* 其他线程刚刚读入 */
+			if(it->second->etag == entry->etag)
+			{
+				buffer.hits.fetch_add(1, std::memory_order_relaxed);
+				onHitLocked(it->second);
+				return it->second->body;
+			}
+			/* 文件已变化 */
+			removeLocked(it->second);
+		}
+		++misses_;
+	}
+
+	/* 未命中，在锁外读入文件 */
+	SP_ConstString body = load(*entry);
+	if(body == nullptr) return body;
+
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex_);
+		drainLocked();
+		if(!index_.count(path))
+		{
+			Node node;
+			node.key = path;
+			node.etag = entry->etag;
+			node.body = body;
+			node.charge = body->size() + path.size() + kEntryOverhead;
+			node.hash = hash;
+			node.segment = kWindow;
+			insertLocked(std::move(node));
+		}
+	}
+
+	return body;
+}
+
+ContentCache::Stats ContentCache::stats()
+{
+	std::unique_lock<std::shared_mutex> lock(mutex_);
+	drainLocked();
+
+	Stats stats;
+	stats.hits = 0;
+	for(const ReadBuffer &buffer : readBuffers_)
+	{
+		stats.hits += buffer.hits.load(std::memory_order_relaxed);
+	}
+	stats.misses = misses_;
+	stats.evictions = evictions_;
+	stats.rejections = rejections_;
+	stats.bytes = windowBytes_ + probationBytes_ + protectedBytes_;
+	stats.entries = index_.size();
+	return stats;
+}
+
+/* 读锁下head不变，预留到的[tail, tail+1)不会与其他线程重叠 */
+/* 缓冲已满时丢弃本次记录，只影响淘汰顺序的精度 */
+bool ContentCache::recordHit(ReadBuffer &buffer, NodeList::iterator it)
+{
+	uint32_t tail = buffer.tail.load(std::memory_order_relaxed);
+	uint32_t pending = tail - buffer.head;
+	if(pending >= ReadBuffer::kSize) return true;
+	
+	if(buffer.tail.compare_exchange_strong(tail, tail + 1, std::memory_order_relaxed))
+	{
+		buffer.slots[tail % ReadBuffer::kSize] = it;
+		++pending;
+	}
+	return pending >= ReadBuffer::kSize / 2;
+}
+
+void ContentCache::tryDrain()
+{
+	std::unique_lock<std::shared_mutex> lock(mutex_, std::try_to_lock);
+	if(lock.owns_lock())
+	{
+		drainLocked();
+	}
+}
+
+/* 写锁排除了所有读者，读缓冲中的写入都已完成 */
+void ContentCache::drainLocked()
+{
+	for(ReadBuffer &buffer : readBuffers_)
+	{
+		const uint32_t tail = buffer.tail.load(std::memory_order_relaxed);
+		for(; buffer.head != tail; ++buffer.head)
+		{
+			NodeList::iterator it = buffer.slots[buffer.head % ReadBuffer::kSize];
+			sketch_.increment(it->hash);
+			onHitLocked(it);
+		}
+	}
+}
+
+void ContentCache::onHitLocked(NodeList::iterator it)
+{
+	switch(it->segment)
+	{
+	case kWindow:
+		window_.splice(window_.begin(), window_, it);
+		break;
+	case kProtected:
+		protected_.splice(protected_.begin(), protected_, it);
+		break;
+	case kProbation:
+		/* 再次命中，晋升到受保护段 */
+		probationBytes_ -= it->charge;
+		protectedBytes_ += it->charge;
+		it->segment = kProtected;
+		protected_.splice(protected_.begin(), probation_, it);
+
+		/* 受保护段超出预算，尾部降级回试用段 */
+		while(protectedBytes_ > protectedCapacity_ && protected_.size() > 1)
+		{
+			auto demoted = std::prev(protected_.end());
+			protectedBytes_ -= demoted->charge;
+			probationBytes_ += demoted->charge;
+			demoted->segment = kProbation;
+			probation_.splice(probation_.begin(), protected_, demoted);
+		}
+		break;
+	}
+}
+
+void ContentCache::insertLocked(Node &&node)
+{
+	if(node.charge > capacity_ - windowCapacity_) return ;
+
+	std::string key = node.key;
+	windowBytes_ += node.charge;
+	window_.push_front(std::move(node));
+	index_[key] = window_.begin();
+
+	evictWindowLocked();
+}
+
+/* 窗口溢出的候选者与主区的淘汰者比较频率，频率更高才能进入主区 */
+void ContentCache::evictWindowLocked()
+{
+	const size_t mainCapacity = capacity_ - windowCapacity_;
+
+	while(windowBytes_ > windowCapacity_)
+	{
+		auto candidate = std::prev(window_.end());
+		int candidateFreq = sketch_.frequency(candidate->hash);
+		bool admitted = true;
+
+		while(probationBytes_ + protectedBytes_ + candidate->charge > mainCapacity)
+		{
+			NodeList &victims = probation_.empty() ? protected_ : probation_;
+			if(victims.empty())
+			{
+				admitted = false;
+				break;
+			}
+
+			auto victim = std::prev(victims.end());
+			if(candidateFreq > sketch_.frequency(victim->hash))
+			{
+				removeLocked(victim);
+				++evictions_;
+			}
+			else
+			{
+				admitted = false;
+				break;
+			}
+		}
+
+		if(admitted)
+		{
+			windowBytes_ -= candidate->charge;
+			probationBytes_ += candidate->charge;
+			candidate->segment = kProbation;
+			probation_.splice(probation_.begin(), window_, candidate);
+		}
+		else
+		{
+			removeLocked(candidate);
+			++rejections_;
+		}
+	}
+}
+
+void ContentCache::removeLocked(NodeList::iterator it)
+{
+	bytesOf(it->segment) -= it->charge;
+	index_.erase(it->key);
+	listOf(it->segment).erase(it);
+}
+
+ContentCache::NodeList &ContentCache::listOf(Segment segment)
+{
+	switch(segment)
+	{
+	case kWindow:    return window_;
+	case kProbation: return probation_;
+	default:         return protected_;
+	}
+}
+
+size_t &ContentCache::bytesOf(Segment segment)
+{
+	switch(segment)
+	{
+	case kWindow:    return windowBytes_;
+	case kProbation: return probationBytes_;
+	default:         return protectedBytes_;
+	}
+}
+
+/* 从缓存的文件描述符读入全部内容，pread不改变文件偏移 */
+ContentCache::SP_ConstString ContentCache::load(const FileCache::Entry &entry)
+{
+	std::string body(entry.size, '\0');
+	size_t total = 0;
+
+	while(total < entry.size)
+	{
+		ssize_t n = ::pread(entry.file->fd(), &body[total],
+		                    entry.size - total, static_cast<off_t>(total));
+		if(n <= 0)
+		{
+			if(n < 0 && errno == EINTR) continue;
+			/* 读取失败或文件被截断 */
+			return nullptr;
+		}
+		total += n;
+	}
+
+	return std::make_shared<const std::string>(std::move(body));
+}
+
+} //namespace webserver
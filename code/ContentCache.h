@@ -0,0 +1,153 @@
+#ifndef code_ContentCache_h
+#define code_ContentCache_h
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FileCache.h"
+#include "OutputQueue.h"
+#include "noncopyable.h"
+
+namespace webserver
+{
+
+/* frequency sketch used by the admission policy */
+// Count-Min Sketch，4行计数器，每个计数器上限15
+// 采样数达到上限时所有计数减半，使旧的热度逐渐衰减
+class FrequencySketch : noncopyable
+{
+public:
+	explicit FrequencySketch(size_t expectedEntries);
+
+	void increment(size_t hash);
+	int frequency(size_t hash) const;
+
+private:
+	size_t indexOf(size_t hash, int row) const;
+	void reset();
+
+private:
+	static const int kDepth = 4;
+	static const uint8_t kMaxCount = 15;
+
+	std::vector<uint8_t> table_;	/* kDepth行 * width_ */
+	size_t width_;					/* 2的幂 */
+	size_t samples_;
+	size_t sampleSize_;
+};
+
+/*
+ * memory-bounded static content cache, W-TinyLFU
+ * +---------------+     +-------------------------------------+
+ * |  window LRU   | --> | main SLRU: probation --> protected  |
+ * +---------------+     +-------------------------------------+
+ *        candidate evicted from window is admitted into main
+ *        only if it is more frequent than main's victim
+ */
+// 小文件的完整内容缓存，命中时以共享只读数据直接排入输出队列
+// 准入策略为W-TinyLFU：一次性扫描大量冷文件，无法挤掉热点文件
+// 所有事件循环共享，由HttpServer持有
+// 查找只持有读锁；命中记录在各线程的读缓冲中(满时丢弃)，取得写锁时再回放到sketch与LRU
+class ContentCache : noncopyable
+{
+public:
+	typedef OutputQueue::SP_ConstString SP_ConstString;
+
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		uint64_t rejections;	/* 未通过准入 */
+		size_t bytes;
+		size_t entries;
+	};
+
+	// 每个缓存项的额外开销估计
+	static const size_t kEntryOverhead = 64;
+
+	/* capacity：总字节预算；maxObjectSize：超过该大小的文件不缓存 */
+	ContentCache(size_t capacity, size_t maxObjectSize);
+	~ContentCache();
+
+	/* 取得path的内容，entry用于校验ETag，未命中时从文件读入 */
+	/* 文件过大或读取失败时返回nullptr，由调用者走sendfile */
+	SP_ConstString get(const std::string &path, const FileCache::SP_Entry &entry);
+
+	Stats stats();
+
+private:
+	enum Segment { kWindow, kProbation, kProtected };
+
+	struct Node
+	{
+		std::string key;
+		std::string etag;
+		SP_ConstString body;
+		size_t charge;
+		size_t hash;
+		Segment segment;
+	};
+	typedef std::list<Node> NodeList;
+
+	/* 命中记录，读锁下各线程只写自己的读缓冲；回放在写锁下进行 */
+	struct alignas(64) ReadBuffer
+	{
+		static const uint32_t kSize = 16;
+
+		std::atomic<uint32_t> tail;
+		uint32_t head;						/* 只在写锁下修改 */
+		std::atomic<uint64_t> hits;
+		NodeList::iterator slots[kSize];	/* [head, tail)为待回放的命中 */
+	};
+	static const size_t kReadBuffers = 16;
+
+	/* 持有读锁时调用，返回是否应当回放 */
+	static bool recordHit(ReadBuffer &buffer, NodeList::iterator it);
+	/* 取得写锁则回放，否则留给下一个取得写锁的线程 */
+	void tryDrain();
+
+	/* 以下函数调用时须持有mutex_的写锁 */
+	/* 修改链表之前须先回放，读缓冲中的迭代器在回放前都有效 */
+	void drainLocked();
+	void onHitLocked(NodeList::iterator it);
+	void insertLocked(Node &&node);
+	void evictWindowLocked();
+	void removeLocked(NodeList::iterator it);
+	NodeList &listOf(Segment segment);
+	size_t &bytesOf(Segment segment);
+
+	static SP_ConstString load(const FileCache::Entry &entry);
+
+private:
+	const size_t capacity_;
+	const size_t maxObjectSize_;
+	const size_t windowCapacity_;
+	const size_t protectedCapacity_;
+
+	std::shared_mutex mutex_;
+	FrequencySketch sketch_;
+	ReadBuffer readBuffers_[kReadBuffers];
+
+	NodeList window_;
+	NodeList probation_;
+	NodeList protected_;
+	size_t windowBytes_;
+	size_t probationBytes_;
+	size_t protectedBytes_;
+	std::unordered_map<std::string, NodeList::iterator> index_;
+
+	uint64_t misses_;
+	uint64_t evictions_;
+	uint64_t rejections_;
+};
+
+} //namespace webserver
+
+#endif
@@ -0,0 +1,251 @@
+#include "CpuPlacement.h"
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <utility>
+
+namespace webserver
+{
+
+static const char kCpuDir[] = "/sys/devices/system/cpu/";
+static const char kNodeDir[] = "/sys/devices/system/node/";
+
+/* 读取sysfs中的一行，文件不存在时返回空串 */
+static std::string readLine(const std::string &path)
+{
+	std::ifstream in(path);
+	std::string line;
+	std::getline(in, line);
+	return line;
+}
+
+static int readInt(const std::string &path, int defaultValue)
+{
+	std::string line = readLine(path);
+	return line.empty() ? defaultValue : atoi(line.c_str());
+}
+
+static std::string formatCpuList(const std::vector<int> &cpus)
+{
+	std::string out;
+	for(size_t i=0; i<cpus.size(); )
+	{
+		size_t j = i;
+		while(j+1 < cpus.size() && cpus[j+1] == cpus[j] + 1) ++j;
+		if(!out.empty()) out += ",";
+		out += std::to_string(cpus[i]);
+		if(j > i) out += "-" + std::to_string(cpus[j]);
+		i = j + 1;
+	}
+	return out;
+}
+
+bool CpuPlacement::parseCpuList(const std::string &list, std::vector<int> *cpus)
+{
+	cpus->clear();
+	const char *p = list.c_str();
+	while(*p != '\0' && *p != '\n')
+	{
+		char *end;
+		long first = strtol(p, &end, 10);
+		if(end == p || first < 0) return false;
+		long last = first;
+		p = end;
+		if(*p == '-')
+		{
+			last = strtol(p+1, &end, 10);
+			if(end == p+1 || last < first) return false;
+			p = end;
+		}
+		for(long cpu=first; cpu<=last; ++cpu)
+		{
+			cpus->push_back(static_cast<int>(cpu));
+		}
+		if(*p == ',') ++p;
+		else if(*p != '\0' && *p != '\n') return false;
+	}
+	std::sort(cpus->begin(), cpus->end());
+	cpus->erase(std::unique(cpus->begin(), cpus->end()), cpus->end());
+	return !cpus->empty();
+}
+
+std::vector<int> CpuPlacement::currentAffinity()
+{
+	std::vector<int> cpus;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(::sched_getaffinity(0, sizeof(set), &set) == 0)
+	{
+		for(int cpu=0; cpu<CPU_SETSIZE; ++cpu)
+		{
+			if(CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+
+/* 只使用在线且当前进程允许的CPU(如容器的cpuset) */
+static std::vector<int> usableCpus()
+{
+	std::vector<int> online;
+	if(!CpuPlacement::parseCpuList(readLine(std::string(kCpuDir) + "online"), &online))
+	{
+		return CpuPlacement::currentAffinity();
+	}
+	std::vector<int> allowed = CpuPlacement::currentAffinity();
+	std::vector<int> cpus;
+	std::set_intersection(online.begin(), online.end(), allowed.begin(), allowed.end(),
+	                      std::back_inserter(cpus));
+	return cpus;
+}
+
+/* CPU所属的节点；没有NUMA信息时都在节点0 */
+static std::map<int, int> cpuNodes(int *numNodes)
+{
+	std::map<int, int> nodes;
+	std::vector<int> online;
+	*numNodes = 1;
+	if(!CpuPlacement::parseCpuList(readLine(std::string(kNodeDir) + "online"), &online))
+	{
+		return nodes;
+	}
+	*numNodes = static_cast<int>(online.size());
+	for(int node : online)
+	{
+		std::vector<int> cpus;
+		std::string path = std::string(kNodeDir) + "node" + std::to_string(node) + "/cpulist";
+		if(!CpuPlacement::parseCpuList(readLine(path), &cpus)) continue;
+		for(int cpu : cpus) nodes[cpu] = node;
+	}
+	return nodes;
+}
+
+bool CpuPlacement::parse(const char *spec, CpuPlacement *placement)
+{
+	Policy policy;
+	std::vector<int> listed;
+	if(strcmp(spec, "cores") == 0) policy = kPhysicalCores;
+	else if(strcmp(spec, "numa") == 0) policy = kNumaNodes;
+	else if(parseCpuList(spec, &listed)) policy = kCpuList;
+	else return false;
+
+	std::vector<int> cpus = usableCpus();
+	if(cpus.empty()) return false;
+
+	int numNodes;
+	std::map<int, int> nodes = cpuNodes(&numNodes);
+	auto nodeOf = [&nodes](int cpu) {
+		auto it = nodes.find(cpu);
+		return it == nodes.end() ? 0 : it->second;
+	};
+
+	std::vector<Slot> slots;
+	if(policy == kCpuList)
+	{
+		for(int cpu : listed)
+		{
+			if(!std::binary_search(cpus.begin(), cpus.end(), cpu))
+			{
+				fprintf(stderr, "cpu %d is offline or not allowed\n", cpu);
+				return false;
+			}
+			slots.push_back(Slot{ std::vector<int>(1, cpu), nodeOf(cpu) });
+		}
+	}
+	else
+	{
+		/* 按(物理封装, 核)归并超线程 */
+		std::map<std::pair<int, int>, size_t> cores;
+		for(int cpu : cpus)
+		{
+			std::string topology = std::string(kCpuDir) + "cpu" + std::to_string(cpu) + "/topology/";
+			std::pair<int, int> key(readInt(topology + "physical_package_id", 0),
+			                        readInt(topology + "core_id", cpu));
+			auto it = cores.find(key);
+			if(it == cores.end())
+			{
+				cores[key] = slots.size();
+				slots.push_back(Slot{ std::vector<int>(1, cpu), nodeOf(cpu) });
+			}
+			else
+			{
+				slots[it->second].cpus.push_back(cpu);
+			}
+		}
+
+		if(policy == kNumaNodes)
+		{
+			/* 每个位置放宽到整个节点，各节点的位置交替排列 */
+			std::map<int, std::vector<int>> nodeCpus;
+			std::map<int, std::vector<Slot>> byNode;
+			for(int cpu : cpus) nodeCpus[nodeOf(cpu)].push_back(cpu);
+			for(Slot &slot : slots) byNode[slot.node].push_back(Slot{ nodeCpus[slot.node], slot.node });
+
+			slots.clear();
+			for(size_t round=0; ; ++round)
+			{
+				bool added = false;
+				for(auto &entry : byNode)
+				{
+					if(round < entry.second.size())
+					{
+						slots.push_back(entry.second[round]);
+						added = true;
+					}
+				}
+				if(!added) break;
+			}
+		}
+	}
+
+	placement->policy_ = policy;
+	placement->slots_.swap(slots);
+	placement->numNodes_ = numNodes;
+	return true;
+}
+
+bool CpuPlacement::bindCurrentThread(size_t index) const
+{
+	if(slots_.empty()) return true;
+	const Slot &slot = slots_[index % slots_.size()];
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for(int cpu : slot.cpus) CPU_SET(cpu, &set);
+	if(::sched_setaffinity(0, sizeof(set), &set) < 0)
+	{
+		perror("sched_setaffinity");
+		return false;
+	}
+
+	/* 单节点的机器上本来就是本地分配 */
+	if(numNodes_ > 1 && slot.node < static_cast<int>(sizeof(unsigned long) * 8))
+	{
+		unsigned long mask = 1UL << slot.node;
+		if(::syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8) < 0)
+		{
+			perror("set_mempolicy");
+			return false;
+		}
+	}
+	return true;
+}
+
+std::string CpuPlacement::describe(size_t index) const
+{
+	if(slots_.empty()) return "unbound";
+	const Slot &slot = slots_[index % slots_.size()];
+	return "cpus " + formatCpuList(slot.cpus) + " node " + std::to_string(slot.node);
+}
+
+} //namespace webserver
@@ -0,0 +1,70 @@
+#ifndef code_CpuPlacement_h
+#define code_CpuPlacement_h
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace webserver
+{
+
+/*
+ * where event loop threads run
+ *   cpu list   "0,2,4-7": one slot per listed cpu
+ *   "cores":   one slot per physical core (all of its SMT siblings)
+ *   "numa":    one slot per physical core, the thread may float over the
+ *              cores of that core's NUMA node; slots alternate between
+ *              nodes so that fewer threads still cover every node
+ * the i-th thread binds to slot i % slots(); its memory policy prefers
+ * the slot's node, so buffers and connection objects it allocates after
+ * binding are node-local
+ * topology comes from /sys/devices/system/{cpu,node}
+ */
+// 事件循环线程的CPU与NUMA放置策略
+// 显式CPU列表：每个CPU一个位置
+// cores：每个物理核一个位置，绑定到该核的全部超线程
+// numa：每个物理核一个位置，线程可在该核所在NUMA节点的所有CPU上调度，
+//       各节点的位置交替排列，线程数少于位置数时仍覆盖每个节点
+// 第i个线程绑定到第i % slots()个位置，内存优先从该位置的节点分配，
+// 绑定之后在线程中分配的缓冲区、连接对象都在本地节点
+class CpuPlacement
+{
+public:
+	enum Policy { kNone, kCpuList, kPhysicalCores, kNumaNodes };
+
+	CpuPlacement() : policy_(kNone), numNodes_(1) {}
+
+	/* "cores"、"numa"或CPU列表，失败时返回false */
+	static bool parse(const char *spec, CpuPlacement *placement);
+
+	Policy policy() const { return policy_; }
+	/* 位置个数，可作为默认线程数；kNone时为0 */
+	size_t slots() const { return slots_.size(); }
+
+	/* 把当前线程绑定到第index个位置(取模)，kNone时什么也不做 */
+	bool bindCurrentThread(size_t index) const;
+
+	/* 如"cpus 0-1 node 0"，用于日志 */
+	std::string describe(size_t index) const;
+
+	/* 当前线程允许运行的CPU */
+	static std::vector<int> currentAffinity();
+	/* "0,2,4-7"，出错时返回false */
+	static bool parseCpuList(const std::string &list, std::vector<int> *cpus);
+
+private:
+	struct Slot
+	{
+		std::vector<int> cpus;
+		int node;
+	};
+
+	Policy policy_;
+	std::vector<Slot> slots_;
+	/* 节点数大于1时才设置内存策略 */
+	int numNodes_;
+};
+
+} //namespace webserver
+
+#endif
@@ -1,6 +1,8 @@
 #include "Epoll.h"
 
 #include <cassert>
+#include <cerrno>
+#include <algorithm>
 #include <cstring>
 #include <cstdio>
 
@@ -9,7 +11,6 @@
 #include "macros.h"
 #include "Channel.h"
 
-/* may use 'fd' instead of 'channel *' is better */
 namespace webserver
 {
 	
@@ -26,7 +27,8 @@ Epoll::~Epoll()
 }
 
 /* ET mode */
-Epoll::ChannelVector Epoll::poll(int timeout)
+/* epoll_event.data.ptr即Channel，不需要查表 */
+void Epoll::poll(int timeout, ChannelList *activeChannels)
 {
 	// 调用 epoll_wait 函数等待事件，将结果存储在 events_ 中
 	int numEvents = ::epoll_wait(epollFd_, 
@@ -37,18 +39,18 @@ Epoll::ChannelVector Epoll::poll(int timeout)
 	// 如果 epoll_wait 返回值小于 0，表示发生错误，输出错误信息
 	if(unlikely(numEvents < 0))
 	{
-		perror("epoll_wait");
+		if(errno != EINTR) perror("epoll_wait");
+		numEvents = 0;
 	}
 		
-	ChannelVector activeChannels;
-	activeChannels.reserve(numEvents);
+	activeChannels->clear();
 
 	// 遍历 events_ 数组，将每个活跃通道添加到 activeChannels 中
 	for(int i=0; i<numEvents; ++i)
 	{
-		int fd = events_[i].data.fd;
-		channelMap_[fd]->set_revents(events_[i].events);
-		activeChannels.push_back(channelMap_[fd]);
+		Channel *channel = static_cast<Channel *>(events_[i].data.ptr);
+		channel->set_revents(events_[i].events);
+		activeChannels->push_back(channel);
 	}
 	
 	/* enlarge space to try to read all events once */
@@ -57,40 +59,43 @@ Epoll::ChannelVector Epoll::poll(int timeout)
 	{
 		events_.resize(2*events_.size());
 	}
-	
-	// 返回存储了活跃通道的 vector
-	return activeChannels;
 }
 
 void Epoll::updateChannel(SP_Channel &channel)
 {
-	int fd = channel->getFd();
-	if(channelMap_.count(fd))
+	size_t fd = static_cast<size_t>(channel->getFd());
+	if(fd < channels_.size() && channels_[fd])
 	{
 		/* already exists, then modify it */
+		assert(channels_[fd] == channel);
 		updateEvent(channel, EPOLL_CTL_MOD);
-
-		//channelMap_[fd] = channel;
 	}
 	else
 	{
 		/* add a new one */
+		if(fd >= channels_.size())
+		{
+			channels_.resize(std::max(fd+1, 2*channels_.size()));
+		}
 		updateEvent(channel, EPOLL_CTL_ADD);
-		channelMap_.insert(std::make_pair(fd, channel));
+		channels_[fd] = channel;
 	}
 }
 
 void Epoll::removeChannel(SP_Channel &channel)
 {
-	int fd = channel->getFd();
-	if(unlikely(!channelMap_.count(fd)))
+	size_t fd = static_cast<size_t>(channel->getFd());
+	if(unlikely(fd >= channels_.size() || channels_[fd] != channel))
 	{
 		fprintf(stderr, "channel no found\n");
 		return ;
 	}
 	/* delete a monitored event */
 	updateEvent(channel, EPOLL_CTL_DEL);
-	channelMap_.erase(fd);
+	channels_[fd].reset();
+	
+	/* 本轮尚未分发的事件不再处理 */
+	channel->set_revents(0);
 }
 
 int Epoll::updateEvent(SP_Channel &channel, int operation)
@@ -100,7 +105,7 @@ int Epoll::updateEvent(SP_Channel &channel, int operation)
 	memset(&ev, 0, sizeof(ev));
 	
 	ev.events = channel->events();
-	ev.data.fd = fd;
+	ev.data.ptr = channel.get();
 	if(unlikely(::epoll_ctl(epollFd_, operation, fd, &ev) < 0))
 	{
 		fprintf(stderr, "epoll_ctl");
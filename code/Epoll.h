@@ -3,11 +3,10 @@
 
 #include <vector>
 #include <memory>
-#include <unordered_map>
 
 #include <sys/epoll.h>
 
-#include "noncopyable.h"
+#include "Poller.h"
 
 namespace webserver
 {
@@ -24,22 +23,19 @@ class Channel;
 // 职责： 添加/修改/删除 关注的事件 并且 返回激活的事件
 // 拥有者： EventLoop ， 由唯一指针保障
 
-// Epoll 类继承自 noncopyable，表明该类是不可拷贝的，防止通过拷贝构造函数和赋值运算符进行复制。
-class Epoll : noncopyable
+// Epoll 是 Poller 的默认后端，Poller 继承自 noncopyable，不可拷贝。
+class Epoll : public Poller
 {
 public:
-	typedef std::shared_ptr<Channel> SP_Channel;
-	typedef std::vector<SP_Channel> ChannelVector;
-	
 	Epoll();
-	~Epoll();
+	~Epoll() override;
 	
-	// poll 函数用于进行事件轮询，返回激活的事件。
-	ChannelVector poll(int timeout);
+	// poll 函数用于进行事件轮询，激活的通道写入调用者复用的activeChannels。
+	void poll(int timeout, ChannelList *activeChannels) override;
 	
 	// 更新和删除通道。
-	void updateChannel(SP_Channel &channel);
-	void removeChannel(SP_Channel &channel);
+	void updateChannel(SP_Channel &channel) override;
+	void removeChannel(SP_Channel &channel) override;
 
 private:
 	/* internel function, be invoked by update and remove channels */
@@ -56,8 +52,9 @@ private:
 	
 	/* The mapping of the file descriptor to the channel */
 	/* record those monitored file descriptors */
-	// 文件描述符到 SP_Channel 的映射。
-	std::unordered_map<int, SP_Channel> channelMap_;
+	// 以文件描述符为下标的 SP_Channel 表，持有已注册的通道。
+	// 文件描述符总是取最小可用值，表是稠密的。
+	std::vector<SP_Channel> channels_;
 	
 	// 初始化时用于事件数组的大小。
 	static const int kInitEventSize = 16;
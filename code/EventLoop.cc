@@ -1,15 +1,18 @@
 #include "EventLoop.h"
 
 #include <cassert>
+#include <algorithm>
 
 #include <sys/eventfd.h>
+#include <time.h>
 #include <unistd.h>
 
-#include "Epoll.h"
+#include "Poller.h"
 #include "Channel.h"
 #include "CurrentThread.h"
 #include "HttpHandler.h"
 #include "HttpManager.h"
+#include "utils.h"
 
 #include "config.h"
 
@@ -22,6 +25,15 @@ thread_local EventLoop *t_loopInThisThread = nullptr;
 // 轮询的超时时间。
 static const int kEPollTimeMs = 10000;	//10s
 
+// 忙轮询预算的下限(us)，减半到此为止，下一次有事件时仍会空转。
+static const Timestamp kMinBusyPollUs = 10;
+
+// 负载统计窗口(us)，每个窗口的忙碌占比以1/4的权重计入平均。
+static const Timestamp kLoadWindowUs = 100000;
+
+// 每个事件循环预分配的任务节点数，超出时临时new。
+static const size_t kTaskPoolSize = 1024;
+
 // 该函数用于创建一个用于事件唤醒的文件描述符（eventfd）
 int createEventFd()
 {
@@ -34,15 +46,50 @@ int createEventFd()
 	return evtfd;
 }
 
+// 粗粒度时钟读取vDSO中的上一个节拍，不陷入内核，也不读TSC。
+static Timestamp monotonicCoarse()
+{
+	struct timespec ts;
+	::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return static_cast<Timestamp>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+static time_t realtimeCoarse()
+{
+	struct timespec ts;
+	::clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+	return ts.tv_sec;
+}
+
 // 初始化了成员变量，包括事件循环状态、线程ID、事件轮询器、唤醒通道、HTTP 管理器等。
 EventLoop::EventLoop()
 	: looping_(false),		// 是否
 	  quit_(false),
 	  threadId_(CurrentThread::tid()),		// 记录事件循环的线程 pid
-	  poller_(new Epoll()),
+	  poller_(Poller::newDefaultPoller()),
+	  completionIo_(poller_->completionIo()),
 	  wakeupFd_(createEventFd()),		// 创建唤醒Fd
 	  wakeupChannel_(new Channel(wakeupFd_, this)),		// 创建唤醒通道
-	  callingPendingFucntors_(false),
+	  channelUpdates_(0),
+	  pollerUpdates_(0),
+	  taskPool_(kTaskPoolSize),
+	  wakeupPending_(false),
+	  now_(monotonicCoarse()),
+	  wallTime_(realtimeCoarse()),
+	  httpDateTime_(-1),
+	  httpDateFormats_(0),
+	  busyPollMax_(0),
+	  busyPollBudget_(0),
+	  spinUntil_(0),
+	  socketBusyPoll_(0),
+	  idleSpins_(0),
+	  usefulPolls_(0),
+	  spinHits_(0),
+	  loadWindowStart_(now_),
+	  busyInWindow_(0),
+	  connections_(0),
+	  busyPermille_(0),
+	  timerQueue_(new TimerQueue(this)),
 	  manager_(new HttpManager(this))
 {
 	// 确保每个线程只能拥有一个 EventLoop 实例
@@ -63,6 +110,12 @@ EventLoop::EventLoop()
 
 EventLoop::~EventLoop()
 {
+	/* 未执行的回调直接丢弃 */
+	MpscNode *node;
+	while((node = pendingFunctors_.pop()) != nullptr)
+	{
+		releaseTask(static_cast<PendingTask *>(node));
+	}
 	::close(wakeupFd_);
 	t_loopInThisThread = nullptr;
 }
@@ -80,19 +133,39 @@ void EventLoop::loop()
 	
 	looping_ = true;
 
-	// Channels 指针数组 活跃
-	ChannelVector activeChannels;
 	// 没有退出变量即执行
 	while(!quit_)
 	{
-		activeChannels.clear();
+		/* 上一轮的兴趣集合修改，合并后一次提交 */
+		flushChannelUpdates();
+		
 		/* acquire activate events */
 		// 获取活跃的事件
-		activeChannels = poller_->poll(kEPollTimeMs);
+		/* 本线程排队的回调不写eventfd，有待执行的回调时不阻塞；忙轮询的空转窗口内也不阻塞 */
+		/* 最近的定时器足够近时以其截止时间为超时，否则由timerfd唤醒 */
+		/* now_是上一次poll返回时的时间，本轮的分发与回调之后须重新读时钟，否则超时多出整轮的忙碌时间 */
+		const Timestamp beforePoll = monotonicCoarse();
+		int timeoutMs = 0;
+		if(pendingFunctors_.empty() && spinUntil_ == 0)
+		{
+			timeoutMs = timerQueue_->pollTimeout(beforePoll, kEPollTimeMs);
+		}
+		/* 上一次poll返回至今为忙碌时间；粗粒度时钟的截断在多轮之间平均掉 */
+		const Timestamp busy = beforePoll - now_;
+		poller_->poll(timeoutMs, &activeChannels_);
+		
+		/* 本轮的事件分发与定时器都使用poll返回时的时间 */
+		updateClock();
+		updateLoad(busy);
+		
+		if(busyPollMax_ > 0)
+		{
+			adaptBusyPoll(!activeChannels_.empty());
+		}
 		
 		/* handle activate events */
-		/* ?? may have a rece condition ?? */
-		for(auto &it : activeChannels)
+		/* 被移除的Channel延迟到本轮结束才释放，裸指针不会悬空 */
+		for(Channel *it : activeChannels_)
 		{
 			/* 处理读写，并更新状态 */
 			it->handleEvent();
@@ -103,12 +176,98 @@ void EventLoop::loop()
 			manager_->handler(it);
 		}
 		
+		/* handle expired timers */
+		timerQueue_->processExpired(now_);
+		
 		/* handle extra functors */
 		doPendingFunctors();
+		
+		releaseLater_.clear();
 	}
 	looping_ = false;
 }
 
+/* 空闲的循环至少每秒被时间轮的定时器唤醒一次，平均值不会停留在旧的高位 */
+void EventLoop::updateLoad(Timestamp busy)
+{
+	busyInWindow_ += busy;
+	const Timestamp elapsed = now_ - loadWindowStart_;
+	if(elapsed < kLoadWindowUs) return ;
+	
+	const int sample = static_cast<int>(std::min<Timestamp>(1000, busyInWindow_ * 1000 / elapsed));
+	const int average = busyPermille_.load(std::memory_order_relaxed);
+	busyPermille_.store(average + (sample - average) / 4, std::memory_order_relaxed);
+	loadWindowStart_ = now_;
+	busyInWindow_ = 0;
+}
+
+void EventLoop::setBusyPoll(int maxBudgetUs, int socketBusyPollUs)
+{
+	assert(isInLoopThread());
+	busyPollMax_ = maxBudgetUs > 0 ? maxBudgetUs : 0;
+	busyPollBudget_ = busyPollMax_;
+	spinUntil_ = 0;
+	socketBusyPoll_ = busyPollMax_ > 0 ? socketBusyPollUs : 0;
+}
+
+/* 空转窗口以微秒计，粗粒度时钟(4ms)不够，这里读精确时钟，只在忙轮询模式下 */
+void EventLoop::adaptBusyPoll(bool gotEvents)
+{
+	const Timestamp current = TimerQueue::now();
+	if(gotEvents)
+	{
+		++usefulPolls_;
+		if(spinUntil_ != 0)
+		{
+			/* 事件间隔在预算之内，扩大预算 */
+			++spinHits_;
+			busyPollBudget_ = std::min(busyPollMax_, busyPollBudget_ * 2);
+		}
+		spinUntil_ = current + busyPollBudget_;
+		return ;
+	}
+	
+	/* 阻塞的poll超时返回 */
+	if(spinUntil_ == 0) return ;
+	
+	++idleSpins_;
+	if(current >= spinUntil_)
+	{
+		/* 整段空转没有等到事件，缩小预算，转入阻塞；上限小于kMinBusyPollUs时不超过上限 */
+		busyPollBudget_ = std::min(busyPollMax_, std::max(kMinBusyPollUs, busyPollBudget_ / 2));
+		spinUntil_ = 0;
+	}
+}
+
+void EventLoop::updateClock()
+{
+	now_ = monotonicCoarse();
+	wallTime_ = realtimeCoarse();
+}
+
+/* 同一秒内的应答共用同一个字符串，不调用gmtime_r与snprintf */
+const std::string &EventLoop::httpDate()
+{
+	if(httpDateTime_ != wallTime_)
+	{
+		static const char kDays[7][4] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+		static const char kMonths[12][4] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+		                                     "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+		struct tm tm;
+		::gmtime_r(&wallTime_, &tm);
+		
+		/* 不用strftime，%a/%b受locale影响 */
+		char buf[32];
+		int len = snprintf(buf, sizeof(buf), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+		                   kDays[tm.tm_wday], tm.tm_mday, kMonths[tm.tm_mon],
+		                   tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+		httpDate_.assign(buf, len);
+		httpDateTime_ = wallTime_;
+		++httpDateFormats_;
+	}
+	return httpDate_;
+}
+
 void EventLoop::quit()
 {
 	quit_ = true;
@@ -166,56 +325,134 @@ printf("isInLoopThread() 当前线程 是 记录事件循环线程 \n");
 
 /* be used in other threads */
 // 将回调函数放入事件循环线程的队列中，并在有需要的情况下唤醒事件循环线程。
-// 这种设计可以确保在多线程环境中，当其他线程需要向事件循环线程添加任务时，能够正确地将任务加入队列并通知事件循环线程执行。
+// 入队不加锁；同一时刻最多只有一次未被处理的eventfd写入。
+// 本线程排队时不需要唤醒，loop在队列非空时以0超时poll。
 void EventLoop::queueInLoop(Functor &&cb)
 {
-	{
-		// 临时加锁
-		std::unique_lock<std::mutex> lock(mutex_);
-		pendingFunctors_.push_back(cb);		// 放入要执行的回调函数的队列
-	}
+	pendingFunctors_.push(::new (taskPool_.allocate()) PendingTask(std::move(cb)));
 
-	// 如果当前线程不是事件循环线程 (!isInLoopThread()) 或者正在处理回调函数 (callingPendingFucntors_)，
-	// 则调用 wakeup() 唤醒事件循环线程。
-	if(!isInLoopThread() || callingPendingFucntors_)
+	if(!isInLoopThread() && !wakeupPending_.exchange(true))
 	{
 		// 唤醒事件循环线程
 		wakeup();
 	}
 }
 
+/* 先清除唤醒标记再取队列：之后入队的生产者必然重新唤醒 */
+/* 一次取出全部任务再执行，执行中新加入的留到下一轮 */
+/* 取出的任务借用节点内的链接串成单链表，不分配内存 */
 void EventLoop::doPendingFunctors()
 {
-	std::vector<Functor> functors;
-	callingPendingFucntors_ = true;
+	wakeupPending_.exchange(false);
 	
-	/* use a local variable to reduce critical region */
+	MpscNode *first = nullptr;
+	MpscNode *last = nullptr;
+	MpscNode *node;
+	while((node = pendingFunctors_.pop()) != nullptr)
 	{
-		std::unique_lock<std::mutex> lock(mutex_);
-		functors.swap(pendingFunctors_);
+		node->mpscNext.store(nullptr, std::memory_order_relaxed);
+		if(last != nullptr) last->mpscNext.store(node, std::memory_order_relaxed);
+		else first = node;
+		last = node;
 	}
-	for(auto &functor : functors)
+	
+	while(first != nullptr)
 	{
-		functor();
+		PendingTask *task = static_cast<PendingTask *>(first);
+		first = first->mpscNext.load(std::memory_order_relaxed);
+		task->functor();
+		releaseTask(task);
 	}
-	
-	callingPendingFucntors_ = false;
 }
 
-/* void EventLoop::updateChannel(SP_Channel &&channel) */
-/* shared_from_this() return a temporary variable(rvalue) */
-void EventLoop::updateChannel(SP_Channel channel)
+void EventLoop::releaseTask(PendingTask *task)
+{
+	task->~PendingTask();
+	taskPool_.deallocate(task);
+}
+
+TimerId EventLoop::runAt(Timestamp time, TimerCallback &&cb)
+{
+	return timerQueue_->addTimer(std::move(cb), time, 0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback &&cb)
+{
+	Timestamp time = TimerQueue::now() + static_cast<Timestamp>(delay * 1000000);
+	return timerQueue_->addTimer(std::move(cb), time, 0);
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback &&cb)
+{
+	Timestamp delta = static_cast<Timestamp>(interval * 1000000);
+	assert(delta > 0);
+	return timerQueue_->addTimer(std::move(cb), TimerQueue::now() + delta, delta);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+	timerQueue_->cancel(timerId);
+}
+
+/* 只做标记，Channel第一次变脏时才取shared_ptr */
+void EventLoop::updateChannel(Channel *channel)
 {
 	assert(isInLoopThread());
 	assert(channel->ownerLoop() == this);
 	
-	poller_->updateChannel(channel);
+	++channelUpdates_;
+	if(channel->isDirty()) return ;
+	
+	channel->setDirty(true);
+	dirtyChannels_.push_back(channel->shared_from_this());
+}
+
+/* 最终的兴趣集合与已登记的相同时(如EPOLLOUT开了又关)，不调用Poller */
+void EventLoop::flushChannelUpdates()
+{
+	for(SP_Channel &channel : dirtyChannels_)
+	{
+		/* 已被移除 */
+		if(!channel->isDirty()) continue;
+		channel->setDirty(false);
+		
+		const int events = channel->events();
+		const int registered = channel->registeredEvents();
+		if(events == registered) continue;
+		if(registered == Channel::kNotRegistered && events == 0) continue;
+		
+		poller_->updateChannel(channel);
+		channel->setRegisteredEvents(events);
+		++pollerUpdates_;
+	}
+	dirtyChannels_.clear();
 }
 
 void EventLoop::removeChannel(SP_Channel channel)
 { 
-	poller_->removeChannel(channel);
+	/* 尚未提交的修改一并作废 */
+	channel->setDirty(false);
+	if(channel->registeredEvents() != Channel::kNotRegistered)
+	{
+		poller_->removeChannel(channel);
+		channel->setRegisteredEvents(Channel::kNotRegistered);
+	}
+	else
+	{
+		channel->set_revents(0);
+	}
 	manager_->delHttpConnection(channel);
+	releaseLater(std::move(channel));
+}
+
+/* 权限不足时只提示一次，循环本身的忙轮询不受影响 */
+void EventLoop::applySocketBusyPoll(int sockfd)
+{
+	if(socketBusyPoll_ > 0 && !utils::setBusyPoll(sockfd, socketBusyPoll_))
+	{
+		perror("setsockopt SO_BUSY_POLL");
+		socketBusyPoll_ = 0;
+	}
 }
 
 void EventLoop::addHttpConnection(SP_HttpHandler handler)
@@ -224,9 +461,21 @@ void EventLoop::addHttpConnection(SP_HttpHandler handler)
 	manager_->addNewHttpConnection(handler);
 }
 
-void EventLoop::flushKeepAlive(SP_Channel &channel, HttpManager::TimerNode &node)
+void EventLoop::migrateIdleConnections(EventLoop *target, size_t count)
+{
+	assert(isInLoopThread());
+	manager_->migrateIdle(target, count);
+}
+
+void EventLoop::adoptHttpConnections(const std::vector<MigratedConnection> &connections)
+{
+	assert(isInLoopThread());
+	manager_->adoptConnections(connections);
+}
+
+void EventLoop::flushKeepAlive(HttpHandler *handler)
 {
-	manager_->flushKeepAlive(channel, node);
+	manager_->flushKeepAlive(handler);
 }
 
 } //namespace webserver
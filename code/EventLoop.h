@@ -1,7 +1,10 @@
 #ifndef code_EventLoop_h
 #define code_EventLoop_h
 
-#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <string>
 #include <vector>
 #include <memory>
 #include <functional>
@@ -9,11 +12,15 @@
 
 #include "CurrentThread.h"
 #include "HttpManager.h"
+#include "MpscQueue.h"
+#include "NodePool.h"
+#include "Poller.h"
+#include "SmallFunction.h"
+#include "TimerQueue.h"
 
 namespace webserver
 {
 
-class Epoll;
 class Channel;
 class HttpHandler;
 class HttpManager;
@@ -21,11 +28,12 @@ class HttpManager;
 class EventLoop
 {
 public:
-	typedef std::function<void ()> Functor;
+	typedef SmallFunction<void ()> Functor;
+	typedef TimerQueue::TimerCallback TimerCallback;
 	// SP_Channel 是一个指向 Channel 类对象的共享指针类型。
 	typedef std::shared_ptr<Channel> SP_Channel;
-	// 这个向量用于存储多个 Channel 对象的共享指针，通常用于表示一组通道。
-	typedef std::vector<SP_Channel> ChannelVector;
+	// 本轮激活的通道，只保存裸指针。
+	typedef Poller::ChannelList ChannelList;
 	// 管理 HttpHandler 对象的生命周期。
 	typedef std::shared_ptr<HttpHandler> SP_HttpHandler;
 	
@@ -45,18 +53,82 @@ public:
 	// 将回调函数排队到事件循环线程中执行。
 	void queueInLoop(Functor &&cb);
 	
+	/* timers, only in the loop thread */
+	// 定时器，只能在事件循环线程中调用；返回的id可用于cancel。
+	// runAfter/runEvery的时间单位为秒。
+	TimerId runAt(Timestamp time, TimerCallback &&cb);
+	TimerId runAfter(double delay, TimerCallback &&cb);
+	TimerId runEvery(double interval, TimerCallback &&cb);
+	// 已触发或已取消的id直接忽略。
+	void cancel(TimerId timerId);
+	const TimerQueue &timerQueue() const { return *timerQueue_; }
+	
+	/* busy polling, opt-in, only in the loop thread (e.g. ThreadInitCallback) */
+	// 忙轮询：poll返回事件后以0超时继续poll，预算时间内没有新事件才阻塞，省去睡眠与唤醒的延迟。
+	// 预算随最近的事件间隔自适应：空转期间等到了事件则加倍，整段空转没有事件则减半，不超过maxBudgetUs。
+	// maxBudgetUs为0时关闭。socketBusyPollUs>0时，对交给本循环的新连接设置SO_BUSY_POLL。
+	void setBusyPoll(int maxBudgetUs, int socketBusyPollUs = 0);
+	bool busyPolling() const { return busyPollMax_ > 0; }
+	Timestamp busyPollBudget() const { return busyPollBudget_; }
+	// 没有事件的0超时poll次数，与返回了事件的poll次数，据此判断空转的CPU是否值得。
+	uint64_t idleSpins() const { return idleSpins_; }
+	uint64_t usefulPolls() const { return usefulPolls_; }
+	// 空转期间等到的事件，即省去的睡眠唤醒次数。
+	uint64_t spinHits() const { return spinHits_; }
+	// 新连接加入本循环时调用。
+	void applySocketBusyPoll(int sockfd);
+	
+	/* load published to the dispatcher: relaxed atomics, read from any thread without locks */
+	// 发布给分发线程的负载，任何线程都可以不加锁地读取。
+	// 连接数包括已分配给本循环、尚在任务队列中的连接：交出连接的一方调用connectionAssigned，
+	// 连接关闭时由本循环调用connectionReleased。
+	void connectionAssigned() { connections_.fetch_add(1, std::memory_order_relaxed); }
+	void connectionReleased() { connections_.fetch_sub(1, std::memory_order_relaxed); }
+	int connectionCount() const { return connections_.load(std::memory_order_relaxed); }
+	// 处理事件(poll之外)的时间占比，千分比，按窗口做指数加权平均。
+	int busyPermille() const { return busyPermille_.load(std::memory_order_relaxed); }
+	
+	/* 每轮poll返回后读取一次的粗粒度时钟，本轮中的处理共用，不再各自读时钟 */
+	// 单调时钟(CLOCK_MONOTONIC_COARSE)，微秒，精度为一个时钟节拍。
+	Timestamp now() const { return now_; }
+	// 墙上时间(CLOCK_REALTIME_COARSE)，秒。
+	time_t wallTime() const { return wallTime_; }
+	// RFC 7231格式的当前时间，如"Sun, 06 Nov 1994 08:49:37 GMT"，每秒最多格式化一次。
+	const std::string &httpDate();
+	// httpDate()实际格式化的次数。
+	uint64_t httpDateFormats() const { return httpDateFormats_; }
+	
 	/* assert whether in the loop thread or not */
 	// 检查当前线程是否为事件循环线程。
 	bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 	
 	/* internel usage */
 	// 内部使用的方法，用于更新和移除事件循环的通道。
-	void updateChannel(SP_Channel channel);
+	// updateChannel只做标记，在下一次poll之前由flushChannelUpdates统一提交；removeChannel立即生效。
+	void updateChannel(Channel *channel);
 	void removeChannel(SP_Channel channel);
 	
+	/* 兴趣集合的修改次数，与实际提交给Poller的次数，二者之差即省去的epoll_ctl */
+	uint64_t channelUpdates() const { return channelUpdates_; }
+	uint64_t pollerUpdates() const { return pollerUpdates_; }
+	uint64_t savedPollerUpdates() const { return channelUpdates_ - pollerUpdates_; }
+	
+	/* io_uring后端：recv/accept/send以完成事件的形式交付 */
+	bool completionIo() const { return completionIo_; }
+	bool submitSend(SP_Channel &channel, const struct iovec *iov, int iovcnt,
+	                int flags, std::shared_ptr<void> guard)
+	{ return poller_->submitSend(channel, iov, iovcnt, flags, std::move(guard)); }
+	
+	/* 本轮事件循环结束后才释放，分发路径上的裸指针在本轮内始终有效 */
+	void releaseLater(std::shared_ptr<void> object)
+	{ releaseLater_.push_back(std::move(object)); }
+	
 	//  执行排队的回调函数。
 	void doPendingFunctors();
 	
+	// 提交本轮修改过的兴趣集合。
+	void flushChannelUpdates();
+	
 	// 唤醒事件循环线程的方法。
 	void wakeupRead();
 	void wakeup();
@@ -67,7 +139,15 @@ public:
 	// 支持 HTTP 的方法，用于添加 HTTP 连接和刷新保持连接。
 	/* support Http */
 	void addHttpConnection(SP_HttpHandler handler);
-	void flushKeepAlive(SP_Channel &channel, HttpManager::TimerNode &node);
+	void flushKeepAlive(HttpHandler *handler);
+	
+	/* 连接迁移，只在本线程中调用，由线程池的负载均衡发起 */
+	// 把至多count个空闲的keep-alive连接交给target，只支持epoll后端。
+	void migrateIdleConnections(EventLoop *target, size_t count);
+	// 接收其他事件循环交出的连接。
+	void adoptHttpConnections(const std::vector<MigratedConnection> &connections);
+	uint64_t migratedIn() const { return manager_->migratedIn(); }
+	uint64_t migratedOut() const { return manager_->migratedOut(); }
 	
 private:
 	// 标志着事件循环是否处于运行状态。
@@ -76,23 +156,71 @@ private:
 	bool quit_;
 	// 记录事件循环所属的线程 ID。
 	pid_t threadId_;
-	// 持有一个 Epoll 对象，用于事件的轮询和管理。
-	std::unique_ptr<Epoll> poller_;
+	// 持有一个 Poller 对象(epoll或io_uring)，用于事件的轮询和管理。
+	std::unique_ptr<Poller> poller_;
+	// 缓存poller_->completionIo()。
+	const bool completionIo_;
 	// 用于唤醒事件循环线程的文件描述符。
 	int wakeupFd_;
 	
 	// 持有一个 Channel 对象，该通道与 wakeupFd_ 相关联，用于处理唤醒事件。在构造函数中，设置了读事件的回调函数，并启用了读事件监听。
 	std::shared_ptr<Channel> wakeupChannel_;
 	// 存储当前轮询到的活跃通道，即有事件发生的文件描述符集合。在 loop() 函数中，用于处理这些活跃通道的事件。
-	ChannelVector activateChannels_;
+	// 每轮复用，不重新分配。
+	ChannelList activeChannels_;
+	// 本轮修改过兴趣集合的Channel，poll之前统一提交。
+	std::vector<SP_Channel> dirtyChannels_;
+	uint64_t channelUpdates_;
+	uint64_t pollerUpdates_;
+	// 本轮被移除的Channel与HttpHandler，在本轮结束时释放。
+	std::vector<std::shared_ptr<void>> releaseLater_;
+	
+	// 排队的回调函数，节点内嵌在任务中，入队不加锁。
+	struct PendingTask : MpscNode
+	{
+		explicit PendingTask(Functor &&cb) : functor(std::move(cb)) {}
+		Functor functor;
+	};
+	MpscQueue pendingFunctors_;
+	// 任务节点的内存池，投递连接等常见回调不分配内存。
+	NodePool<PendingTask> taskPool_;
+	// 析构任务节点并归还内存池。
+	void releaseTask(PendingTask *task);
+	// 已写过eventfd且尚未被取走，其他线程不再重复写。
+	std::atomic<bool> wakeupPending_;
+	
+	// 缓存的时钟，须先于manager_初始化。
+	Timestamp now_;
+	time_t wallTime_;
+	void updateClock();
+	// httpDate_对应的墙上时间。
+	time_t httpDateTime_;
+	std::string httpDate_;
+	uint64_t httpDateFormats_;
+	
+	// 忙轮询的预算上限与当前预算(us)，0为关闭。
+	Timestamp busyPollMax_;
+	Timestamp busyPollBudget_;
+	// 空转截止时间，0表示下一次poll阻塞。
+	Timestamp spinUntil_;
+	int socketBusyPoll_;
+	uint64_t idleSpins_;
+	uint64_t usefulPolls_;
+	uint64_t spinHits_;
+	// 根据本次poll是否有事件调整空转窗口与预算。
+	void adaptBusyPoll(bool gotEvents);
 	
-	// 标志着是否正在执行排队的回调函数。在 doPendingFunctors() 函数中，用于防止在处理回调函数时再次调用 wakeup()。
-	bool callingPendingFucntors_;
-	// 存储待执行的回调函数。在 queueInLoop() 函数中，将回调函数放入这个队列中，在 doPendingFunctors() 函数中执行这些回调函数。
-	std::vector<Functor> pendingFunctors_;
+	// 负载统计窗口的起点，与窗口内的忙碌时间(us)，均用粗粒度时钟。
+	Timestamp loadWindowStart_;
+	Timestamp busyInWindow_;
+	// 计入本轮的忙碌时间，窗口结束时更新busyPermille_。
+	void updateLoad(Timestamp busy);
+	// 分发线程每次分配连接都会写connections_，单独占一个缓存行。
+	alignas(64) std::atomic<int> connections_;
+	std::atomic<int> busyPermille_;
 	
-	// 互斥锁，用于保护 pendingFunctors_ 队列的访问。
-	std::mutex mutex_;	/* be used by functor vector */
+	// 所有定时器共用一个timerfd，须先于manager_构造、后于其析构。
+	std::unique_ptr<TimerQueue> timerQueue_;
 	
 	/* 由事件循环处理各个Http请求 */
 	/* 先调用Channel的handleEvent，接受数据 */
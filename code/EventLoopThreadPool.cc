@@ -1,6 +1,9 @@
 #include "EventLoopThreadPool.h"
 
 #include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
 
 #include "EventLoop.h"
 #include "macros.h"
@@ -10,12 +13,22 @@
 
 namespace webserver
 {
+
+// 负载最高的循环超过最低的5/4，且连接数至少相差这么多时才迁移。
+static const int kMinRebalanceGap = 4;
+// 每轮最多迁移的连接数。
+static const int kMaxMigrations = 256;
 	
 EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, int numThreads)
 	: baseLoop_(baseLoop),
 	  started_(false),
 	  numThreads_(numThreads),
-	  next_(0)
+	  next_(0),
+	  policy_(kRoundRobin),
+	  seed_(2463534242u),
+	  rebalanceInterval_(0),
+	  rebalanceTimer_(0),
+	  rebalances_(0)
 {
 #ifdef EVENTLOOPTHREADPOOLBUG
 	printf("EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, int numThreads) \n");
@@ -24,6 +37,10 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, int numThreads)
 
 EventLoopThreadPool::~EventLoopThreadPool()
 {
+	if(rebalanceTimer_ != 0)
+	{
+		baseLoop_->cancel(rebalanceTimer_);
+	}
 	// Don't delete loop, it's stack variable
 }	
 
@@ -58,11 +75,31 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
 	{
 		cb(baseLoop_);
 	}
+	
+	if(rebalanceInterval_ > 0 && loops_.size() > 1)
+	{
+		if(baseLoop_->completionIo())
+		{
+			fprintf(stderr, "rebalance: not supported with io_uring\n");
+			return ;
+		}
+		rebalanceTimer_ = baseLoop_->runEvery(rebalanceInterval_,
+		                                      std::bind(&EventLoopThreadPool::rebalance, this));
+	}
+}
+
+bool EventLoopThreadPool::parseDispatchPolicy(const char *name, DispatchPolicy *policy)
+{
+	if(strcmp(name, "rr") == 0) *policy = kRoundRobin;
+	else if(strcmp(name, "least") == 0) *policy = kLeastConnections;
+	else if(strcmp(name, "p2c") == 0) *policy = kPowerOfTwoChoices;
+	else return false;
+	return true;
 }
 
 //sub-reactor
-// 函数用于获取下一个可用的事件循环对象，采用轮询（round-robin）方式选择。
-// 如果线程池中存在子线程，则按顺序选择下一个线程的事件循环，实现了基本的负载均衡。
+// 函数用于获取下一个可用的事件循环对象，默认采用轮询（round-robin）方式选择。
+// 如果线程池中存在子线程，则按分发策略选择一个线程的事件循环。
 EventLoop* EventLoopThreadPool::getNextLoop()
 {
 
@@ -73,6 +110,15 @@ EventLoop* EventLoopThreadPool::getNextLoop()
 	assert(unlikely(baseLoop_->isInLoopThread()));
 	EventLoop *loop = baseLoop_;
 	
+	if(loops_.size() > 1 && policy_ == kLeastConnections)
+	{
+		return leastConnectionsLoop();
+	}
+	if(loops_.size() > 1 && policy_ == kPowerOfTwoChoices)
+	{
+		return twoChoicesLoop();
+	}
+	
 	if(!loops_.empty())
 	{
 		//round-robin
@@ -86,4 +132,94 @@ EventLoop* EventLoopThreadPool::getNextLoop()
 	return loop;
 }
 
+/* 从next_开始扫描，负载相同的事件循环轮流被选中 */
+EventLoop* EventLoopThreadPool::leastConnectionsLoop()
+{
+	const size_t n = loops_.size();
+	size_t best = static_cast<size_t>(next_);
+	int bestConnections = loops_[best]->connectionCount();
+	int bestBusy = loops_[best]->busyPermille();
+	for(size_t i=1; i<n; ++i)
+	{
+		size_t index = (static_cast<size_t>(next_) + i) % n;
+		int connections = loops_[index]->connectionCount();
+		if(connections > bestConnections) continue;
+		
+		int busy = loops_[index]->busyPermille();
+		if(connections < bestConnections || busy < bestBusy)
+		{
+			best = index;
+			bestConnections = connections;
+			bestBusy = busy;
+		}
+	}
+	next_ = static_cast<int>((best + 1) % n);
+	return loops_[best];
+}
+
+/* 负载用整数比较：(连接数+1) * (1000+忙碌千分比) */
+static int64_t weightedLoad(const EventLoop *loop)
+{
+	return static_cast<int64_t>(loop->connectionCount() + 1) * (1000 + loop->busyPermille());
+}
+
+/* 只读取各循环发布的负载，迁移由负载最高的循环在自己的线程中完成 */
+/* 上一轮的迁移在下一轮之前早已完成，读到的连接数已反映迁移结果 */
+void EventLoopThreadPool::rebalance()
+{
+	size_t busiest = 0;
+	size_t idlest = 0;
+	int64_t maxLoad = weightedLoad(loops_[0]);
+	int64_t minLoad = maxLoad;
+	for(size_t i=1; i<loops_.size(); ++i)
+	{
+		int64_t load = weightedLoad(loops_[i]);
+		if(load > maxLoad)
+		{
+			maxLoad = load;
+			busiest = i;
+		}
+		if(load < minLoad)
+		{
+			minLoad = load;
+			idlest = i;
+		}
+	}
+	
+	const int gap = loops_[busiest]->connectionCount() - loops_[idlest]->connectionCount();
+	if(maxLoad * 4 <= minLoad * 5 || gap < kMinRebalanceGap) return ;
+	
+	/* 迁走差值的一半，两边的连接数持平 */
+	EventLoop *source = loops_[busiest];
+	const size_t count = static_cast<size_t>(std::min(kMaxMigrations, gap / 2));
+	++rebalances_;
+	source->queueInLoop(std::bind(&EventLoop::migrateIdleConnections, source,
+	                              loops_[idlest], count));
+}
+
+EventLoop* EventLoopThreadPool::twoChoicesLoop()
+{
+	const uint32_t n = static_cast<uint32_t>(loops_.size());
+	
+	/* xorshift32，取两个不同的下标 */
+	seed_ ^= seed_ << 13;
+	seed_ ^= seed_ >> 17;
+	seed_ ^= seed_ << 5;
+	uint32_t a = seed_ % n;
+	uint32_t b = (seed_ / n) % (n - 1);
+	if(b >= a) ++b;
+	
+	return weightedLoad(loops_[b]) < weightedLoad(loops_[a]) ? loops_[b] : loops_[a];
+}
+
+std::vector<EventLoop *> EventLoopThreadPool::getAllLoops() const
+{
+	assert(started_);
+	if(loops_.empty())
+	{
+		return std::vector<EventLoop *>(1, baseLoop_);
+	}
+	return loops_;
+}
+
 } //namespace webserver
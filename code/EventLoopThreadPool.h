@@ -1,9 +1,11 @@
 #ifndef code_EventLoopThreadPool_h
 #define code_EventLoopThreadPool_h
 
+#include <cstdint>
 #include <functional>
 #include <vector>
 
+#include "TimerQueue.h"
 #include "noncopyable.h"
 
 namespace webserver
@@ -20,6 +22,13 @@ public:
 	// EventLoopThreadPool 类声明了一个类型别名 ThreadInitCallback，它是一个接受 EventLoop* 参数的函数回调。
 	typedef std::function<void (EventLoop*)> ThreadInitCallback;
 	
+	// 新连接的分发策略，负载由各事件循环以relaxed原子变量发布，分发时不加锁
+	// kRoundRobin：轮流分配
+	// kLeastConnections：连接数最少的事件循环，相同时取忙碌占比低的，再相同时轮流
+	// kPowerOfTwoChoices：随机取两个，选负载低的；负载为连接数按忙碌占比加权，
+	//                     满负荷的循环相当于连接数翻倍
+	enum DispatchPolicy { kRoundRobin, kLeastConnections, kPowerOfTwoChoices };
+	
 	// 接受一个指向主事件循环 baseLoop 的指针，以及线程池中的线程数量 numThreads。
 	EventLoopThreadPool(EventLoop* baseLoop, int numThreads = 0);
 	~EventLoopThreadPool();
@@ -27,10 +36,30 @@ public:
 	// 方法用于启动所有事件循环线程，并可以通过可选的回调函数 ThreadInitCallback 进行额外的初始化。
 	void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
+	// "rr"、"least"或"p2c"，失败时返回false
+	static bool parseDispatchPolicy(const char *name, DispatchPolicy *policy);
+	void setDispatchPolicy(DispatchPolicy policy) { policy_ = policy; }
+	DispatchPolicy dispatchPolicy() const { return policy_; }
+
+	// 在start之前设置，主事件循环每隔seconds秒比较各I/O线程的负载，负载相差超过1/4时，
+	// 把空闲的keep-alive连接从负载最高的循环迁到最低的循环；0为关闭(默认)，io_uring后端不支持。
+	void setRebalanceInterval(double seconds) { rebalanceInterval_ = seconds; }
+	// 已发起的迁移轮数。
+	uint64_t rebalances() const { return rebalances_; }
+
 	// 获取下一个要处理事件的事件循环对象。
+	// 只读取负载；把连接交给返回的事件循环时，由调用方调用其connectionAssigned。
 	EventLoop* getNextLoop();
 	
+	// 所有I/O线程的事件循环，没有I/O线程时只有主事件循环。start之后调用。
+	std::vector<EventLoop *> getAllLoops() const;
+	
 private:
+	EventLoop* leastConnectionsLoop();
+	EventLoop* twoChoicesLoop();
+	// 周期定时器回调，在主事件循环中运行。
+	void rebalance();
+
 	// 存储主事件循环的指针。
 	EventLoop* baseLoop_;	/* main loop */
 	bool started_;
@@ -38,6 +67,13 @@ private:
 
 	// 表示下一个要获取事件循环对象的线程索引。
 	int next_;
+	DispatchPolicy policy_;
+	// kPowerOfTwoChoices的随机数状态(xorshift)，只在主事件循环线程中使用。
+	uint32_t seed_;
+	double rebalanceInterval_;
+	// 主事件循环上的周期定时器，未开启时为0。
+	TimerId rebalanceTimer_;
+	uint64_t rebalances_;
 	// 是一个存储事件循环线程的指针的向量。
 	std::vector<EventLoopThread *> threads_;
 	// 是一个存储事件循环对象的指针的向量。
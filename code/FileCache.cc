@@ -0,0 +1,334 @@
+#include "FileCache.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <vector>
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <strings.h>
+
+#include "Channel.h"
+#include "EventLoop.h"
+#include "macros.h"
+
+namespace webserver
+{
+
+/* 文件或目录发生变化，相关缓存项都要删除 */
+static const uint32_t kWatchMask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+                                   IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                   IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+static const struct
+{
+	const char *ext;
+	const char *type;
+} kContentTypes[] = {
+	{ "html", "text/html" },
+	{ "htm",  "text/html" },
+	{ "css",  "text/css" },
+	{ "js",   "application/javascript" },
+	{ "json", "application/json" },
+	{ "txt",  "text/plain" },
+	{ "xml",  "text/xml" },
+	{ "png",  "image/png" },
+	{ "jpg",  "image/jpeg" },
+	{ "jpeg", "image/jpeg" },
+	{ "gif",  "image/gif" },
+	{ "svg",  "image/svg+xml" },
+	{ "ico",  "image/x-icon" },
+	{ "pdf",  "application/pdf" },
+	{ "mp4",  "video/mp4" },
+};
+
+FileCache::FileCache(EventLoop *loop, const std::string &root, size_t maxEntries)
+	: loop_(loop),
+	  root_(root.empty() || root.back() == '/' ? root : root + "/"),
+	  inotifyFd_(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+	  inotifyChannel_(new Channel(inotifyFd_, loop_)),
+	  maxEntries_(maxEntries),
+	  generation_(0),
+	  clockHand_(0),
+	  evictions_(0)
+{
+	assert(maxEntries_ > 0);
+	assert(inotifyFd_ > 0);
+	inotifyChannel_->setReadCallback(std::bind(&FileCache::handleRead, this));
+	inotifyChannel_->enableReading();
+}
+
+FileCache::~FileCache()
+{
+	/* 文件描述符由Channel关闭 */
+}
+
+size_t FileCache::size()
+{
+	std::shared_lock<std::shared_mutex> lock(mutex_);
+	return entries_.size();
+}
+
+uint64_t FileCache::evictions()
+{
+	std::shared_lock<std::shared_mutex> lock(mutex_);
+	return evictions_;
+}
+
+FileCache::SP_Entry FileCache::get(const std::string &path)
+{
+	/* 命中：所有事件循环共享读锁，只在引用位未置位时写一次 */
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex_);
+		auto it = entries_.find(path);
+		if(likely(it != entries_.end()))
+		{
+			Slot &slot = it->second;
+			if(!slot.referenced.load(std::memory_order_relaxed))
+			{
+				slot.referenced.store(true, std::memory_order_relaxed);
+			}
+			return slot.entry;
+		}
+	}
+
+	std::string::size_type slash = path.rfind('/');
+	std::string dir = (slash == std::string::npos) ? std::string()
+	                                               : path.substr(0, slash+1);
+	uint64_t generation;
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex_);
+		/* 先监控目录再打开文件，之后的修改一定能收到通知 */
+		watchDirLocked(dir);
+		generation = generation_;
+	}
+
+	/* 未命中，在锁外打开文件 */
+	SP_Entry entry = open(path);
+	if(entry == nullptr) return entry;
+
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex_);
+		if(generation == generation_)
+		{
+			/* 其他线程可能已经插入 */
+			auto it = entries_.find(path);
+			if(it != entries_.end()) return it->second.entry;
+			
+			if(entries_.size() >= maxEntries_) evictLocked();
+			auto ret = entries_.emplace(path, entry);
+			return ret.first->second.entry;
+		}
+	}
+
+	/* 期间文件有变化，本次不缓存 */
+	return entry;
+}
+
+/* CLOCK：按桶顺序检查，引用位已置位的清除后跳过，淘汰第一个未置位的 */
+/* 至多两圈：第一圈清除所有引用位后，第二圈一定能找到 */
+/* 淘汰的缓存项仍被正在发送的连接持有时，文件描述符在其发送完后关闭 */
+void FileCache::evictLocked()
+{
+	const size_t buckets = entries_.bucket_count();
+	for(size_t step = 0; step < 2 * buckets; ++step)
+	{
+		const size_t bucket = clockHand_++ % buckets;
+		for(auto it = entries_.begin(bucket); it != entries_.end(bucket); ++it)
+		{
+			if(!it->second.referenced.exchange(false, std::memory_order_relaxed))
+			{
+				const std::string victim = it->first;
+				entries_.erase(victim);
+				++evictions_;
+				return ;
+			}
+		}
+	}
+}
+
+FileCache::SP_Entry FileCache::open(const std::string &path)
+{
+	int fd = ::open((root_ + path).c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0) return nullptr;
+
+	struct stat st;
+	if(unlikely(::fstat(fd, &st) < 0) || !S_ISREG(st.st_mode))
+	{
+		::close(fd);
+		return nullptr;
+	}
+
+	std::shared_ptr<Entry> entry(new Entry);
+	entry->file.reset(new FileHandle(fd));
+	entry->size = static_cast<size_t>(st.st_size);
+	entry->mtime = st.st_mtim;
+	entry->contentType = contentType(path);
+
+	char etag[64];
+	snprintf(etag, sizeof(etag), "\"%lx-%lx%08lx\"",
+	         static_cast<unsigned long>(st.st_size),
+	         static_cast<unsigned long>(st.st_mtim.tv_sec),
+	         static_cast<unsigned long>(st.st_mtim.tv_nsec));
+	entry->etag = etag;
+
+	return entry;
+}
+
+void FileCache::watchDirLocked(const std::string &dir)
+{
+	if(watchedDirs_.count(dir)) return ;
+
+	int wd = ::inotify_add_watch(inotifyFd_, (root_ + dir).c_str(), kWatchMask);
+	if(unlikely(wd < 0))
+	{
+		/* 目录不存在时，文件也打不开，不会被缓存 */
+		return ;
+	}
+	watches_[wd] = dir;
+	watchedDirs_[dir] = wd;
+}
+
+void FileCache::invalidateLocked(const std::string &path)
+{
+	++generation_;
+	entries_.erase(path);
+}
+
+/* 删除目录下的所有缓存项，并取消对该目录的监控 */
+void FileCache::invalidateDirLocked(const std::string &dir)
+{
+	++generation_;
+	for(auto it = entries_.begin(); it != entries_.end(); )
+	{
+		if(it->first.compare(0, dir.size(), dir) == 0)
+			it = entries_.erase(it);
+		else
+			++it;
+	}
+
+	for(auto it = watchedDirs_.begin(); it != watchedDirs_.end(); )
+	{
+		if(it->first.compare(0, dir.size(), dir) == 0)
+		{
+			::inotify_rm_watch(inotifyFd_, it->second);
+			watches_.erase(it->second);
+			it = watchedDirs_.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void FileCache::handleRead()
+{
+	assert(loop_->isInLoopThread());
+
+	alignas(struct inotify_event) char buf[4096];
+
+	while(true)
+	{
+		ssize_t n = ::read(inotifyFd_, buf, sizeof(buf));
+		if(n <= 0)
+		{
+			if(n < 0 && errno == EINTR) continue;
+			break;	/* EAGAIN */
+		}
+
+		std::unique_lock<std::shared_mutex> lock(mutex_);
+		for(char *p = buf; p < buf + n; )
+		{
+			const struct inotify_event *ev =
+				reinterpret_cast<const struct inotify_event *>(p);
+			p += sizeof(struct inotify_event) + ev->len;
+
+			if(unlikely(ev->mask & IN_Q_OVERFLOW))
+			{
+				/* 丢失了事件，全部作废 */
+				invalidateDirLocked(std::string());
+				continue;
+			}
+
+			auto it = watches_.find(ev->wd);
+			if(it == watches_.end()) continue;
+			std::string dir = it->second;
+
+			if(ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+			{
+				/* 目录本身被删除或移动 */
+				invalidateDirLocked(dir);
+			}
+			else if(ev->len > 0)
+			{
+				std::string path = dir + ev->name;
+				if(ev->mask & IN_ISDIR)
+					invalidateDirLocked(path + "/");
+				else
+					invalidateLocked(path);
+			}
+		}
+	}
+}
+
+bool FileCache::normalizePath(std::string_view path, std::string &out)
+{
+	if(path.empty() || path[0] != '/') return false;
+
+	/* 忽略查询串 */
+	std::string_view::size_type end = path.find('?');
+	if(end == std::string_view::npos) end = path.size();
+
+	std::vector<std::string::size_type> segments;	/* 每段在out中的起始位置 */
+	out.clear();
+
+	std::string_view::size_type bpos = 0;
+	while(bpos < end)
+	{
+		while(bpos < end && path[bpos] == '/') ++bpos;
+		std::string_view::size_type epos = path.find('/', bpos);
+		if(epos == std::string_view::npos || epos > end) epos = end;
+
+		std::string_view::size_type len = epos - bpos;
+		if(len == 0 || (len == 1 && path[bpos] == '.'))
+		{
+			/* 空段或"." */
+		}
+		else if(len == 2 && path[bpos] == '.' && path[bpos+1] == '.')
+		{
+			/* 越出根目录 */
+			if(segments.empty()) return false;
+			out.resize(segments.back() == 0 ? 0 : segments.back() - 1);
+			segments.pop_back();
+		}
+		else
+		{
+			if(!out.empty()) out += '/';
+			segments.push_back(out.size());
+			out.append(path.data() + bpos, len);
+		}
+		bpos = epos;
+	}
+
+	return true;
+}
+
+const char *FileCache::contentType(const std::string &path)
+{
+	std::string::size_type dot = path.rfind('.');
+	if(dot != std::string::npos && path.find('/', dot) == std::string::npos)
+	{
+		const char *ext = path.c_str() + dot + 1;
+		for(const auto &t : kContentTypes)
+		{
+			if(::strcasecmp(ext, t.ext) == 0) return t.type;
+		}
+	}
+	return "application/octet-stream";
+}
+
+} //namespace webserver
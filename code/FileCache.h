@@ -0,0 +1,108 @@
+#ifndef code_FileCache_h
+#define code_FileCache_h
+
+#include <atomic>
+#include <ctime>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "OutputQueue.h"
+#include "noncopyable.h"
+
+namespace webserver
+{
+
+class Channel;
+class EventLoop;
+
+/*
+ * open-file and metadata cache of the document root
+ * obligation: keep opened fds and stat data of static files,
+ *             drop entries when inotify reports a change
+ * owner: HttpServer, shared by all event loops
+ */
+// 静态文件缓存：已打开的fd + stat数据 + 预先生成的ETag/Content-Type
+// 命中时不再有access/stat/open/close等系统调用
+// 由inotify监控文件所在目录，文件变化时删除缓存项
+// 命中只持有读锁；缓存已满时按CLOCK淘汰最近未被访问的缓存项
+class FileCache : noncopyable
+{
+public:
+	struct Entry
+	{
+		OutputQueue::SP_File file;
+		size_t size;
+		struct timespec mtime;
+		std::string etag;
+		const char *contentType;
+	};
+	typedef std::shared_ptr<const Entry> SP_Entry;
+
+	// 缓存项上限的默认值，避免占用过多文件描述符
+	static const size_t kMaxEntries = 1024;
+
+	/* inotify由loop监听，须在loop线程中构造 */
+	FileCache(EventLoop *loop, const std::string &root, size_t maxEntries = kMaxEntries);
+	~FileCache();
+
+	/* 查找规范化后的相对路径，文件不存在或不是普通文件时返回nullptr */
+	/* 可被多个事件循环线程并发调用 */
+	SP_Entry get(const std::string &path);
+
+	/* 规范化请求路径：去掉多余的'/'，处理"."和".." */
+	/* 越出根目录时返回false */
+	static bool normalizePath(std::string_view path, std::string &out);
+	/* 根据扩展名得到Content-Type */
+	static const char *contentType(const std::string &path);
+
+	size_t size();
+	/* 因缓存已满被淘汰的缓存项数 */
+	uint64_t evictions();
+
+private:
+	/* inotify可读时被调用 */
+	void handleRead();
+
+	SP_Entry open(const std::string &path);
+	/* 以下函数调用时须持有mutex_的写锁 */
+	void watchDirLocked(const std::string &dir);
+	void evictLocked();
+	void invalidateLocked(const std::string &path);
+	void invalidateDirLocked(const std::string &dir);
+
+private:
+	EventLoop *loop_;
+	const std::string root_;
+	int inotifyFd_;
+	std::shared_ptr<Channel> inotifyChannel_;
+
+	/* 缓存项与引用位；命中在读锁下置位，淘汰在写锁下清除 */
+	struct Slot
+	{
+		explicit Slot(const SP_Entry &e) : entry(e), referenced(false) {}
+		SP_Entry entry;
+		std::atomic<bool> referenced;
+	};
+
+	const size_t maxEntries_;
+	std::shared_mutex mutex_;
+	/* 每次删除缓存项时递增，防止未命中期间文件变化后插入旧数据 */
+	uint64_t generation_;
+	/* 相对路径 -> 缓存项 */
+	std::unordered_map<std::string, Slot> entries_;
+	/* CLOCK指针，指向下一个检查的桶 */
+	size_t clockHand_;
+	uint64_t evictions_;
+	/* inotify watch描述符 <-> 相对目录("" 表示根目录) */
+	std::unordered_map<int, std::string> watches_;
+	std::unordered_map<std::string, int> watchedDirs_;
+};
+
+} //namespace webserver
+
+#endif
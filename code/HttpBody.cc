@@ -0,0 +1,249 @@
+#include "HttpBody.h"
+
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cstring>
+
+#include "Buffer.h"
+#include "HttpHeaders.h"
+
+namespace webserver
+{
+
+HttpBody::HttpBody(size_t limit)
+	: limit_(limit)
+{
+	reset();
+}
+
+void HttpBody::reset()
+{
+	mode_ = kNoBody;
+	chunkState_ = kChunkSize;
+	streaming_ = false;
+	begin_ = 0;
+	held_ = 0;
+	pos_ = 0;
+	remaining_ = 0;
+	total_ = 0;
+}
+
+/* 逐个检查所有Content-Length字段及其中逗号分隔的值，全部相同时得到长度 */
+/* RFC 7230 3.3.2: "Content-Length: 42, 42"可以接受，值不一致时必须拒绝 */
+/* 没有该字段时*found为false；格式错误或不一致时返回false */
+static bool parseContentLength(const HttpHeaders &headers, size_t *len, bool *found)
+{
+	*found = false;
+	for(size_t i=0; i<headers.size(); ++i)
+	{
+		if(!HttpHeaders::equalsIgnoreCase(headers.key(i), "Content-Length")) continue;
+
+		std::string_view list = headers.value(i);
+		while(true)
+		{
+			size_t comma = list.find(',');
+			std::string_view item = list.substr(0, comma);
+			while(!item.empty() && (item.front() == ' ' || item.front() == '\t'))
+				item.remove_prefix(1);
+			while(!item.empty() && (item.back() == ' ' || item.back() == '\t'))
+				item.remove_suffix(1);
+
+			size_t value = 0;
+			auto ret = std::from_chars(item.data(), item.data()+item.size(), value);
+			if(item.empty() || ret.ec != std::errc() || ret.ptr != item.data()+item.size())
+				return false;
+			if(*found && value != *len) return false;
+			*found = true;
+			*len = value;
+
+			if(comma == std::string_view::npos) break;
+			list.remove_prefix(comma + 1);
+		}
+	}
+	return true;
+}
+
+/* RFC 7230 3.3.3: Transfer-Encoding优先，且最后一个编码必须是chunked */
+/* 同时带有两者、或多个Content-Length不一致的请求可能被用于请求走私，直接拒绝 */
+bool HttpBody::start(const HttpHeaders &headers, size_t begin)
+{
+	reset();
+	begin_ = begin;
+	pos_ = begin;
+
+	std::string_view encoding;
+	bool hasEncoding = headers.find("Transfer-Encoding", encoding);
+	size_t len = 0;
+	bool hasLength = false;
+	if(!parseContentLength(headers, &len, &hasLength)) return false;
+
+	if(hasEncoding)
+	{
+		if(hasLength) return false;
+
+		size_t comma = encoding.rfind(',');
+		std::string_view last = comma == std::string_view::npos ?
+		                        encoding : encoding.substr(comma + 1);
+		if(!HttpHeaders::hasToken(last, "chunked")) return false;
+
+		mode_ = kChunked;
+		return true;
+	}
+
+	if(hasLength)
+	{
+		if(len == 0) return true;
+
+		mode_ = kLength;
+		remaining_ = len;
+		/* 长度已知，超过上限的请求体直接流式交付 */
+		streaming_ = len > limit_;
+	}
+
+	return true;
+}
+
+HttpBody::Result HttpBody::decode(Buffer &buf)
+{
+	assert(pos_ <= buf.readableBytes());
+
+	Result result = kBodyDone;
+	if(mode_ == kLength)
+	{
+		size_t n = std::min(buf.readableBytes() - pos_, remaining_);
+		deliver(buf, n);
+		remaining_ -= n;
+		result = remaining_ == 0 ? kBodyDone : kBodyNeedMore;
+	}
+	else if(mode_ == kChunked)
+	{
+		result = decodeChunked(buf);
+	}
+
+	/* 等待后续数据前，缓冲区只保留请求头、未交付的数据与不完整的分块行 */
+	if(result == kBodyNeedMore) compact(buf);
+	return result;
+}
+
+HttpBody::Result HttpBody::decodeChunked(Buffer &buf)
+{
+	const char *base = buf.peek();
+	const size_t size = buf.readableBytes();
+
+	while(true)
+	{
+		switch(chunkState_)
+		{
+		case kChunkSize:
+		case kChunkTrailer:
+		{
+			const char *line = base + pos_;
+			const char *nl = static_cast<const char *>(::memchr(line, '\n', size - pos_));
+			if(nl == nullptr)
+				return size - pos_ > kMaxChunkLine ? kBodyError : kBodyNeedMore;
+
+			const char *end = nl;
+			if(end > line && end[-1] == '\r') end--;	/* 兼容只有'\n'的行 */
+			if(static_cast<size_t>(end - line) > kMaxChunkLine) return kBodyError;
+			pos_ = nl + 1 - base;
+
+			if(chunkState_ == kChunkTrailer)
+			{
+				/* 空行结束，trailer字段被忽略 */
+				if(end == line) return kBodyDone;
+				break;
+			}
+
+			/* chunk-size [; chunk-ext]，忽略扩展 */
+			size_t chunkSize = 0;
+			auto ret = std::from_chars(line, end, chunkSize, 16);
+			if(ret.ec != std::errc()) return kBodyError;
+			if(ret.ptr != end && *ret.ptr != ';' && *ret.ptr != ' ' && *ret.ptr != '\t')
+				return kBodyError;
+
+			remaining_ = chunkSize;
+			chunkState_ = chunkSize == 0 ? kChunkTrailer : kChunkData;
+			break;
+		}
+
+		case kChunkData:
+		{
+			size_t n = std::min(size - pos_, remaining_);
+			deliver(buf, n);
+			remaining_ -= n;
+			if(remaining_ > 0) return kBodyNeedMore;
+			chunkState_ = kChunkDataEnd;
+			break;
+		}
+
+		case kChunkDataEnd:
+			/* 数据之后的CRLF */
+			if(pos_ == size) return kBodyNeedMore;
+			if(base[pos_] == '\r')
+			{
+				if(pos_ + 1 == size) return kBodyNeedMore;
+				if(base[pos_+1] != '\n') return kBodyError;
+				pos_ += 2;
+			}
+			else if(base[pos_] == '\n')
+			{
+				pos_ += 1;
+			}
+			else
+			{
+				return kBodyError;
+			}
+			chunkState_ = kChunkSize;
+			break;
+		}
+	}
+}
+
+/* [pos_, pos_+n)为解码后的数据 */
+void HttpBody::deliver(Buffer &buf, size_t n)
+{
+	char *base = buf.peek();
+
+	if(!streaming_ && held_ + n > limit_)
+	{
+		/* chunked请求体超过上限，先交付已保存的部分，之后改为流式 */
+		streaming_ = true;
+		if(held_ > 0 && sliceCallback_) sliceCallback_(std::string_view(base + begin_, held_));
+		held_ = 0;
+	}
+
+	if(streaming_)
+	{
+		if(n > 0 && sliceCallback_) sliceCallback_(std::string_view(base + pos_, n));
+	}
+	else
+	{
+		/* 去掉分块格式，数据在请求体起始处保持连续 */
+		if(begin_ + held_ != pos_) ::memmove(base + begin_ + held_, base + pos_, n);
+		held_ += n;
+	}
+
+	pos_ += n;
+	total_ += n;
+}
+
+void HttpBody::compact(Buffer &buf)
+{
+	size_t keep = begin_ + held_;
+	if(pos_ == keep) return;
+
+	char *base = buf.peek();
+	size_t tail = buf.readableBytes() - pos_;
+	::memmove(base + keep, base + pos_, tail);
+	buf.unwrite(pos_ - keep);
+	pos_ = keep;
+}
+
+std::string_view HttpBody::view(const Buffer &buf) const
+{
+	assert(!streaming_);
+	return std::string_view(buf.peek() + begin_, held_);
+}
+
+} //namespace webserver
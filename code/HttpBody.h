@@ -0,0 +1,82 @@
+#ifndef code_HttpBody_h
+#define code_HttpBody_h
+
+#include <cstddef>
+#include <functional>
+#include <string_view>
+
+namespace webserver
+{
+
+class Buffer;
+class HttpHeaders;
+
+/*
+ * incremental request body decoder, Content-Length or chunked
+ * small bodies stay in the receive buffer right after the head and
+ * are handed over as one contiguous view (chunk framing is removed
+ * in place); bodies over the limit are streamed as slices and the
+ * delivered bytes are dropped from the buffer, so an upload never
+ * occupies more than head + one read of memory
+ */
+// 请求体解码器：支持Content-Length与chunked，可跨多次读事件恢复
+// 不超过limit的请求体保留在接收缓冲区中(chunked的分块格式原地去除)，完成后以连续视图交付
+// 超过limit时切换为流式：每段数据通过SliceCallback交付后即从缓冲区中丢弃
+// 偏移都相对于接收缓冲区的可读起点，请求体之前的请求头不会被移动
+class HttpBody
+{
+public:
+	enum Result { kBodyError = -1, kBodyNeedMore = 0, kBodyDone = 1 };
+
+	typedef std::function<void (std::string_view)> SliceCallback;
+
+	/* chunk-size行与trailer行的最大长度 */
+	static const size_t kMaxChunkLine = 1024;
+
+	explicit HttpBody(size_t limit);
+
+	void setSliceCallback(const SliceCallback &cb) { sliceCallback_ = cb; }
+
+	/* 根据Header确定请求体的长度，请求体从begin开始，格式错误返回false */
+	bool start(const HttpHeaders &headers, size_t begin);
+	/* 解码缓冲区中新到达的数据 */
+	Result decode(Buffer &buf);
+	void reset();
+
+	/* 是否带有请求体 */
+	bool hasBody() const { return mode_ != kNoBody; }
+	/* 请求体是否以流式交付 */
+	bool streaming() const { return streaming_; }
+	/* 已解码的字节数 */
+	size_t length() const { return total_; }
+	/* 请求体在缓冲区中的结束位置，即下一个请求的开始 */
+	size_t end() const { return pos_; }
+	/* 非流式时的完整请求体 */
+	std::string_view view(const Buffer &buf) const;
+
+private:
+	enum Mode { kNoBody, kLength, kChunked };
+	enum ChunkState { kChunkSize, kChunkData, kChunkDataEnd, kChunkTrailer };
+
+	Result decodeChunked(Buffer &buf);
+	/* 将解码后的n字节数据保存或交付 */
+	void deliver(Buffer &buf, size_t n);
+	/* 去掉已处理的分块格式与已交付的数据 */
+	void compact(Buffer &buf);
+
+private:
+	const size_t limit_;
+	Mode mode_;
+	ChunkState chunkState_;
+	bool streaming_;
+	size_t begin_;		/* 请求体的起始偏移 */
+	size_t held_;		/* [begin_, begin_+held_)为尚未交付的已解码数据 */
+	size_t pos_;		/* 下一个待解码的字节 */
+	size_t remaining_;	/* 当前chunk或Content-Length剩余的字节数 */
+	size_t total_;
+	SliceCallback sliceCallback_;
+};
+
+} //namespace webserver
+
+#endif
@@ -1,10 +1,12 @@
 #include "HttpConnection.h"
 
 #include <cassert>
+#include <cerrno>
 #include <string>
 
 #include "Channel.h"
 #include "EventLoop.h"
+#include "macros.h"
 #include "utils.h"
 
 namespace webserver
@@ -14,6 +16,9 @@ HttpConnection::HttpConnection(EventLoop *loop, int connfd)
 	: loop_(loop),
 	  connfd_(connfd),
 	  channel_(new Channel(connfd, loop_)),
+	  recvBytes_(0),
+	  recvEof_(false),
+	  sendInFlight_(false),
 	  state_(kConnected)
 {
 	assert(connfd > 0);
@@ -30,6 +35,24 @@ void HttpConnection::setDefaultCallback()
 	channel_->setWriteCallback(std::bind(&HttpConnection::handleWrite, this));
 	channel_->setCloseCallback(std::bind(&HttpConnection::handleClose, this));
 	channel_->setErrorCallback(std::bind(&HttpConnection::handleError, this));
+	
+	/* io_uring代为recv，可读事件到来时数据已在inBuffer_中 */
+	if(loop_->completionIo())
+	{
+		channel_->setRecvCallback(std::bind(&HttpConnection::onRecv, this,
+		                                    std::placeholders::_1, std::placeholders::_2));
+	}
+}
+
+void HttpConnection::onRecv(const char *data, size_t len)
+{
+	if(len == 0)
+	{
+		recvEof_ = true;
+		return ;
+	}
+	inBuffer_.append(data, len);
+	recvBytes_ += len;
 }
 
 /* client发送数据 */
@@ -43,7 +66,18 @@ void HttpConnection::handleRead(void)
 	assert(loop_->isInLoopThread());
 	
 	bool isZero = false;
-	int bytes = utils::readn(connfd_, __in_buffer, isZero);
+	ssize_t bytes;
+	if(loop_->completionIo())
+	{
+		bytes = static_cast<ssize_t>(recvBytes_);
+		isZero = recvEof_;
+		recvBytes_ = 0;
+		recvEof_ = false;
+	}
+	else
+	{
+		bytes = utils::readn(connfd_, inBuffer_, isZero);
+	}
 	if(bytes < 0)
 	{
 		state_ = kError;
@@ -75,26 +109,25 @@ void HttpConnection::handleRead(void)
 void HttpConnection::handleWrite(void)
 {
 	assert(loop_->isInLoopThread());
-	int bytes = utils::writen(connfd_, __out_buffer);
-	if(__out_buffer.size() == 0) 
+	
+	/* 异步发送完成 */
+	ssize_t result;
+	if(channel_->takeSendResult(&result))
 	{
-		/* 关闭写监控 */
-		channel_->disableWriting();
-		/* 对端已关闭写半部 */
-		/* 此时，发送完应答，就可以关闭连接 */
-		if(state_ == kDisConnecting)
+		sendInFlight_ = false;
+		outQueue_.unfreeze();
+		if(result < 0)
 		{
-			state_ = kDisconnected;		
+			/* 对端可能关闭连接 */
+			outQueue_.clear();
+			state_ = kDisconnected;
 			handleClose();
 			return ;
 		}
+		outQueue_.retrieve(static_cast<size_t>(result));
 	}
 	
-	if(bytes < 0)	/* 对端可能关闭连接 */
-	{
-		state_ = kDisconnected;
-		handleClose();
-	}
+	flush();
 }
 
 void HttpConnection::handleClose(void)
@@ -125,16 +158,8 @@ void HttpConnection::handleError(void)
 
 void HttpConnection::send(const void *data, int len)
 {
-	assert(loop_->isInLoopThread());
-	const char *ptr = static_cast<const char *>(data);
-	
-	/* inefficient */
-	int size = static_cast<int>(__out_buffer.size());
-	__out_buffer.resize(size+len);
-	std::copy(ptr, ptr+len, __out_buffer.begin()+size);
-	
-	/* 使能写监控 */
-	channel_->enableWriting();
+	append(data, len);
+	flush();
 }
 
 void HttpConnection::send(const std::string &data)
@@ -143,6 +168,124 @@ void HttpConnection::send(const std::string &data)
 	           static_cast<int>(data.size()));
 }
 
+void HttpConnection::send(std::string &&data)
+{
+	append(std::move(data));
+	flush();
+}
+
+/* 先直接写，内核缓冲区满(EAGAIN)时才使能写监控 */
+/* 省去每次应答都要epoll_ctl，再等一轮事件循环才发送 */
+void HttpConnection::flush()
+{
+	assert(loop_->isInLoopThread());
+	
+	if(loop_->completionIo())
+	{
+		flushAsync();
+		return ;
+	}
+	
+	ssize_t bytes = utils::writen(connfd_, outQueue_);
+	if(bytes < 0)	/* 对端可能关闭连接 */
+	{
+		state_ = kDisconnected;
+		handleClose();
+		return ;
+	}
+	
+	if(!outQueue_.empty())
+	{
+		/* 未发送完，等待可写事件 */
+		if(!channel_->isEnableWriting())
+		{
+			channel_->enableWriting();
+		}
+		return ;
+	}
+	
+	flushDone();
+}
+
+void HttpConnection::flushDone()
+{
+	/* 关闭写监控 */
+	if(channel_->isEnableWriting())
+	{
+		channel_->disableWriting();
+	}
+	
+	/* 对端已关闭写半部 */
+	/* 此时，发送完应答，就可以关闭连接 */
+	if(state_ == kDisConnecting)
+	{
+		state_ = kDisconnected;
+		handleClose();
+	}
+}
+
+/* 内存段作为一个sendmsg请求排入io_uring，与等待事件在同一次io_uring_enter中提交 */
+/* 一次只有一个请求在途，期间追加的应答在完成后一起发送 */
+/* 文件段仍同步sendfile，io_uring没有对应的零拷贝操作 */
+void HttpConnection::flushAsync()
+{
+	if(sendInFlight_) return ;
+	
+	while(!outQueue_.empty() && outQueue_.frontIsFile())
+	{
+		int savedErrno = 0;
+		if(outQueue_.writeFd(connfd_, &savedErrno) >= 0) continue;
+		if(savedErrno == EINTR) continue;
+		if(savedErrno == EAGAIN)
+		{
+			/* 等待可写事件 */
+			if(!channel_->isEnableWriting())
+			{
+				channel_->enableWriting();
+			}
+			return ;
+		}
+		
+		outQueue_.clear();
+		state_ = kDisconnected;
+		handleClose();
+		return ;
+	}
+	
+	if(!outQueue_.empty())
+	{
+		struct iovec vec[OutputQueue::kMaxIovecs];
+		bool more = false;
+		int iovcnt = outQueue_.fillIovecs(vec, &more);
+		
+		/* 请求持有HttpHandler，发送完成前数据不会释放 */
+		if(likely(loop_->submitSend(channel_, vec, iovcnt, more ? MSG_MORE : 0, holder_.lock())))
+		{
+			outQueue_.freeze(iovcnt);
+			sendInFlight_ = true;
+			return ;
+		}
+		
+		/* 提交队列已满，退回同步发送 */
+		if(utils::writen(connfd_, outQueue_) < 0)
+		{
+			state_ = kDisconnected;
+			handleClose();
+			return ;
+		}
+		if(!outQueue_.empty())
+		{
+			if(!channel_->isEnableWriting())
+			{
+				channel_->enableWriting();
+			}
+			return ;
+		}
+	}
+	
+	flushDone();
+}
+
 void HttpConnection::shutdown(int how)
 {
 	utils::Shutdown(connfd_, how);
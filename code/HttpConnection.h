@@ -4,6 +4,9 @@
 #include <memory>
 #include <string>
 
+#include "Buffer.h"
+#include "OutputQueue.h"
+
 /* 负责与Channel通信，根据事件触发，自动读写Http数据到缓冲区 */
 namespace webserver
 {
@@ -29,9 +32,24 @@ public:
 	void handleClose(void);
 	void handleError(void);
 	
-	// 发送数据到连接的成员函数.
+	// 将数据排入输出队列，不立即发送
+	void append(const void *data, int len)
+	{ outQueue_.append(static_cast<const char *>(data), len); }
+	void append(std::string &&data)
+	{ outQueue_.append(std::move(data)); }
+	void append(const OutputQueue::SP_ConstString &data)
+	{ outQueue_.append(data, 0, data->size()); }
+	void appendFile(const OutputQueue::SP_File &file, off_t offset, size_t len)
+	{ outQueue_.appendFile(file, offset, len); }
+	
+	// 发送数据到连接的成员函数：排入队列后立即尝试发送
 	void send(const void *data, int len);
 	void send(const std::string &data);
+	void send(std::string &&data);
+	
+	/* 立即writev输出队列，仅在EAGAIN时使能写监控 */
+	/* 完成式I/O时提交异步发送，完成后在handleWrite中继续 */
+	void flush();
 	
 	// 获取 当前Channel
 	SP_Channel &getChannel() { return channel_; }
@@ -40,14 +58,8 @@ public:
 	void setDefaultCallback();
 	
 	/* HttpHandler独占HttpConnection，线程安全 */
-	std::string getRecvBuffer() 
-	{ 
-		std::string buf;
-		/* 上层读取完数据，__in_buffer置空 */
-		std::swap(buf, __in_buffer);
-		
-		return buf;
-	}
+	/* 上层解析完数据后自行retrieve，不再整体交换 */
+	Buffer &getRecvBuffer() { return inBuffer_; }
 	
 	void setHolder(std::shared_ptr<HttpHandler> handler)
 	{ holder_ = handler; }
@@ -55,14 +67,32 @@ public:
 	/* 供HttpHandler使用 */
 	ConnState getState() const { return state_; }
 	void setState(ConnState state) { state_ = state; }
+	/* 两次请求之间：没有未处理的输入、没有未发送的输出，可以迁移到其他事件循环 */
+	bool idle() const
+	{
+		return state_ == kHandle && inBuffer_.readableBytes() == 0 && outQueue_.empty()
+		       && !sendInFlight_;
+	}
 	void shutdown(int how);
 	
+private:
+	/* 完成式I/O：Poller收到的数据直接追加到inBuffer_ */
+	void onRecv(const char *data, size_t len);
+	/* 输出队列发送完毕后，关闭写监控或关闭连接 */
+	void flushDone();
+	void flushAsync();
+	
 private:
 	EventLoop *loop_;
 	int connfd_;
 	SP_Channel channel_;
-	std::string __in_buffer;	/* 缓冲区不宜用string，遇到'\0'就结束了 */
-	std::string __out_buffer;
+	Buffer inBuffer_;
+	OutputQueue outQueue_;
+	
+	/* 完成式I/O的状态 */
+	size_t recvBytes_;		/* 上次handleRead后收到的字节数 */
+	bool recvEof_;
+	bool sendInFlight_;
 	
 	std::weak_ptr<HttpHandler> holder_;	/* 延长HttpHandler的生命周期 */
 	ConnState state_;
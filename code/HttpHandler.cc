@@ -3,14 +3,14 @@
 #include <string>
 #include <sys/socket.h>
 #include <cassert>
-#include <sys/mman.h>
 #include <unistd.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
+#include <charconv>
+#include <algorithm>
 	   
 #include "Channel.h"
 #include "HttpConnection.h"
+#include "FileCache.h"
+#include "ContentCache.h"
 #include "EventLoop.h"
 #include "macros.h"
 #include "config.h"
@@ -21,14 +21,29 @@ namespace webserver
 const char *HttpHandler::kMethod[] = {"GET", "POST", "HEAD", "Unknown"};
 const char *HttpHandler::kVersion[] = {"HTTP/1.0", "HTTP/1.1", "Unknown"};
 
-HttpHandler::HttpHandler(EventLoop *loop, int connfd)
+/* 32位FNV-1a */
+static const uint32_t kFnvOffset = 2166136261u;
+static const uint32_t kFnvPrime = 16777619u;
+
+HttpHandler::HttpHandler(EventLoop *loop, int connfd, FileCache *fileCache,
+                         ContentCache *contentCache)
 	: loop_(loop),
 	  connfd_(connfd),
+	  fileCache_(fileCache),
+	  contentCache_(contentCache),
 	  connection_(new HttpConnection(loop_, connfd_)),	// 创建HttpConnection实例 负责与 Channel 通信，根据事件触发自动读写 HTTP 数据到缓冲区。
 	  state_(kStart),
+	  parsePos_(0),
+	  header_(&connection_->getRecvBuffer()),
+	  pathOff_(0),
+	  pathLen_(0),
+	  body_(MAX_HTTPBODYINLINE),
+	  bodyBytes_(0),
+	  bodyDigest_(kFnvOffset),
 	  keepAlive_(false)
 {
 	assert(connfd_ > 0);
+	body_.setSliceCallback(std::bind(&HttpHandler::onBodySlice, this, std::placeholders::_1));
 }
 
 HttpHandler::~HttpHandler()
@@ -39,7 +54,7 @@ HttpHandler::~HttpHandler()
 //在当前event loop中，仅被调用一次 第一次开始建立连接
 void HttpHandler::newConnection()
 {
-#if DEBUG
+#ifdef DEBUG
 	printf("void HttpHandler::newConnection()\n");
 #endif
 
@@ -52,204 +67,297 @@ void HttpHandler::newConnection()
 
 // GET / HTTP/1.1\r\n Host: localhost\r\n
 /* HTTP 1.1: 多个Http请求，不能重叠执行 */
-/* 解析Http协议时，使用正则子表达式，可能会更加清晰 */
+/* 请求可能分多次到达，解析状态保存在state_/parsePos_中，数据不完整时等待下次读事件 */
+/* 一次读到多个请求(pipelining)时，依次应答，全部排队后只发送一次 */
 void HttpHandler::handleHttpReq()
 {
-	/* bpos当前位置，epos下一行位置 */
-	int bpos = 0, epos = 0;
-	/* ROV优化, 不必忧心效率 */
-	std::string buffer = connection_->getRecvBuffer();
-
-#if DEBUG
-	printf("void HttpHandler::handleHttpReq()\n");
-	printf("buffer=%s\n",buffer.c_str());
-#endif
+	Buffer &buffer = connection_->getRecvBuffer();
 
-	HttpConnection::ConnState connState = connection_->getState();
+#ifdef DEBUG
+	printf("void HttpHandler::handleHttpReq() %zu bytes\n", buffer.readableBytes());
+#endif
 
-	if(connState == HttpConnection::kError)
+	if(unlikely(connection_->getState() == HttpConnection::kError))
 	{
-
-printf("connState == HttpConnection::kError");
-		state_ = kStart;	/* 跳过解析环节，回复404 bad request */
-		goto __err;
+		state_ = kStart;	/* 跳过解析环节，回复400 bad request */
+		responseReq();
+		buffer.retrieveAll();
+		scanner_.reset();
+		keepAlive_ = false;
+		keepAliveHandle();
+		connection_->flush();
+		return ;
 	}
-	
-	/* 请求到来，但无数据 */
-	if(buffer.empty()) 
-	{
 
-printf("buffer.empty()");
-		state_ = kStart;
-		goto __err;
-	}
-	
-	// 解析Url
-	epos = praseUrl(buffer, bpos);
-	if(unlikely(epos < 0))
-	{
-printf("(unlikely(epos < 0) state_ = kPraseUrl;");		
-		state_ = kPraseUrl;	//错误处理, 设置状态 bad request
-		goto __err;
-	}
-	
-	// 解析Head
-	bpos = epos;
-	epos = praseHeader(buffer, bpos);
-	if(unlikely(epos < 0))
+	while(true)
 	{
-printf("(unlikely(epos < 0) state_ = kPraseHeader;");		
-		state_ = kPraseHeader;
-		goto __err;
+		PraseResult result = praseRequest(buffer);
+		if(result == kPraseNeedMore)
+		{
+			/* 请求不完整，等待后续数据 */
+			if(connection_->getState() != HttpConnection::kDisConnecting) break;
+			
+			/* 对端已关闭写半部，不会再有数据 */
+			/* 没有未完成的请求时，发送完已排队的应答后关闭连接 */
+			if(buffer.readableBytes() == 0) break;
+		}
+		
+		/* 根据解析状态，返回结果 */
+		responseReq();
+		
+		if(state_ == kPraseDone)
+		{
+			/* 取走已解析的请求，之后的数据属于下一个请求 */
+			buffer.retrieve(parsePos_);
+			scanner_.consume(parsePos_);
+		}
+		else
+		{
+			/* 无法确定下一个请求的边界，应答后关闭连接 */
+			buffer.retrieveAll();
+			scanner_.reset();
+			keepAlive_ = false;
+		}
+		
+		/* 连接处理：断开 or 保持 */
+#if DEBUGKeepAlive
+		keepAlive_=false;
+#endif
+		keepAliveHandle();
+		
+		/* 非keepalive连接，不再处理后续请求 */
+		if(!keepAlive_ || buffer.readableBytes() == 0) break;
 	}
 	
-	// Post请求 解析 Body
-	bpos = epos;
-	epos = praseBody(buffer, bpos);
-	if(unlikely(epos < 0))
+	/* 应答排队完毕，立即发送 */
+	connection_->flush();
+}
+
+/* 逐行推进的状态机，已检查过的字节不会再扫描 */
+/* [peek, peek+parsePos_)已解析，行的位置由HttpScanner一次扫描得到 */
+HttpHandler::PraseResult HttpHandler::praseRequest(Buffer &buf)
+{
+	while(true)
 	{
-printf("(unlikely(epos < 0) state_ = kPraseBody;");		
-		state_ = kPraseBody;
-		goto __err;
-	}
-	state_ = kPraseDone;
+		switch(state_)
+		{
+		case kStart:
+			keepAlive_ = false;
+			parsePos_ = 0;
+			bodyBytes_ = 0;
+			bodyDigest_ = kFnvOffset;
+			state_ = kPraseUrl;
+			break;
+
+		case kPraseUrl:
+		case kPraseHeader:
+		{
+			/* 只扫描新到达的字节 */
+			scanner_.scan(buf.peek(), buf.readableBytes());
+			if(!scanner_.hasLine())
+			{
+				if(buf.readableBytes() > MAX_HTTPHEADERSIZE)
+					return kPraseMalformed;
+				return kPraseNeedMore;
+			}
+			
+			HttpScanner::Line line = scanner_.front();
+			scanner_.pop();
+			
+			size_t lineBegin = parsePos_;
+			const char *begin = buf.peek() + lineBegin;
+			const char *end = buf.peek() + line.end;
+			if(end > begin && end[-1] == '\r') end--;	/* 兼容只有'\n'的行 */
+			parsePos_ = line.end + 1;
+			
+			if(state_ == kPraseUrl)
+			{
+				if(unlikely(praseUrl(buf.peek(), begin, end) < 0))
+					return kPraseMalformed;
+				state_ = kPraseHeader;
+			}
+			else if(end == begin)
+			{
+				/* 空行，Header结束，之后为请求体 */
+				if(unlikely(praseHeaderDone() < 0))
+					return kPraseMalformed;
+				state_ = kPraseBody;
+			}
+			else
+			{
+				const char *sep = nullptr;
+				if(likely(line.colon != HttpScanner::kNoColon && line.colon >= lineBegin))
+					sep = buf.peek() + line.colon;
+				else
+					sep = static_cast<const char *>(::memchr(begin, ':', end-begin));
+				
+				if(unlikely(sep == nullptr || sep >= end || 
+				            praseHeader(buf.peek(), begin, sep, end) < 0))
+					return kPraseMalformed;
+			}
+			break;
+		}
 
-#ifdef DEBUG
-	printf("state_ kPraseDone \n");
-#endif // DEBUG
-	
-__err:
-	/* 根据解析状态，返回结果 */
-	responseReq();
-	
-	/* 连接处理：断开 or 保持 */
-#if DEBUGKeepAlive
-	keepAlive_=false;
-#endif
-	keepAliveHandle();
+		case kPraseBody:
+		{
+			int ret = praseBody(buf);
+			if(ret < 0) return kPraseMalformed;
+			if(ret == 0) return kPraseNeedMore;
+			state_ = kPraseDone;
+			break;
+		}
+
+		case kPraseDone:
+			return kPraseComplete;
+
+		default:
+			return kPraseMalformed;
+		}
+	}
 }
 
-/* 解析请求行，发生错误时返回-1，否则返回Header的索引位置 */
-int HttpHandler::praseUrl(std::string &buf, int bpos)
+/* 解析请求行[begin, end)，发生错误时返回-1 */
+/* 方法与版本直接解析为枚举，路径只记录相对base的偏移，不拷贝 */
+int HttpHandler::praseUrl(const char *base, const char *begin, const char *end)
 {
-	/* 提取请求行 */
-	std::string::size_type epos = buf.find("\r\n", bpos);
-	if(epos == std::string::npos) return -1;
-	
 	/* 解析请求方法 */
-	std::string::size_type space = buf.find(" ", bpos);
-	if(space == std::string::npos || space > epos) return -1;
-	setMethod(buf.substr(bpos, space-bpos));
-	if(kMethod[method_] == std::string("Unknown")) return -1;
+	const char *space = static_cast<const char *>(::memchr(begin, ' ', end-begin));
+	if(space == nullptr) return -1;
+	if(setMethod(std::string_view(begin, space-begin)) < 0) return -1;
 	
 	/* 解析请求资源路径 */
-	bpos = space+1;
-	space = buf.find(" ", bpos);
-	if(space == std::string::npos || space > epos) return -1;
-	setPath(buf.substr(bpos, space-bpos));
-	if(path_.empty() || path_[0] != '/') return -1;
+	begin = space+1;
+	space = static_cast<const char *>(::memchr(begin, ' ', end-begin));
+	if(space == nullptr) return -1;
+	if(space == begin || *begin != '/') return -1;
+	setPath(begin-base, space-begin);
 	
 	/* 解析Http版本号 */
-	bpos = space+1;
-	setVersion(buf.substr(bpos, epos-bpos));
-	if(kVersion[version_] == std::string("Unknown")) return -1;
+	begin = space+1;
+	if(setVersion(std::string_view(begin, end-begin)) < 0) return -1;
 	if(version_ == kHttpV11) keepAlive_=true;
 
-#if DEBUG
+#ifdef DEBUG
 	printf("method:%s ", kMethod[method_]);
-	printf("path:%s ", path_.c_str());
+	printf("path:%.*s ", static_cast<int>(pathLen_), base+pathOff_);
 	printf("version:%s \n", kVersion[version_]);
 #endif
 	
-	return epos+2;
+	return 0;
 }
 
-/* 解析Header，发生错误时返回-1，否则返回Body的索引位置 */
-int HttpHandler::praseHeader(std::string &buf, int bpos)
+std::string_view HttpHandler::requestPath() const
 {
-	std::string::size_type epos = bpos;
+	return std::string_view(connection_->getRecvBuffer().peek() + pathOff_, pathLen_);
+}
+
+/* 解析一行Header[begin, end)，sep为本行第一个':'，发生错误时返回-1 */
+/* 只记录key/value相对base的偏移，不拷贝 */
+int HttpHandler::praseHeader(const char *base, const char *begin, 
+                             const char *sep, const char *end)
+{
+	while(begin < sep && *begin == ' ') begin++;
+	const char *value = sep+1;
+	while(value < end && *value == ' ') value++;
+	const char *vend = end;
+	while(vend > value && vend[-1] == ' ') vend--;
 	
-	while(static_cast<int>(epos = buf.find("\r\n", bpos)) != bpos)
-	{
-		std::string::size_type sep = buf.find(":", bpos);
-		if(sep == std::string::npos || sep > epos) return -1;
-		
-		while(buf[bpos] == ' ') bpos++;
-		std::string key(buf.substr(bpos,sep-bpos));
-		
-		sep += 1;
-		while(buf[sep] == ' ') sep++;
-		std::string value(buf.substr(sep, epos-sep));
-		
-		setHeader(key, value);
-		
-		bpos = epos+2;
-	}
+	header_.add(begin-base, sep-begin, value-base, vend-value);
 	
-	/* Keepalive判断 */
-	if(header_.count("Connection"))
+	return 0;
+}
+
+/* Header全部到达后的处理，请求体长度无法确定时返回-1 */
+int HttpHandler::praseHeaderDone()
+{
+	/* Keepalive判断，忽略大小写 */
+	std::string_view connection;
+	if(header_.find("Connection", connection))
 	{
-		if(header_["Connection"] == "keep-alive" || 
-	       header_["Connection"] == "Keep-Alive") 
+		if(HttpHeaders::hasToken(connection, "keep-alive"))
 		{
 			keepAlive_ = true;
 		}
-		else if(header_["Connection"] == "close" ||
-		        header_["Connection"] == "Close")
+		else if(HttpHeaders::hasToken(connection, "close"))
 		{
 			keepAlive_ = false;
 		}
 	}
 
-#if DEBUG
-	for(auto &p : header_)
+#ifdef DEBUG
+	for(size_t i=0; i<header_.size(); ++i)
 	{
-		printf("%s: %s\n", p.first.c_str(), p.second.c_str());
+		printf("%.*s: %.*s\n", 
+		       static_cast<int>(header_.key(i).size()), header_.key(i).data(),
+		       static_cast<int>(header_.value(i).size()), header_.value(i).data());
 	}
 #endif
 
-	return epos+2;
+	/* 请求体从parsePos_开始，之后的字节不再作为请求头扫描 */
+	if(!body_.start(header_, parsePos_)) return -1;
+	scanner_.rewind(parsePos_);
+	
+	/* 客户端等待100 Continue后才发送请求体 */
+	std::string_view expect;
+	if(body_.hasBody() && version_ == kHttpV11 &&
+	   connection_->getRecvBuffer().readableBytes() == parsePos_ &&
+	   header_.find("Expect", expect) && HttpHeaders::equalsIgnoreCase(expect, "100-continue"))
+	{
+		static const char kContinue[] = "HTTP/1.1 100 Continue\r\n\r\n";
+		connection_->append(kContinue, sizeof(kContinue) - 1);
+	}
+	
+	return 0;
 }
 
-/* 解析Body，发生错误时返回-1，否则返回0 */
-// 非Post 不解析Body
-int HttpHandler::praseBody(std::string &buf, int bpos)
+/* 解析Body，发生错误时返回-1，数据不完整返回0，完成返回1 */
+/* Content-Length与chunked均增量解码，请求体之后的数据属于下一个请求 */
+int HttpHandler::praseBody(Buffer &buf)
 {
-
-#if DEBUG
-	printf("int HttpHandler::praseBody(%s, %d) \n", body_.c_str(),bpos);
-#endif
-
-	/* 非Post，不解析body */
-	if(method_ != kPost) return 0;
+	HttpBody::Result ret = body_.decode(buf);
+	if(ret != HttpBody::kBodyDone) return ret;
 	
-	/* Body长度 */
-	if(!header_.count("Content-length")){
+	parsePos_ = body_.end();
+	scanner_.rewind(parsePos_);
 
-#if DEBUG
-	printf("header_.count(\"Content-length\") \n");
-#endif				
-		//return -1;
+#ifdef DEBUG
+	if(body_.hasBody() && !body_.streaming())
+	{
+		std::string_view body = body_.view(buf);
+		printf("body: %.*s\n", static_cast<int>(body.size()), body.data());
 	}
-	
-// 	int bodyLen = stoi(header_["Content-length"]);
-// 	if(bodyLen < static_cast<int>(buf.size())-bpos){
+#endif
 
-// #if DEBUG
-// 	printf("bodyLen < static_cast<int>(buf.size())-bpos \n");
-// #endif	
-// 		//return -1;
-// 	}
-	
-	/* inefficient!! */
-	//body_ = buf.substr(bpos);
-	body_="Post:请求已经处理";
-	
-#if DEBUG
-	printf("body: %s\n", body_.c_str());
+	return 1;
+}
+
+/* 超过MAX_HTTPBODYINLINE的请求体，每段数据到达后交付，交付后即被丢弃 */
+void HttpHandler::onBodySlice(std::string_view slice)
+{
+#ifdef DEBUG
+	printf("void HttpHandler::onBodySlice(%zu bytes)\n", slice.size());
 #endif
+	consumeBody(slice);
+}
 
-	return 0;
+/* 累计长度与FNV-1a摘要，应答中报告给客户端 */
+void HttpHandler::consumeBody(std::string_view data)
+{
+	uint32_t digest = bodyDigest_;
+	for(unsigned char c : data)
+	{
+		digest = (digest ^ c) * kFnvPrime;
+	}
+	bodyDigest_ = digest;
+	bodyBytes_ += data.size();
+}
+
+/* Date由事件循环每秒格式化一次 */
+void HttpHandler::appendDate(std::string &header)
+{
+	header += "Date: ";
+	header += loop_->httpDate();
+	header += "\r\n";
 }
 
 /* 应答异常请求 */
@@ -275,23 +383,25 @@ void HttpHandler::badRequest(int num, const std::string &note)
 	body += "</body></html>";
 	
 	header += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+	appendDate(header);
 	header += "Server: Alfred WebServer\r\n\r\n";
 	
-	connection_->send(header);
-	connection_->send(body);
+	/* header与body分段排队，由flush一次writev发出 */
+	connection_->append(std::move(header));
+	connection_->append(std::move(body));
 }
 
-/* 应答正常请求 */
-void HttpHandler::onRequest(const std::string &body)
-{	
-#ifdef DEBUG
-	printf("void HttpHandler::onRequest(%s) \n",body.c_str());
-#endif // DEBUG
-
+/* 正常请求的应答头 */
+void HttpHandler::appendOkHeader(size_t bodyLen, const char *contentType,
+                                 const std::string &etag)
+{
 	std::string header;
 	
 	header += "HTTP/1.1 200 OK\r\n";
-	header += "Content-Type: text/html\r\n";
+	header += "Content-Type: ";
+	header += contentType;
+	header += "\r\n";
+	if(!etag.empty()) header += "ETag: " + etag + "\r\n";
 	
 	if(! keepAlive_) header += "Connection: close\r\n";
 	else             header += "Connection: Keep-Alive\r\n";
@@ -300,18 +410,87 @@ void HttpHandler::onRequest(const std::string &body)
 	if(method_ != kHead)
 	{
 		header += "Content-Length: " + 
-	              std::to_string(body.size()) + "\r\n";
+	              std::to_string(bodyLen) + "\r\n";
 	}
+	appendDate(header);
 	header += "Server: Alfred WebServer\r\n\r\n";
 	
-	connection_->send(header);
+	connection_->append(std::move(header));
+}
+
+/* 应答正常请求 */
+void HttpHandler::onRequest(std::string &&body)
+{	
+#ifdef DEBUG
+	printf("void HttpHandler::onRequest(%s) \n",body.c_str());
+#endif // DEBUG
+
+	appendOkHeader(body.size());
+	if(method_ != kHead) 
+	{
+		connection_->append(std::move(body));
+	}
+}
+
+/* 流式的请求体已在到达时逐段交付，其余的在此以连续视图交付 */
+/* 视图指向接收缓冲区，应答生成前该请求的数据不会被取走 */
+void HttpHandler::onPost()
+{
+	if(body_.hasBody() && !body_.streaming())
+	{
+		consumeBody(body_.view(connection_->getRecvBuffer()));
+	}
+	
+	char result[64];
+	snprintf(result, sizeof(result), " %zu bytes fnv1a %08x", 
+	         bodyBytes_, static_cast<unsigned>(bodyDigest_));
+	std::string context("Post:请求已经处理");
+	context += result;
+	
+	onRequest(std::move(context));
+}
+
+/* 应答缓存中的内容，共享只读数据直接排入输出队列，不拷贝 */
+void HttpHandler::onRequest(const OutputQueue::SP_ConstString &body,
+                            const char *contentType, const std::string &etag)
+{
+	appendOkHeader(body->size(), contentType, etag);
 	if(method_ != kHead) 
 	{
-		connection_->send(body);
+		connection_->append(body);
 	}
+}
+
+/* 应答静态文件，文件内容由sendfile发送，不读入内存 */
+void HttpHandler::onRequest(const OutputQueue::SP_File &file, size_t len,
+                            const char *contentType, const std::string &etag)
+{
 #ifdef DEBUG
-	printf("head=%s\n",header.c_str());
+	printf("void HttpHandler::onRequest(fd=%d, %zu) \n", file->fd(), len);
 #endif // DEBUG
+
+	appendOkHeader(len, contentType, etag);
+	if(method_ != kHead) 
+	{
+		connection_->appendFile(file, 0, len);
+	}
+}
+
+/* 304 Not Modified，没有body */
+void HttpHandler::notModified(const std::string &etag)
+{
+	std::string header;
+	
+	header += "HTTP/1.1 304 Not Modified\r\n";
+	header += "ETag: " + etag + "\r\n";
+	
+	if(! keepAlive_) header += "Connection: close\r\n";
+	else             header += "Connection: Keep-Alive\r\n";
+	
+	appendDate(header);
+	header += "Server: Alfred WebServer\r\n\r\n";
+	
+	connection_->append(std::move(header));
 }
 
 // 准备请求的文件
@@ -322,8 +501,7 @@ void HttpHandler::responseReq()
 	printf("void HttpHandler::responseReq() \n");
 #endif // DEBUG
 
-	std::string filename("../../source/");
-	std::string context;
+	std::string path;
 	
 	/* 根据解析状态，响应Http请求 */
 	// 错误的请求
@@ -335,82 +513,74 @@ void HttpHandler::responseReq()
 	}
 	
 	/* 解析请求资源 */
+	/* 规范化后的路径不会越出根目录 */
+	if(!FileCache::normalizePath(requestPath(), path))
+	{
+		badRequest(404, "Not Found");
+		return ;
+	}
+	
 	// 正常的请求 解析出来请求的文件路径
-	if(path_ == "/")
+	if(path.empty())
 	{
 		//默认返回index.html页面
-		filename += "index.html";
+		path = "index.html";
 	}
-	else 
+	
+	/* POST的目标须是hello或已存在的文件，请求体交给onPost处理 */
+	if(method_ == kPost)
 	{
-		/* 不能原地赋值!! */
-		std::string path = path_.substr(1);
-		
-		//for webbench test!
-		if(path == "hello")
-		{
-			std::string hello("Hello, Alfred WebServer.");
-			onRequest(hello);
-			return ;
-		}
-		else if(::access((filename+path).c_str(), F_OK) < 0)
+		if(path != "hello" && fileCache_->get(path) == nullptr)
 		{
-			//404 Not Found
 			badRequest(404, "Not Found");
 			return ;
 		}
-		filename += path;
+		onPost();
+		return ;
 	}
-
-	if(method_== kPost){
-		context=body_;
-		
-		onRequest(context);
+	
+	if(path == "hello")
+	{
+		//for webbench test!
+		std::string hello("Hello, Alfred WebServer.");
+		onRequest(std::move(hello));
 		return ;
 	}
 
 #ifdef DEBUG
-	printf("filename=%s \n",filename.c_str());
+	printf("path=%s \n",path.c_str());
 #endif // DEBUG
-	/* 返回页面 */
-	// 查找文件
-	struct stat st;
-	if(unlikely(::stat(filename.c_str(), &st)<0))
+
+	/* 查找文件，命中缓存时没有任何系统调用 */
+	FileCache::SP_Entry entry = fileCache_->get(path);
+	if(entry == nullptr)
 	{
-		perror("stat");
 		//404 Not Found
 		badRequest(404, "Not Found");
 		return ;
 	}
-	
-	// 读取文件的fd
-	int fd = ::open(filename.c_str(), O_RDONLY);
-	if(unlikely(fd < 0))
+
+	/* 客户端缓存仍然有效 */
+	std::string_view etag;
+	if(header_.find("If-None-Match", etag) && etag == entry->etag)
 	{
-		perror("open");
-		//404 Not Found
-		badRequest(404, "Not Found");
+		notModified(entry->etag);
 		return ;
 	}
 	
-	void *mapFile = ::mmap(NULL, st.st_size, PROT_READ, 
-	                       MAP_PRIVATE, fd, 0);
-	if(mapFile == MAP_FAILED)
+	/* 小文件优先使用内容缓存 */
+	if(contentCache_ != nullptr && method_ != kHead)
 	{
-		perror("mmap");
-		//404 Not Found
-		badRequest(404, "Not Found");
-		return ;
+		OutputQueue::SP_ConstString body = contentCache_->get(path, entry);
+		if(body != nullptr)
+		{
+			onRequest(body, entry->contentType, entry->etag);
+			return ;
+		}
 	}
 	
-	char *pf = static_cast<char *>(mapFile);
-	context = std::string(pf, pf + st.st_size);
-
-	// 响应请求
-	onRequest(context);
-	
-	::close(fd);
-	::munmap(mapFile, st.st_size);
+	// 响应请求，文件描述符由缓存持有，sendfile不改变文件偏移，可被多个连接共享
+	onRequest(entry->file, entry->size, entry->contentType, entry->etag);
 }
 
 // KeepAlive
@@ -428,18 +598,19 @@ void HttpHandler::keepAliveHandle(void)
 		return ;
 	}
 	
-	/* keepalive预关闭 */
+	/* 清理工作，为下次接受请求做准备 */
+	header_.clear();
+	body_.reset();
+	pathLen_ = 0;
+	state_ = kStart;
+	parsePos_ = 0;
+	
+	/* keepalive预关闭，仍需应答缓冲区中剩余的请求 */
 	HttpConnection::ConnState connState = connection_->getState();
 	if(connState == HttpConnection::kDisConnecting) return ;
 	
 	/* 刷新keepalive时间 */
-	loop_->flushKeepAlive(connection_->getChannel(), timerNode_);
-	
-	/* 清理工作，为下次接受请求做准备 */
-	header_.clear();
-	body_.clear();
-	path_.clear();
-	state_ = kStart;
+	loop_->flushKeepAlive(this);
 	
 	/* 重置Httpconnection状态 */
 	connection_->setState(HttpConnection::kHandle);
@@ -1,28 +1,38 @@
 #ifndef code_HttpHandler_h
 #define code_HttpHandler_h
 
+#include <cstdint>
 #include <memory>
-#include <map>
 #include <string>
+#include <string_view>
 #include <stdexcept> // If you decide to throw an exception
 #include <iostream>
 #include <string.h>
 
 #include "HttpManager.h"
+#include "OutputQueue.h"
+#include "HttpHeaders.h"
+#include "HttpScanner.h"
+#include "HttpBody.h"
 
 namespace webserver
 {
 
 class EventLoop;
+class Buffer;
 class HttpConnection;
 class HttpManager;
+class FileCache;
+class ContentCache;
 
 /* 持有HttpConnection */
 /* 负责解析Http协议，并给予Http应答 */
 // HttpHandler 类继承自 std::enable_shared_from_this，用于支持在成员函数中安全地获取 shared_ptr 实例。
 // HttpHandler 负责管理与客户端的连接，并在事件循环中处理来自客户端的HTTP请求。
 // 通过将连接的管理和请求处理分离，可以更好地实现服务器的可扩展性和并发处理能力。
-class HttpHandler : public std::enable_shared_from_this<HttpHandler>
+/* 自身作为HttpManager中KeepAlive时间轮的节点 */
+class HttpHandler : public std::enable_shared_from_this<HttpHandler>,
+                    public TimingWheelNode
 {
 public:
 	// 这些枚举类型定义了 HTTP 协议的版本、请求方法和处理状态。。
@@ -33,13 +43,16 @@ public:
 
 	// 表示处理的起始状态等。
 	enum HttpState { kStart, kPraseUrl, kPraseHeader, kPraseBody, kPraseDone, kResponse, kStateSize };
+	// 解析结果：数据不完整与请求格式错误分开报告。
+	enum PraseResult { kPraseNeedMore, kPraseMalformed, kPraseComplete };
 	
 	// 这些数组定义了 HTTP 方法和版本的字符串表示。
 	// 例如，kMethod 包含了 "GET"、"POST"、"HEAD" 和 "Unknown" 等字符串。
 	static const char *kMethod[];
 	static const char *kVersion[];
 	
-	HttpHandler(EventLoop *loop, int connfd);
+	HttpHandler(EventLoop *loop, int connfd, FileCache *fileCache, 
+	            ContentCache *contentCache);
 	~HttpHandler();
 
 	// 被主事件循环调用，处理新的连接。
@@ -48,10 +61,18 @@ public:
 	void handleHttpReq();
 
 private:
+	// 增量解析接收缓冲区中的请求，可跨多次读事件恢复。
+	PraseResult praseRequest(Buffer &buf);
 	// 用于解析 HTTP 请求的 URL、头部和请求体。
-	int praseUrl(std::string &buf, int bpos);
-	int praseHeader(std::string &buf, int bpos);
-	int praseBody(std::string &buf, int bpos);
+	int praseUrl(const char *base, const char *begin, const char *end);
+	int praseHeader(const char *base, const char *begin, 
+	                const char *sep, const char *end);
+	int praseHeaderDone();
+	int praseBody(Buffer &buf);
+	// 流式交付的请求体片段。
+	void onBodySlice(std::string_view slice);
+	// 请求体的消费者：较小的请求体以连续视图一次交付，较大的逐段交付。
+	void consumeBody(std::string_view data);
 
 	// 处理 HTTP 请求并返回响应。
 	void responseReq();
@@ -60,77 +81,91 @@ private:
 	// 处理错误请求。
 	void badRequest(int num, const std::string &note);
 	// 处理完整的 HTTP 请求。
-	void onRequest(const std::string &body);
+	void onRequest(std::string &&body);
+	// 应答POST请求，报告收到的请求体。
+	void onPost();
+	void onRequest(const OutputQueue::SP_ConstString &body,
+	               const char *contentType, const std::string &etag);
+	void onRequest(const OutputQueue::SP_File &file, size_t len,
+	               const char *contentType, const std::string &etag);
+	// 正常应答的响应头。
+	void appendOkHeader(size_t bodyLen, const char *contentType = "text/html",
+	                    const std::string &etag = std::string());
+	// 客户端缓存仍然有效。
+	void notModified(const std::string &etag);
+	// 各应答共用的Date头。
+	void appendDate(std::string &header);
 	
-	// 设置 HTTP 请求的方法、路径、版本和头部。
-	void setMethod(const std::string &method)
+	// 设置 HTTP 请求的方法、路径、版本，未知的方法与版本返回-1。
+	int setMethod(std::string_view method)
 	{
-
-#if DEBUG
-	printf("void setMethod(%s)\n", method.c_str());
+#ifdef DEBUG
+	printf("void setMethod(%.*s)\n", static_cast<int>(method.size()), method.data());
 #endif
-		method_ = kOtherMethods;
-		for(int i=0; i<kMethodSize-1; ++i)
+		for(int i=0; i<kOtherMethods; ++i)
 		{
-			// enum HttpMethod { kGet, kPost, kHead, kOtherMethods, kMethodSize };
-			// const char *HttpHandler::kMethod[] = {"GET", "POST", "HEAD", "Unknown"};
-			//if(method.c_str()== kMethod[i])
-			// if (static_cast<const char*>(method_) == kMethod[i])
-			if(strcmp(method.c_str(),kMethod[i])==0)
+			if(method == kMethod[i])
 			{
 				method_ = static_cast<HttpMethod>(i);
-				return ;
+				return 0;
 			}
 		}
-		method_=static_cast<HttpMethod>(0);
+		return -1;
 	}
 	
-	void setPath(const std::string &path) { path_ = path; }
-	void setVersion(const std::string &version)
+	/* 与Header相同，只记录路径在接收缓冲区中的位置 */
+	void setPath(size_t off, size_t len) { pathOff_ = off; pathLen_ = len; }
+	std::string_view requestPath() const;
+	
+	int setVersion(std::string_view version)
 	{
-		version_ = kHttpUnkown;
-		for(int i=0; i<kVersionSize-1; ++i)
+		for(int i=0; i<kHttpUnkown; ++i)
 		{
 			if(version == kVersion[i])
 			{
 				version_ = static_cast<HttpVersion>(i);
-				return ;
+				return 0;
 			}
 		}
-	}
-	
-	void setHeader(const std::string &key, const std::string &value) 
-	{ 
-		header_[key] = value; 
+		return -1;
 	}
 	
 private:
 	EventLoop *loop_;
 	// 与客户端建立的连接的文件描述符。
 	int connfd_;
+	// 静态文件缓存，由HttpServer持有。
+	FileCache *fileCache_;
+	// 小文件内容缓存，由HttpServer持有，可能为空。
+	ContentCache *contentCache_;
 	// 持有一个 HttpConnection 对象，用于处理具体的 HTTP 连接。
 	std::unique_ptr<HttpConnection> connection_;
 	
 	// 当前 HTTP 处理的状态，如解析 URL、解析头部、解析请求体等。
 	HttpState state_;
+	// 当前请求已解析的字节数，相对接收缓冲区的可读起点。
+	size_t parsePos_;
+	// 记录接收缓冲区中每行的结束位置与':'位置，已扫描的字节不再扫描。
+	HttpScanner scanner_;
 	// HTTP 请求的方法，如 GET、POST 等。
 	HttpMethod method_;
 	// HTTP 协议的版本。
 	HttpVersion version_;
 	
-	// 保存 HTTP 请求头的键值对。
-	std::map<std::string, std::string> header_;
-	// HTTP 请求的路径。
-	std::string path_;
-	// HTTP 请求体的内容。
-	std::string body_;
+	// 保存 HTTP 请求头的键值对，只记录在接收缓冲区中的位置。
+	// 接收缓冲区在应答生成前不会取走该请求的数据。
+	HttpHeaders header_;
+	// HTTP 请求的路径，相对接收缓冲区可读起点的偏移与长度。
+	size_t pathOff_;
+	size_t pathLen_;
+	// HTTP 请求体的解码状态，较小的请求体以连续视图保留在接收缓冲区中。
+	HttpBody body_;
+	// POST处理收到的请求体字节数与FNV-1a摘要。
+	size_t bodyBytes_;
+	uint32_t bodyDigest_;
 	// 表示是否需要保持连接。
 	bool keepAlive_;
 	
-	/* 变量类型不大理想 */
-	// 用于处理 HTTP 连接的定时器节点。
-	HttpManager::TimerNode timerNode_;
-	
 	friend class HttpManager;
 };
 
@@ -0,0 +1,132 @@
+#ifndef code_HttpHeaders_h
+#define code_HttpHeaders_h
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "Buffer.h"
+
+namespace webserver
+{
+
+/*
+ * flat header table
+ * each field only records offsets into the receive buffer,
+ * relative to its readable start, which stays pinned until
+ * the response of the request is produced
+ */
+// 请求头表：只记录key/value在接收缓冲区中的偏移，不分配字符串
+// 前kInlineFields个字段存放在对象内部，超出时才使用vector
+// 偏移相对于缓冲区的可读起点，缓冲区扩容或挪动数据后依然有效
+class HttpHeaders
+{
+public:
+	static const size_t kInlineFields = 24;
+
+	explicit HttpHeaders(const Buffer *buffer)
+		: buffer_(buffer),
+		  size_(0)
+	{}
+
+	/* 记录一个字段，偏移相对于buffer的peek() */
+	void add(size_t keyOff, size_t keyLen, size_t valueOff, size_t valueLen)
+	{
+		Field field = { static_cast<uint32_t>(keyOff), static_cast<uint32_t>(keyLen),
+		                static_cast<uint32_t>(valueOff), static_cast<uint32_t>(valueLen) };
+		if(size_ < kInlineFields) inline_[size_] = field;
+		else                      overflow_.push_back(field);
+		++size_;
+	}
+
+	void clear()
+	{
+		size_ = 0;
+		overflow_.clear();
+	}
+
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+	std::string_view key(size_t i) const
+	{ const Field &f = field(i); return view(f.keyOff, f.keyLen); }
+
+	std::string_view value(size_t i) const
+	{ const Field &f = field(i); return view(f.valueOff, f.valueLen); }
+
+	/* 忽略大小写查找，不存在时返回false */
+	bool find(std::string_view key, std::string_view &value) const
+	{
+		for(size_t i=0; i<size_; ++i)
+		{
+			if(equalsIgnoreCase(this->key(i), key))
+			{
+				value = this->value(i);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool contains(std::string_view key) const
+	{
+		std::string_view value;
+		return find(key, value);
+	}
+
+	static bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs)
+	{
+		if(lhs.size() != rhs.size()) return false;
+		for(size_t i=0; i<lhs.size(); ++i)
+		{
+			if(toLower(lhs[i]) != toLower(rhs[i])) return false;
+		}
+		return true;
+	}
+
+	/* 逗号分隔的列表中是否含有token，如"Connection: keep-alive, Upgrade" */
+	static bool hasToken(std::string_view list, std::string_view token)
+	{
+		while(!list.empty())
+		{
+			size_t comma = list.find(',');
+			std::string_view item = list.substr(0, comma);
+			while(!item.empty() && (item.front() == ' ' || item.front() == '\t'))
+				item.remove_prefix(1);
+			while(!item.empty() && (item.back() == ' ' || item.back() == '\t'))
+				item.remove_suffix(1);
+			if(equalsIgnoreCase(item, token)) return true;
+			if(comma == std::string_view::npos) break;
+			list.remove_prefix(comma + 1);
+		}
+		return false;
+	}
+
+private:
+	struct Field
+	{
+		uint32_t keyOff;
+		uint32_t keyLen;
+		uint32_t valueOff;
+		uint32_t valueLen;
+	};
+
+	const Field &field(size_t i) const
+	{ return i < kInlineFields ? inline_[i] : overflow_[i - kInlineFields]; }
+
+	std::string_view view(uint32_t off, uint32_t len) const
+	{ return std::string_view(buffer_->peek() + off, len); }
+
+	static char toLower(char c)
+	{ return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c; }
+
+private:
+	const Buffer *buffer_;
+	Field inline_[kInlineFields];
+	std::vector<Field> overflow_;
+	size_t size_;
+};
+
+} //namespace webserver
+
+#endif
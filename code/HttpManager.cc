@@ -1,10 +1,8 @@
 #include "HttpManager.h"
 
-#include <strings.h>
-
 #include <cassert>
+#include <algorithm>
 
-#include "Timer.h"
 #include "EventLoop.h"
 #include "Channel.h"
 #include "HttpHandler.h"
@@ -15,17 +13,27 @@
 namespace webserver
 {
 
+// 时间轮每格1s，连接最多晚1s被关闭。
+static const Timestamp kWheelTick = 1000000;
+// 一圈须覆盖MAX_HTTPEXPIRETIME，超时不超过一圈的连接只移桶一次。
+static const size_t kWheelBuckets = 256;
+
 HttpManager::HttpManager(EventLoop *loop)
 	: loop_(loop),
-	  timer_(new Timer(loop_))
+	  expireTimer_(loop_->runEvery(static_cast<double>(kWheelTick) / 1000000,
+	                               std::bind(&HttpManager::handleExpireEvent, this))),
+	  keepAlive_(kWheelTick, kWheelBuckets, loop_->now()),
+	  migrateCursor_(0),
+	  migratedIn_(0),
+	  migratedOut_(0)
 {
-	timer_->setTimerExpireCallback(std::bind(&HttpManager::handleExpireEvent, this));
-	timer_->addPeriodicTimer(3);
+	keepAlive_.setExpireCallback(std::bind(&HttpManager::expireConnection, this,
+	                                       std::placeholders::_1));
 }
 
 HttpManager::~HttpManager()
 {
-	
+	loop_->cancel(expireTimer_);
 }
 
 void HttpManager::addNewHttpConnection(SP_HttpHandler handler)
@@ -34,87 +42,123 @@ void HttpManager::addNewHttpConnection(SP_HttpHandler handler)
 	// 获取 hander中的 Channel
 	SP_Channel &channel = handler->connection_->getChannel();
 	
-	// 加入 httpMap
-	httpMap.insert(make_pair(channel, handler));
+	// 加入 handlers_
+	size_t fd = static_cast<size_t>(channel->getFd());
+	if(fd >= handlers_.size())
+	{
+		handlers_.resize(std::max(fd+1, 2*handlers_.size()));
+	}
+	assert(handlers_[fd] == nullptr);
+	handlers_[fd] = handler;
+	
+	// 忙轮询模式下对新连接设置SO_BUSY_POLL
+	loop_->applySocketBusyPoll(channel->getFd());
 	
 	// 交给handler 去处理newConnection
 	handler->newConnection();
 }
 
 // 通过Manager调用 handler->handleHttpReq
-void HttpManager::handler(SP_Channel &channel)
+/* 应答发送完毕可能直接关闭连接，HttpHandler由loop延迟释放，裸指针在本轮内有效 */
+void HttpManager::handler(Channel *channel)
 {
-	if(likely(channel->isReading() && httpMap.count(channel)))
+	size_t fd = static_cast<size_t>(channel->getFd());
+	if(likely(channel->isReading() && fd < handlers_.size() && handlers_[fd]))
 	{
-		SP_HttpHandler &it = httpMap[channel];
+		HttpHandler *it = handlers_[fd].get();
 		it->handleHttpReq();
 	} 
 }
 
-void HttpManager::flushKeepAlive(SP_Channel channel, HttpManager::TimerNode &node)
+void HttpManager::delHttpConnection(SP_Channel channel)
 {
-	struct timeval time;
-	
-	bzero(&time, sizeof(time));
-	int ret = gettimeofday(&time, nullptr);
-	if(unlikely(ret<0)) 
-	{
-		perror("gettimeofday\n");
-	}
-	
-	time.tv_sec += MAX_HTTPEXPIRETIME;
-	
-	if(keepAliveSet_.count(channel))
+	size_t fd = static_cast<size_t>(channel->getFd());
+	if(fd < handlers_.size() && handlers_[fd])
 	{
-		/* 刷新超时时间 */
-		keepAliveList_.erase(node);
-	}
-	else 
-	{
-		/* 增加新KeepAlive连接 */
-		keepAliveSet_.insert(channel);
-		assert(keepAliveSet_.count(channel));
+		//Keep-Alive处理
+		keepAlive_.remove(handlers_[fd].get());
+		
+		loop_->releaseLater(std::move(handlers_[fd]));
+		handlers_[fd].reset();
+		loop_->connectionReleased();
 	}
-	
-	TimerNode it = 
-			keepAliveList_.insert(keepAliveList_.end(), make_pair(channel, time));
-	assert(it == --keepAliveList_.end());
-	node = it;
+}
+
+void HttpManager::flushKeepAlive(HttpHandler *handler)
+{
+	keepAlive_.refresh(handler, loop_->now() +
+	                            static_cast<Timestamp>(MAX_HTTPEXPIRETIME) * 1000000);
 }
 
 void HttpManager::handleExpireEvent()
 {
-	struct timeval time;
+	keepAlive_.advance(loop_->now());
+}
+
+/* 已从时间轮中移除 */
+void HttpManager::expireConnection(TimingWheelNode *node)
+{
+	/* 类间依赖过重，不太理想 */
+	/* 关闭超时连接 */
+	HttpHandler *handler = static_cast<HttpHandler *>(node);
+	handler->connection_->setState(HttpConnection::kDisconnected);
+	handler->connection_->handleClose();
+}
+
+/* 在时间轮中等待下一个请求，且连接的缓冲区都为空 */
+bool HttpManager::idle(const HttpHandler *handler)
+{
+	return handler->state_ == HttpHandler::kStart && handler->inWheel() &&
+	       handler->connection_->idle() &&
+	       !handler->connection_->getChannel()->isEnableWriting();
+}
+
+/* io_uring的multishot recv在取消完成前仍可能收下数据，不能安全地交出连接 */
+void HttpManager::migrateIdle(EventLoop *target, size_t count)
+{
+	assert(loop_->isInLoopThread());
+	if(loop_->completionIo() || handlers_.empty()) return ;
 	
-	bzero(&time, sizeof(time));
-	int ret = gettimeofday(&time, nullptr);
-	if(unlikely(ret<0)) 
+	std::vector<MigratedConnection> migrated;
+	const size_t size = handlers_.size();
+	size_t fd = migrateCursor_ % size;
+	for(size_t i=0; i<size && migrated.size()<count; ++i, fd = (fd + 1) % size)
 	{
-		perror("gettimeofday\n");
+		HttpHandler *handler = handlers_[fd].get();
+		if(handler == nullptr || !idle(handler)) continue;
+		
+		migrated.push_back(MigratedConnection{ static_cast<int>(fd), handler->expireAt,
+		                                       handler->fileCache_, handler->contentCache_ });
+		
+		/* 与关闭连接相同的注销流程(EPOLL_CTL_DEL、移出时间轮与handlers_)，只是不关闭fd */
+		/* 之后到达的数据留在套接字中，目标循环EPOLL_CTL_ADD时立即报告可读 */
+		SP_Channel channel = handler->connection_->getChannel();
+		channel->releaseFd();
+		channel->disableAll();
+		loop_->removeChannel(channel);
 	}
+	migrateCursor_ = fd;
 	
-	/* 清理所有超时连接 */
-	/* 不能边遍历，边删除 */
-	std::list<Entry>::iterator it;
-	for(it=keepAliveList_.begin(); it!=keepAliveList_.end(); ++it)
+	if(migrated.empty()) return ;
+	migratedOut_ += migrated.size();
+	for(size_t i=0; i<migrated.size(); ++i)
 	{
-		if(it->second.tv_sec > time.tv_sec)	
-			break;
-		
-		//主动断开连接时，在delHttpConnection中将其移除
-		//assert(keepAliveSet_.count(it->first));
-		if(keepAliveSet_.count(it->first))
-		{
-			keepAliveSet_.erase(it->first);
-			
-			/* 类间依赖过重，不太理想 */
-			/* 关闭超时连接 */
-			SP_HttpHandler &handler = httpMap[it->first];
-			handler->connection_->setState(HttpConnection::kDisconnected);
-			handler->connection_->handleClose();
-		}
+		target->connectionAssigned();
 	}
-	keepAliveList_.erase(keepAliveList_.begin(), it);
+	target->queueInLoop(std::bind(&EventLoop::adoptHttpConnections, target, std::move(migrated)));
 }
 
-}
\ No newline at end of file
+/* 连接对象在本线程中重新创建；尚未收到新请求，沿用原来的截止时间 */
+void HttpManager::adoptConnections(const std::vector<MigratedConnection> &connections)
+{
+	for(const MigratedConnection &migrated : connections)
+	{
+		SP_HttpHandler handler(new HttpHandler(loop_, migrated.connfd,
+		                                       migrated.fileCache, migrated.contentCache));
+		addNewHttpConnection(handler);
+		keepAlive_.refresh(handler.get(), migrated.expireAt);
+	}
+	migratedIn_ += connections.size();
+}
+
+}
@@ -1,15 +1,13 @@
 #ifndef code_HttpManager_h
 #define code_HttpManager_h
 
-#include <sys/time.h>
-
 #include <memory>
 #include <functional>
-#include <list>
-#include <unordered_set>
-#include <unordered_map>
+#include <vector>
 
 #include "Channel.h"
+#include "TimerQueue.h"
+#include "TimingWheel.h"
 
 namespace webserver
 {
@@ -17,11 +15,22 @@ namespace webserver
 class HttpHandler;
 class EventLoop;
 class Channel;
-class Timer;
+class FileCache;
+class ContentCache;
+
+/* 迁移中的空闲连接，由目标事件循环重新创建连接对象 */
+struct MigratedConnection
+{
+	int connfd;
+	/* 原有的keepalive截止时间，迁移不延长空闲超时 */
+	Timestamp expireAt;
+	FileCache *fileCache;
+	ContentCache *contentCache;
+};
 
 /* 职责：管理所有Http连接和处理 */
 /* Http处理由HttpHandler完成 */
-/* Http连接使用一个单独的定时器来完成 */
+/* KeepAlive连接挂在时间轮上，由事件循环的一个周期定时器推进 */
 /* 对于KeepAlive连接，超时断开连接(RST) */
 class HttpManager
 {
@@ -31,55 +40,63 @@ public:
 	// 处理Handler
 	typedef std::shared_ptr<HttpHandler> SP_HttpHandler;
 	
-	// ？ 超时
-	typedef std::pair<SP_Channel, struct timeval> Entry;
-	typedef std::list<Entry>::iterator TimerNode;
-	
 	HttpManager(EventLoop *loop);
 	~HttpManager();
 	
 	/* 根据channel,调用对应的HttpHandler */
-	void handler(SP_Channel &channel);
+	void handler(Channel *channel);
 	
 	/* 插入HttpMap */
 	void addNewHttpConnection(SP_HttpHandler hander);
 	
 	/* 删除某个Http连接 */
-	void delHttpConnection(SP_Channel channel)
-	{ 
-		httpMap.erase(channel); 
-		
-		//Keep-Alive处理
-		if(keepAliveSet_.count(channel))
-		{
-			keepAliveSet_.erase(channel);
-		}
-	}
-	
-	/* 更新 Http KeepAlive连接超时时间*/
-	void flushKeepAlive(SP_Channel channel, HttpManager::TimerNode &node);
-	
-	/* 超时回调函数，用于清理超时连接 */
+	/* HttpHandler延迟到本轮事件循环结束才释放 */
+	void delHttpConnection(SP_Channel channel);
+
+	
+	/* 更新 Http KeepAlive连接超时时间，只改写截止时间 */
+	void flushKeepAlive(HttpHandler *handler);
+	
+	/* 周期定时器回调，推进时间轮 */
 	void handleExpireEvent();
 	
+	/* 时间轮中的KeepAlive连接数 */
+	size_t keepAliveConnections() const { return keepAlive_.size(); }
+	
+	/* 把至多count个空闲的KeepAlive连接交给target，只支持就绪通知的后端(epoll) */
+	/* 从本循环的Poller与handlers_中注销，fd不关闭，在target中成批重新注册 */
+	void migrateIdle(EventLoop *target, size_t count);
+	/* 接收其他事件循环交出的连接 */
+	void adoptConnections(const std::vector<MigratedConnection> &connections);
+	uint64_t migratedIn() const { return migratedIn_; }
+	uint64_t migratedOut() const { return migratedOut_; }
+	
 private:
 	EventLoop *loop_;
-	std::unique_ptr<Timer> timer_;
+	TimerId expireTimer_;
+	
+	/* 记录所有Http连接，以文件描述符为下标 */
+	std::vector<SP_HttpHandler> handlers_;
+	
+	/* 记录keepalive Http连接，节点嵌在HttpHandler中 */
+	TimingWheel keepAlive_;
+	
+	/* 时间轮到期回调，关闭超时连接 */
+	void expireConnection(TimingWheelNode *node);
 	
-	/* 记录所有Http连接 */
-	std::unordered_map<SP_Channel, SP_HttpHandler, channelHash> httpMap;
+	/* 处于两次请求之间，可以迁移 */
+	static bool idle(const HttpHandler *handler);
 	
-	/* 记录keepalive Http连接 */
-	std::list<Entry> keepAliveList_;
-	std::unordered_set<SP_Channel, channelHash> keepAliveSet_;
+	/* 下一次迁移从这个fd开始查找，避免总是迁走编号小的连接 */
+	size_t migrateCursor_;
+	uint64_t migratedIn_;
+	uint64_t migratedOut_;
 };	
 	
 }
 
-/* 每个Http连接都有一个结构存储，它们的超时时间 */
-/* 以便，在相同Tcp连接中的多个Http请求，可以刷新超时时间 */
-/* HttpManager得有一个结构按照Http超时时间排序得序列 */
-/* 每个Timer溢出时，回调函数，并处理超时连接 */
-/* 使用STL list数据结构，每个Http连接持有一个指向list的迭代器 */
+/* 每个Http连接自身就是时间轮的节点，存储它的超时时间 */
+/* 以便，在相同Tcp连接中的多个Http请求，只需改写超时时间，不分配内存 */
+/* 时间轮每秒转动一格，转到的桶中已刷新的连接移到新的桶，其余的关闭 */
 
 #endif
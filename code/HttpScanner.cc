@@ -0,0 +1,226 @@
+#include "HttpScanner.h"
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTPSCANNER_X86 1
+#endif
+
+#include "macros.h"
+
+namespace webserver
+{
+
+namespace
+{
+
+/* 每个内核处理64字节，返回'\n'与':'的位图 */
+typedef void (*MaskFunc)(const char *p, uint64_t *newlines, uint64_t *colons);
+
+#ifdef HTTPSCANNER_X86
+void maskSse2(const char *p, uint64_t *newlines, uint64_t *colons)
+{
+	const __m128i nl = _mm_set1_epi8('\n');
+	const __m128i co = _mm_set1_epi8(':');
+	uint64_t n = 0, c = 0;
+	for(int i=0; i<4; ++i)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16*i));
+		n |= static_cast<uint64_t>(static_cast<uint16_t>(
+		         _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)))) << (16*i);
+		c |= static_cast<uint64_t>(static_cast<uint16_t>(
+		         _mm_movemask_epi8(_mm_cmpeq_epi8(v, co)))) << (16*i);
+	}
+	*newlines = n;
+	*colons = c;
+}
+
+__attribute__((target("avx2")))
+void maskAvx2(const char *p, uint64_t *newlines, uint64_t *colons)
+{
+	const __m256i nl = _mm256_set1_epi8('\n');
+	const __m256i co = _mm256_set1_epi8(':');
+	__m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+	__m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+	*newlines = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, nl))) |
+	            static_cast<uint64_t>(static_cast<uint32_t>(
+	                _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, nl)))) << 32;
+	*colons = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, co))) |
+	          static_cast<uint64_t>(static_cast<uint32_t>(
+	              _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, co)))) << 32;
+}
+#endif
+
+/* 没有SIMD内核时为空，逐行用memchr查找 */
+MaskFunc maskFuncOf(HttpScanner::Kernel kernel)
+{
+#ifdef HTTPSCANNER_X86
+	switch(kernel)
+	{
+	case HttpScanner::kAvx2: return maskAvx2;
+	case HttpScanner::kSse2: return maskSse2;
+	default: break;
+	}
+#endif
+	(void)kernel;
+	return nullptr;
+}
+
+} //namespace
+
+HttpScanner::Kernel HttpScanner::bestKernel()
+{
+#ifdef HTTPSCANNER_X86
+	/* SSE2内核与glibc的memchr(本身即SSE2/AVX2实现)持平，只有AVX2更快 */
+	static const Kernel kernel = __builtin_cpu_supports("avx2") ? kAvx2 : kScalar;
+	return kernel;
+#else
+	return kScalar;
+#endif
+}
+
+const char *HttpScanner::kernelName(Kernel kernel)
+{
+	switch(kernel)
+	{
+	case kAvx2: return "avx2";
+	case kSse2: return "sse2";
+	default:    return "scalar";
+	}
+}
+
+HttpScanner::HttpScanner(Kernel kernel)
+	: kernel_(kernel),
+	  head_(0),
+	  scanned_(0),
+	  pendingColon_(kNoColon)
+{
+	lines_.reserve(32);
+}
+
+/* 按位图顺序记录行尾与每行第一个':' */
+/* 每行只取第一个':'，其后的':'(如Host中的端口、Cookie、User-Agent)整段清除，不逐位遍历 */
+void HttpScanner::walk(uint64_t newlines, uint64_t colons, uint32_t base)
+{
+	while(true)
+	{
+		/* 下一个'\n'之前的部分 */
+		const uint64_t before = newlines ? (newlines & (0 - newlines)) - 1 : ~0ULL;
+		if(pendingColon_ == kNoColon && (colons & before))
+		{
+			pendingColon_ = base + __builtin_ctzll(colons & before);
+		}
+		if(newlines == 0) break;
+
+		const int i = __builtin_ctzll(newlines);
+		Line line = { base + i, pendingColon_ };
+		lines_.push_back(line);
+		pendingColon_ = kNoColon;
+
+		/* 去掉本行已处理的位 */
+		colons &= ~(before | (before + 1));
+		newlines &= newlines - 1;
+	}
+}
+
+/* 标量版本：libc的memchr已按字长/向量实现，逐字节构造位图反而更慢 */
+/* ':'只在行内、且本行尚未找到时查找 */
+void HttpScanner::scanLines(const char *data, size_t size)
+{
+	size_t pos = scanned_;
+	while(pos < size)
+	{
+		const char *nl = static_cast<const char *>(::memchr(data + pos, '\n', size - pos));
+		const size_t end = nl != nullptr ? static_cast<size_t>(nl - data) : size;
+		if(pendingColon_ == kNoColon)
+		{
+			const char *colon = static_cast<const char *>(::memchr(data + pos, ':', end - pos));
+			if(colon != nullptr) pendingColon_ = static_cast<uint32_t>(colon - data);
+		}
+		if(nl == nullptr) break;
+
+		Line line = { static_cast<uint32_t>(end), pendingColon_ };
+		lines_.push_back(line);
+		pendingColon_ = kNoColon;
+		pos = end + 1;
+	}
+	scanned_ = size;
+}
+
+void HttpScanner::scan(const char *data, size_t size)
+{
+	assert(scanned_ <= size);
+	MaskFunc mask = maskFuncOf(kernel_);
+	if(mask == nullptr)
+	{
+		scanLines(data, size);
+		return ;
+	}
+
+	size_t pos = scanned_;
+	uint64_t newlines, colons;
+	for(; pos + 64 <= size; pos += 64)
+	{
+		mask(data + pos, &newlines, &colons);
+		if(newlines | colons)
+		{
+			walk(newlines, colons, static_cast<uint32_t>(pos));
+		}
+	}
+
+	/* 不足64字节的尾部，复制到补零的块中用同一个内核 */
+	if(pos < size)
+	{
+		alignas(64) char tail[64] = {};
+		memcpy(tail, data + pos, size - pos);
+		mask(tail, &newlines, &colons);
+		walk(newlines, colons, static_cast<uint32_t>(pos));
+	}
+
+	scanned_ = size;
+}
+
+void HttpScanner::skipTo(size_t pos)
+{
+	while(hasLine() && front().end < pos) pop();
+	if(pendingColon_ != kNoColon && pendingColon_ < pos) pendingColon_ = kNoColon;
+}
+
+void HttpScanner::rewind(size_t pos)
+{
+	lines_.clear();
+	head_ = 0;
+	scanned_ = pos;
+	pendingColon_ = kNoColon;
+}
+
+void HttpScanner::consume(size_t n)
+{
+	skipTo(n);
+
+	/* 压缩已使用的行 */
+	size_t remain = lines_.size() - head_;
+	for(size_t i=0; i<remain; ++i)
+	{
+		lines_[i].end = lines_[head_+i].end - n;
+		lines_[i].colon = lines_[head_+i].colon == kNoColon
+		                  ? kNoColon : lines_[head_+i].colon - n;
+	}
+	lines_.resize(remain);
+	head_ = 0;
+
+	if(pendingColon_ != kNoColon) pendingColon_ -= n;
+	scanned_ = scanned_ > n ? scanned_ - n : 0;
+}
+
+void HttpScanner::reset()
+{
+	lines_.clear();
+	head_ = 0;
+	scanned_ = 0;
+	pendingColon_ = kNoColon;
+}
+
+} //namespace webserver
@@ -0,0 +1,72 @@
+#ifndef code_HttpScanner_h
+#define code_HttpScanner_h
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace webserver
+{
+
+/*
+ * one-pass tokenizer of the request line and header block
+ * 64 bytes per step: a kernel builds bitmasks of '\n' and ':',
+ * then set bits are walked to record each line end and the
+ * first colon of that line as offsets
+ * kernel is chosen once at runtime via cpuid: AVX2 when present,
+ * otherwise a scalar walk over lines with memchr, which measures
+ * level with the SSE2 kernel; SSE2 stays selectable explicitly
+ */
+// 请求扫描器：一次扫描得到每行的结束位置('\n')及该行第一个':'的位置
+// 偏移相对于接收缓冲区的可读起点，已扫描的字节不会再扫描
+// 取走缓冲区数据后，调用consume同步偏移
+class HttpScanner
+{
+public:
+	enum Kernel { kScalar, kSse2, kAvx2 };
+
+	static const uint32_t kNoColon = UINT32_MAX;
+
+	struct Line
+	{
+		uint32_t end;	/* '\n'的偏移 */
+		uint32_t colon;	/* 本行第一个':'的偏移，没有时为kNoColon */
+	};
+
+	/* 根据cpuid选择的最快内核：AVX2或标量(memchr) */
+	static Kernel bestKernel();
+	static const char *kernelName(Kernel kernel);
+
+	explicit HttpScanner(Kernel kernel = bestKernel());
+
+	/* 扫描[data+scanned(), data+size)中新到达的字节 */
+	void scan(const char *data, size_t size);
+
+	size_t scanned() const { return scanned_; }
+	bool hasLine() const { return head_ < lines_.size(); }
+	const Line &front() const { return lines_[head_]; }
+	void pop() { ++head_; }
+
+	/* 丢弃结束位置在pos之前的行(如请求体中的行) */
+	void skipTo(size_t pos);
+	/* 丢弃所有行，从pos处重新扫描(pos之后的数据已不是请求头) */
+	void rewind(size_t pos);
+	/* 缓冲区取走了前n个字节，所有偏移减去n */
+	void consume(size_t n);
+	void reset();
+
+private:
+	void walk(uint64_t newlines, uint64_t colons, uint32_t base);
+	void scanLines(const char *data, size_t size);
+
+private:
+	Kernel kernel_;
+	std::vector<Line> lines_;
+	size_t head_;
+	size_t scanned_;
+	uint32_t pendingColon_;	/* 当前未结束行的第一个':' */
+};
+
+} //namespace webserver
+
+#endif
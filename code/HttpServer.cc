@@ -1,16 +1,15 @@
 #include "HttpServer.h"
 
 #include <cassert>
+#include <cstdio>
 
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
-
+#include "Acceptor.h"
+#include "CountDownLatch.h"
+#include "CpuPlacement.h"
 #include "EventLoop.h"
 #include "EventLoopThreadPool.h"
 #include "HttpHandler.h"
-#include "Channel.h"
+#include "FileCache.h"
 #include "macros.h"
 #include "utils.h"
 #include "config.h"
@@ -23,21 +22,29 @@
 namespace webserver
 {
 	
-HttpServer::HttpServer(EventLoop *loop, const InetAddress &addr, int numThreads)
+HttpServer::HttpServer(EventLoop *loop, const InetAddress &addr, int numThreads,
+                       bool reusePort)
 	: mainLoop_(loop),		// 将 主事件循环 传递给 HttpServer对象
 	  numThreads_(numThreads),		// 最大线程数
 	  threadPool_(new EventLoopThreadPool(mainLoop_, numThreads_)),	// 使用事件循环(同时将主事件循环(mainLoop)传递给 EventLoopThreadPool的对象) 和最大线程数来创建线程池
-	  listenFd_(utils::SocketBindListen(addr)),	//使用 SocketBindListen 函数创建并绑定到指定地址的监听套接字。
-	  acceptChannel_(new Channel(listenFd_, mainLoop_)),		// 负责监听的Channel，start绑定Read的回调函数 使用 监听fd和主循环 创建Channel
+	  addr_(addr),
+	  reusePort_(reusePort && numThreads > 0),
+	  handoffBatches_(0),
+	  steering_(kSteerHash),
 	  started_(false),
-	  idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))	// 打开空闲文件描述符
+	  fileCache_(new FileCache(mainLoop_, HTTP_DOCROOT)),	// inotify由主事件循环监听
+	  contentCache_(CONTENT_CACHE_BYTES > 0 ? 
+	                new ContentCache(CONTENT_CACHE_BYTES, CONTENT_CACHE_MAX_OBJECT) : nullptr)
 {
-	// 判断 fd > 0
-	assert(listenFd_ > 0);
-	assert(idleFd_ > 0);
-	
-	// 允许在同一端口上快速重用处于TIME_WAIT状态的套接字
-	utils::setReuseAddr(listenFd_, true);
+	// 主事件循环负责accept时，立即创建并绑定监听套接字，端口被占用时尽早报错
+	// 没有I/O线程时，主事件循环就是唯一的事件循环，reusePort只影响套接字选项
+	if(!reusePort_)
+	{
+		acceptor_.reset(new Acceptor(mainLoop_, addr_, reusePort));
+		acceptor_->setNewConnectionCallback(
+			std::bind(&HttpServer::newConnection, this, std::placeholders::_1));
+		acceptor_->setBurstEndCallback(std::bind(&HttpServer::flushHandoffs, this));
+	}
 
 	// 设置信号处理以忽略 SIGPIPE。
 	utils::IgnoreSigpipe();
@@ -58,61 +65,185 @@ void HttpServer::start()
 	assert(!started_);
 	started_ = true;
 	
-	// 设置Channel读的回调函数，并且启动 Reading
-	// 将接受通道的读回调设置为 acceptor 方法，并启用通道进行读取。
+	// 启动线程池。
+	threadPool_->start(threadInitCallback_);
+	
 	/* main loop be used to accept new connections */
-	acceptChannel_->setReadCallback(std::bind(&HttpServer::acceptor, this));
-	acceptChannel_->enableReading();
+	if(acceptor_)
+	{
+		for(EventLoop *loop : threadPool_->getAllLoops())
+		{
+			handoffs_.push_back(Handoff{ loop, std::vector<int>() });
+		}
+		acceptor_->listen();
+		return ;
+	}
 	
-	// 启动线程池。
-	threadPool_->start();
+	/* 各I/O线程在本线程中创建监听套接字，Channel的注册须在所属线程中进行 */
+	/* 依次创建，监听套接字在SO_REUSEPORT组中的下标与I/O线程的下标相同 */
+	std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+	loopAcceptors_.resize(loops.size());
+	loopCpus_.resize(loops.size());
+	for(size_t i=0; i<loops.size(); ++i)
+	{
+		CountDownLatch latch(1);
+		loops[i]->runInLoop(std::bind(&HttpServer::startLoopAcceptor, this, loops[i], i, &latch));
+		latch.wait();
+	}
+
+	if(steering_ != kSteerHash)
+	{
+		steerByCpu();
+	}
 }
 
-// 此方法负责接受新连接。
-// 每次由 listenfd有Reading时，即调用一次
-void HttpServer::acceptor()
+void HttpServer::startLoopAcceptor(EventLoop *loop, size_t index, CountDownLatch *latch)
 {
+	Acceptor *acceptor = new Acceptor(loop, addr_, true);
+	/* 本线程accept的连接直接在本线程创建，不经过任务队列与eventfd */
+	acceptor->setNewConnectionCallback(
+		std::bind(&HttpServer::newLocalConnection, this, loop, std::placeholders::_1));
+	acceptor->listen();
+	loopAcceptors_[index].reset(acceptor);
+	loopCpus_[index] = CpuPlacement::currentAffinity();
+	latch->countDown();
+}
 
-#ifdef DEBUG
-	printf("void HttpServer::acceptor() \n");
-#endif // DEBUG	
+void HttpServer::steerByCpu()
+{
+	/* 允许运行在多个CPU上、且与主线程相同的I/O线程视为未绑定 */
+	const std::vector<int> all = CpuPlacement::currentAffinity();
+	std::vector<int> indexOfCpu;
+	size_t pinned = 0;
+	for(size_t i=0; i<loopCpus_.size(); ++i)
+	{
+		const std::vector<int> &cpus = loopCpus_[i];
+		if(cpus.empty() || (cpus.size() > 1 && cpus == all)) continue;
+		++pinned;
+
+		/* 多个I/O线程共用的CPU归下标最小的一个 */
+		for(int cpu : cpus)
+		{
+			if(static_cast<size_t>(cpu) >= indexOfCpu.size()) indexOfCpu.resize(cpu + 1, -1);
+			if(indexOfCpu[cpu] < 0) indexOfCpu[cpu] = static_cast<int>(i);
+		}
+		if(steering_ == kSteerIncomingCpu)
+		{
+			utils::setIncomingCpu(loopAcceptors_[i]->listenFd(), cpus[0]);
+		}
+	}
 
-	InetAddress addr(0);
-	int connfd;
+	if(pinned == 0)
+	{
+		fprintf(stderr, "steering: no I/O thread is bound to a cpu, using hash\n");
+		return ;
+	}
+	if(steering_ == kSteerCpuFilter)
+	{
+		utils::attachReusePortCpuFilter(loopAcceptors_[0]->listenFd(), indexOfCpu);
+	}
+}
+
+std::vector<uint64_t> HttpServer::acceptedPerAcceptor() const
+{
+	std::vector<uint64_t> accepted;
+	if(acceptor_) accepted.push_back(acceptor_->accepted());
+	for(const auto &acceptor : loopAcceptors_)
+	{
+		accepted.push_back(acceptor->accepted());
+	}
+	return accepted;
+}
+
+void HttpServer::setDispatchPolicy(EventLoopThreadPool::DispatchPolicy policy)
+{
+	assert(!started_);
+	threadPool_->setDispatchPolicy(policy);
+}
+
+void HttpServer::setRebalanceInterval(double seconds)
+{
+	assert(!started_);
+	threadPool_->setRebalanceInterval(seconds);
+}
+
+std::vector<int> HttpServer::connectionsPerLoop() const
+{
+	std::vector<int> connections;
+	for(EventLoop *loop : threadPool_->getAllLoops())
+	{
+		connections.push_back(loop->connectionCount());
+	}
+	return connections;
+}
+
+ContentCache::Stats HttpServer::contentCacheStats() const
+{
+	if(contentCache_ == nullptr)
+	{
+		return ContentCache::Stats();
+	}
+	return contentCache_->stats();
+}
+
+void HttpServer::newConnection(int connfd)
+{
+	// 对于每个接受的连接，从线程池中选一个事件循环 EventLoop，每一个事件循环都有一个 httpManager。
+	// 同一批accept的连接按事件循环分组，批结束时每个事件循环只投递一个任务，
+	// 连接风暴(如负载均衡切换之后)时不再每个连接一次入队与唤醒。
+	EventLoop *loop = threadPool_->getNextLoop();
+	
+	// 立即计入目标事件循环的连接数，一批accept的连接不会都分给同一个循环。
+	loop->connectionAssigned();
 	
-	// 接受新连接
-	// 使用非阻塞的 AcceptNb 方法接受新连接，并以边缘触发模式进行处理。
-	//edge trigger mode
-	while((connfd = utils::AcceptNb(listenFd_, addr)) > 0 || errno == EMFILE)
+	/* 事件循环不超过几十个，顺序查找 */
+	for(Handoff &handoff : handoffs_)
 	{
-		// 在文件描述符耗尽的情况下（EMFILE 错误），通过关闭一个空闲文件描述符并重新打开它来应用解决方法。
-		/* File descriptor exhausted */
-		if(unlikely(errno == EMFILE))
+		if(handoff.loop == loop)
 		{
-			::close(idleFd_);
-			idleFd_ = ::accept(listenFd_, NULL, NULL);
-			::close(idleFd_);
-			idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
-			continue;
+			handoff.connfds.push_back(connfd);
+			return ;
 		}
+	}
+	
+	/* start时已为每个事件循环建好分组；不在其中的循环也按批转交，连接不会丢失 */
+	handoffs_.push_back(Handoff{ loop, std::vector<int>(1, connfd) });
+}
+
+void HttpServer::flushHandoffs()
+{
+	for(Handoff &handoff : handoffs_)
+	{
+		if(handoff.connfds.empty()) continue;
 		
-		// 对于每个接受的连接，创建一个新的 HttpHandler 实例，
-		// 与线程池中的一个事件循环相关联，并将其添加到事件循环的队列中以进一步处理。
-
-		// 从线程池中获取一个事件循环对象 EventLoop。
-		// 每一个事件循环都有一个 httpManager
-		// 将 处理连接上来的connsocket 交给 threadPool来处理；
-		EventLoop *loop = threadPool_->getNextLoop();
-		// 创建一个新的 HttpHandler 实例，该实例与上面获取的事件循环相关联，并传入新连接的文件描述符 connfd。
-		std::shared_ptr<HttpHandler> handler(new HttpHandler(loop, connfd));
-		
-		// 将新的 HttpHandler 实例添加到事件循环的队列中以进行进一步处理。
-		loop->queueInLoop(std::bind(&EventLoop::addHttpConnection, loop, handler));	
+		// 在目标事件循环的线程中创建 HttpHandler 实例，并加入该事件循环。
+		// 连接对象与缓冲区由I/O线程分配，线程绑定了NUMA节点时内存在本地节点。
+		++handoffBatches_;
+		handoff.loop->queueInLoop(std::bind(&HttpServer::addConnectionsInLoop, this,
+		                                    handoff.loop, std::move(handoff.connfds)));
+		handoff.connfds.clear();
+	}
+}
 
-#ifdef DEBUG
-	printf("fd=%d, %s1\n", connfd, addr.toIpPortString().c_str());
-#endif // DEBUG	
+void HttpServer::addConnectionsInLoop(EventLoop *loop, const std::vector<int> &connfds)
+{
+	for(int connfd : connfds)
+	{
+		addConnectionInLoop(loop, connfd);
 	}
 }
 
+void HttpServer::newLocalConnection(EventLoop *loop, int connfd)
+{
+	loop->connectionAssigned();
+	addConnectionInLoop(loop, connfd);
+}
+
+void HttpServer::addConnectionInLoop(EventLoop *loop, int connfd)
+{
+	std::shared_ptr<HttpHandler> handler(new HttpHandler(loop, connfd, 
+	                                              fileCache_.get(), contentCache_.get()));
+	loop->addHttpConnection(handler);
+}
+
 }//namespace webserver
@@ -1,32 +1,86 @@
 #ifndef code_HttpServer_h
 #define code_HttpServer_h
 
+#include <functional>
 #include <memory>
 #include <vector>
 
 #include "InetAddress.h"
+#include "ContentCache.h"
+#include "EventLoopThreadPool.h"
 
 namespace webserver
 {
 	
-class Channel;
+class Acceptor;
+class CountDownLatch;
 class EventLoop;
-class EventLoopThreadPool;
+class FileCache;
+class ContentCache;
 
 class HttpServer
 {
 public:
+	typedef std::function<void (EventLoop*)> ThreadInitCallback;
+
+	// reusePort模式下，内核如何在各I/O线程的监听套接字之间选择
+	// kSteerHash：内核默认的四元组哈希
+	// kSteerCpuFilter：cBPF程序，交给绑定在处理该连接收包软中断的CPU上的I/O线程
+	// kSteerIncomingCpu：各监听套接字设置SO_INCOMING_CPU，由内核匹配当前CPU(6.2+)
+	// 只对绑定了CPU的I/O线程生效，其余CPU上到达的连接仍按哈希选择
+	enum Steering { kSteerHash, kSteerCpuFilter, kSteerIncomingCpu };
+	
 	// 处理事件的循环，网络配置的结构体，最大线程数
 	// webserver::HttpServer server(&mainLoop, self_addr, 12); server.start(); mainLoop.loop();
-	HttpServer(EventLoop *loop, const InetAddress &addr, int numThreads);
+	// reusePort为true时，每个I/O线程各自监听一个SO_REUSEPORT套接字并在本线程accept，
+	// 由内核分配新连接，不再经主事件循环转交；否则由主事件循环accept后轮流分给I/O线程。
+	HttpServer(EventLoop *loop, const InetAddress &addr, int numThreads,
+	           bool reusePort = false);
 	~HttpServer();
 	
+	// 在start之前设置，各I/O线程在进入事件循环之前调用(如开启忙轮询)
+	void setThreadInitCallback(const ThreadInitCallback &cb)
+	{ threadInitCallback_ = cb; }
+	
+	// 在start之前设置，只在reusePort模式下有效
+	void setSteering(Steering steering) { steering_ = steering; }
+	
+	// 在start之前设置，主事件循环accept时把连接分给哪个I/O线程，默认轮流
+	void setDispatchPolicy(EventLoopThreadPool::DispatchPolicy policy);
+	
+	// 在start之前设置，每隔seconds秒把空闲的keep-alive连接从负载最高的I/O线程迁到最低的，0为关闭
+	void setRebalanceInterval(double seconds);
+	
 	// 开始服务器
 	void start();
 
-	// 此方法处理socket新连接
-	void acceptor();
+	// 各个监听套接字已接受的连接数，start之后在主事件循环线程中调用。
+	std::vector<uint64_t> acceptedPerAcceptor() const;
+
+	// 各I/O线程当前的连接数(含在途)，start之后任何线程都可以调用。
+	std::vector<int> connectionsPerLoop() const;
+
+	// 主事件循环转交给I/O线程的批次数，与acceptedPerAcceptor之比为平均批大小。
+	uint64_t handoffBatches() const { return handoffBatches_; }
+
+	// 内容缓存的命中、未命中、淘汰计数，用于确定缓存大小。
+	ContentCache::Stats contentCacheStats() const;
 	
+private:
+	// 主事件循环accept的新连接，选定事件循环后先攒着
+	void newConnection(int connfd);
+	// 一批accept结束，每个事件循环只投递一个任务
+	void flushHandoffs();
+	// 在目标事件循环的线程中创建连接
+	void addConnectionInLoop(EventLoop *loop, int connfd);
+	void addConnectionsInLoop(EventLoop *loop, const std::vector<int> &connfds);
+	// reusePort模式下，I/O线程自己accept的新连接
+	void newLocalConnection(EventLoop *loop, int connfd);
+	// reusePort模式下，在第index个I/O线程中创建并启动监听
+	void startLoopAcceptor(EventLoop *loop, size_t index, CountDownLatch *latch);
+	// 按各I/O线程绑定的CPU设置连接的分配
+	void steerByCpu();
+
 private:
 	// 指向主事件循环的指针。
 	EventLoop *mainLoop_;
@@ -37,17 +91,38 @@ private:
 	// 指向 EventLoopThreadPool 对象的独特指针。
 	std::unique_ptr<EventLoopThreadPool> threadPool_;
 
-	// 表示用于监听的文件描述符的整数。
-	int listenFd_;
-
-	// 指向 Channel 对象的共享指针。
-	// 监听fd的Channel ，在里面设置 监听处理的回调函数，此处应为单线程的处理
-	std::shared_ptr<Channel> acceptChannel_;
+	// 监听地址。
+	InetAddress addr_;
+	// 是否每个I/O线程各自监听。
+	bool reusePort_;
+	
+	// 主事件循环上的监听，reusePort模式下为空。
+	std::unique_ptr<Acceptor> acceptor_;
+	// 本批accept中分给各事件循环的连接，只在主事件循环线程中使用。
+	struct Handoff
+	{
+		EventLoop *loop;
+		std::vector<int> connfds;
+	};
+	std::vector<Handoff> handoffs_;
+	uint64_t handoffBatches_;
+	// reusePort模式下各I/O线程的监听，各自在所属线程中创建。
+	std::vector<std::unique_ptr<Acceptor>> loopAcceptors_;
+	// 各I/O线程允许运行的CPU，在线程初始化之后取得。
+	std::vector<std::vector<int>> loopCpus_;
+	// 连接在各监听套接字间的分配方式。
+	Steering steering_;
 
 	// 服务器是否已启动。
 	bool started_;
-	// 表示空闲文件描述符的整数。
-	int idleFd_;
+
+	// 静态文件缓存，所有事件循环共享。
+	std::unique_ptr<FileCache> fileCache_;
+	// 小文件内容缓存，所有事件循环共享，可能为空。
+	std::unique_ptr<ContentCache> contentCache_;
+	
+	// 传给线程池，在每个I/O线程中调用。
+	ThreadInitCallback threadInitCallback_;
 };
 
 }//namespace webserver
@@ -0,0 +1,166 @@
+#include "IoUring.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "macros.h"
+
+namespace webserver
+{
+
+IoUring::IoUring(unsigned entries, unsigned flags)
+	: ringFd_(-1),
+	  features_(0),
+	  ringPtr_(MAP_FAILED),
+	  ringSize_(0),
+	  sqes_(static_cast<struct io_uring_sqe *>(MAP_FAILED)),
+	  sqesSize_(0),
+	  sqeTail_(0),
+	  sqeHead_(0),
+	  enterCalls_(0)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	params.flags = flags;
+
+	int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+	if(fd < 0) return ;
+
+	/* 只支持SQ与CQ共用一次mmap的内核(5.4+) */
+	if(!(params.features & IORING_FEAT_SINGLE_MMAP))
+	{
+		::close(fd);
+		return ;
+	}
+
+	size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	ringSize_ = std::max(sqSize, cqSize);
+	ringPtr_ = ::mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE,
+	                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+	void *sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+	                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if(ringPtr_ == MAP_FAILED || sqes == MAP_FAILED)
+	{
+		perror("io_uring mmap");
+		if(ringPtr_ != MAP_FAILED) ::munmap(ringPtr_, ringSize_);
+		if(sqes != MAP_FAILED) ::munmap(sqes, sqesSize_);
+		ringPtr_ = MAP_FAILED;
+		::close(fd);
+		return ;
+	}
+	sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+
+	char *ring = static_cast<char *>(ringPtr_);
+	sqHead_ = reinterpret_cast<unsigned *>(ring + params.sq_off.head);
+	sqTail_ = reinterpret_cast<unsigned *>(ring + params.sq_off.tail);
+	sqMask_ = *reinterpret_cast<unsigned *>(ring + params.sq_off.ring_mask);
+	sqEntries_ = *reinterpret_cast<unsigned *>(ring + params.sq_off.ring_entries);
+	sqArray_ = reinterpret_cast<unsigned *>(ring + params.sq_off.array);
+
+	cqHead_ = reinterpret_cast<unsigned *>(ring + params.cq_off.head);
+	cqTail_ = reinterpret_cast<unsigned *>(ring + params.cq_off.tail);
+	cqMask_ = *reinterpret_cast<unsigned *>(ring + params.cq_off.ring_mask);
+	cqes_ = reinterpret_cast<struct io_uring_cqe *>(ring + params.cq_off.cqes);
+
+	/* SQ数组与SQE一一对应，之后不再改动 */
+	for(unsigned i=0; i<sqEntries_; ++i)
+	{
+		sqArray_[i] = i;
+	}
+
+	sqeTail_ = sqeHead_ = *sqTail_;
+	features_ = params.features;
+	ringFd_ = fd;
+}
+
+IoUring::~IoUring()
+{
+	if(ringFd_ < 0) return ;
+	::munmap(sqes_, sqesSize_);
+	::munmap(ringPtr_, ringSize_);
+	::close(ringFd_);
+}
+
+struct io_uring_sqe *IoUring::getSqe()
+{
+	if(unlikely(sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_))
+	{
+		/* SQ已满，先交给内核；内核有进展就继续提交，直到腾出空位 */
+		do
+		{
+			if(submit() <= 0) return nullptr;
+		} while(sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_);
+	}
+
+	struct io_uring_sqe *sqe = &sqes_[sqeTail_ & sqMask_];
+	memset(sqe, 0, sizeof(*sqe));
+	++sqeTail_;
+	return sqe;
+}
+
+int IoUring::enter(unsigned toSubmit, unsigned minComplete, unsigned flags,
+                   const void *arg, size_t argSize)
+{
+	/* 发布排队的SQE */
+	__atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+
+	++enterCalls_;
+	int ret = static_cast<int>(::syscall(__NR_io_uring_enter, ringFd_, toSubmit,
+	                                     minComplete, flags, arg, argSize));
+	if(ret < 0) return -errno;
+
+	sqeHead_ += static_cast<unsigned>(ret);
+	return ret;
+}
+
+int IoUring::submit()
+{
+	unsigned toSubmit = pending();
+	if(toSubmit == 0) return 0;
+	return enter(toSubmit, 0, 0, nullptr, 0);
+}
+
+int IoUring::submitAndWait(int timeoutMs)
+{
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	arg.sigmask_sz = _NSIG / 8;
+
+	if(timeoutMs >= 0)
+	{
+		ts.tv_sec = timeoutMs / 1000;
+		ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000000;
+		arg.ts = reinterpret_cast<uint64_t>(&ts);
+	}
+
+	/* 已有完成事件时不阻塞 */
+	unsigned minComplete = cqReady() ? 0 : 1;
+	return enter(pending(), minComplete, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+	             &arg, sizeof(arg));
+}
+
+int IoUring::registerBufRing(void *ring, unsigned entries, unsigned groupId)
+{
+	struct io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+	reg.ring_entries = entries;
+	reg.bgid = static_cast<uint16_t>(groupId);
+
+	int ret = static_cast<int>(::syscall(__NR_io_uring_register, ringFd_,
+	                                     IORING_REGISTER_PBUF_RING, &reg, 1));
+	return ret < 0 ? -errno : ret;
+}
+
+} //namespace webserver
@@ -0,0 +1,95 @@
+#ifndef code_IoUring_h
+#define code_IoUring_h
+
+#include <cstddef>
+#include <cstdint>
+
+#include <linux/io_uring.h>
+
+#include "noncopyable.h"
+
+namespace webserver
+{
+
+/*
+ * minimal io_uring ring built on the raw syscalls
+ * SQEs are only queued by getSqe(); everything queued during an
+ * event loop iteration goes to the kernel in the single
+ * io_uring_enter() that also waits for completions
+ */
+// io_uring环的最小封装，直接使用系统调用，不依赖liburing
+// getSqe只在用户态排队，一轮事件循环中的所有请求在等待完成事件时一次提交
+// 只能被创建它的线程使用
+class IoUring : noncopyable
+{
+public:
+	/* flags为IORING_SETUP_*，失败时valid()为false */
+	IoUring(unsigned entries, unsigned flags);
+	~IoUring();
+
+	bool valid() const { return ringFd_ >= 0; }
+	int fd() const { return ringFd_; }
+	unsigned features() const { return features_; }
+
+	/* 取一个清零的SQE，SQ已满时先提交已排队的请求 */
+	struct io_uring_sqe *getSqe();
+	unsigned pending() const { return sqeTail_ - sqeHead_; }
+
+	/* 提交排队的请求，并等待至少一个完成事件，timeoutMs<0时一直等待 */
+	/* 返回提交的个数，出错时返回-errno(超时为-ETIME) */
+	int submitAndWait(int timeoutMs);
+	/* 只提交，不等待 */
+	int submit();
+
+	/* 完成事件：peek取队首，seen标记已处理 */
+	struct io_uring_cqe *peekCqe()
+	{
+		unsigned head = *cqHead_;
+		if(head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) return nullptr;
+		return &cqes_[head & cqMask_];
+	}
+	void seen()
+	{ __atomic_store_n(cqHead_, *cqHead_ + 1, __ATOMIC_RELEASE); }
+	bool cqReady() const
+	{ return *cqHead_ != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE); }
+
+	/* 注册provided buffer ring，ring为页对齐的内存 */
+	int registerBufRing(void *ring, unsigned entries, unsigned groupId);
+
+	/* io_uring_enter调用次数，用于基准测试 */
+	uint64_t enterCalls() const { return enterCalls_; }
+
+private:
+	int enter(unsigned toSubmit, unsigned minComplete, unsigned flags,
+	          const void *arg, size_t argSize);
+
+private:
+	int ringFd_;
+	unsigned features_;
+
+	void *ringPtr_;
+	size_t ringSize_;
+	struct io_uring_sqe *sqes_;
+	size_t sqesSize_;
+
+	unsigned *sqHead_;
+	unsigned *sqTail_;
+	unsigned sqMask_;
+	unsigned sqEntries_;
+	unsigned *sqArray_;
+
+	unsigned *cqHead_;
+	unsigned *cqTail_;
+	unsigned cqMask_;
+	struct io_uring_cqe *cqes_;
+
+	/* 用户态已排队/已提交的位置 */
+	unsigned sqeTail_;
+	unsigned sqeHead_;
+
+	uint64_t enterCalls_;
+};
+
+} //namespace webserver
+
+#endif
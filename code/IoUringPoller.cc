@@ -0,0 +1,489 @@
+#include "IoUringPoller.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/epoll.h>
+#include <sys/mman.h>
+
+#include "Channel.h"
+#include "macros.h"
+
+namespace webserver
+{
+
+namespace
+{
+
+const unsigned kSetupFlags = IORING_SETUP_SUBMIT_ALL |
+                             IORING_SETUP_SINGLE_ISSUER |
+                             IORING_SETUP_DEFER_TASKRUN;
+
+}
+
+/* DEFER_TASKRUN(6.1)可用时，multishot recv/accept与provided buffer ring也都可用 */
+bool IoUringPoller::available()
+{
+	static const bool ok = []() {
+		IoUring probe(8, kSetupFlags);
+		return probe.valid() && (probe.features() & IORING_FEAT_EXT_ARG);
+	}();
+	return ok;
+}
+
+IoUringPoller::IoUringPoller()
+	: ring_(new IoUring(kRingEntries, kSetupFlags)),
+	  iteration_(0),
+	  bufRing_(nullptr),
+	  bufRingSize_(kBufferCount * sizeof(struct io_uring_buf)),
+	  buffers_(nullptr),
+	  bufTail_(0)
+{
+	if(unlikely(!ring_->valid()))
+	{
+		fprintf(stderr, "io_uring_setup failed\n");
+		abort();
+	}
+
+	void *ring = ::mmap(nullptr, bufRingSize_, PROT_READ | PROT_WRITE,
+	                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	void *buffers = ::mmap(nullptr, kBufferCount * kBufferSize, PROT_READ | PROT_WRITE,
+	                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(unlikely(ring == MAP_FAILED || buffers == MAP_FAILED))
+	{
+		perror("mmap");
+		abort();
+	}
+	bufRing_ = static_cast<struct io_uring_buf_ring *>(ring);
+	buffers_ = static_cast<char *>(buffers);
+
+	int ret = ring_->registerBufRing(bufRing_, kBufferCount, kBufferGroup);
+	if(unlikely(ret < 0))
+	{
+		fprintf(stderr, "io_uring register buffer ring: %s\n", strerror(-ret));
+		abort();
+	}
+	for(unsigned bid=0; bid<kBufferCount; ++bid)
+	{
+		recycleBuffer(bid);
+	}
+}
+
+IoUringPoller::~IoUringPoller()
+{
+	/* 先关闭环，内核不再访问缓冲区 */
+	ring_.reset();
+	::munmap(buffers_, kBufferCount * kBufferSize);
+	::munmap(bufRing_, bufRingSize_);
+}
+
+/* 排队的请求在此一次提交，并等待完成事件 */
+void IoUringPoller::poll(int timeout, ChannelList *activeChannels)
+{
+	++iteration_;
+	activeChannels->clear();
+
+	if(unlikely(!deferred_.empty())) flushDeferred();
+
+	int ret = ring_->submitAndWait(timeout);
+	if(unlikely(ret < 0 && ret != -ETIME && ret != -EINTR && ret != -EBUSY))
+	{
+		fprintf(stderr, "io_uring_enter: %s\n", strerror(-ret));
+	}
+
+	struct io_uring_cqe *cqe;
+	while((cqe = ring_->peekCqe()) != nullptr)
+	{
+		uint64_t userData = cqe->user_data;
+		int res = cqe->res;
+		unsigned flags = cqe->flags;
+		ring_->seen();
+
+		/* 取消请求本身的完成事件 */
+		if(userData == 0) continue;
+		handleCompletion(reinterpret_cast<Operation *>(userData), res, flags, activeChannels);
+	}
+}
+
+void IoUringPoller::handleCompletion(Operation *op, int res, unsigned flags,
+                                     ChannelList *activeChannels)
+{
+	const bool more = flags & IORING_CQE_F_MORE;
+
+	if(op->type == Operation::kRecv && (flags & IORING_CQE_F_BUFFER))
+	{
+		/* 数据拷入接收缓冲区后立即归还 */
+		unsigned bid = flags >> IORING_CQE_BUFFER_SHIFT;
+		if(res > 0 && !op->canceled)
+		{
+			op->channel->handleRecv(buffers_ + bid * kBufferSize, static_cast<size_t>(res));
+		}
+		recycleBuffer(bid);
+	}
+
+	if(op->canceled)
+	{
+		if(!more) releaseOperation(op);
+		return ;
+	}
+
+	switch(op->type)
+	{
+	case Operation::kPoll:
+	{
+		if(res > 0) markActive(op, res, activeChannels);
+		else if(res < 0) markActive(op, EPOLLERR, activeChannels);
+		if(!more)
+		{
+			Slot &slot = slotOf(op->channel->getFd());
+			slot.poll = nullptr;
+			releaseOperation(op);
+			/* 被内核终止(如CQ溢出)，重新注册 */
+			if(res >= 0 && slot.pollMask) arm(slot, Operation::kPoll, slot.pollMask);
+		}
+		break;
+	}
+
+	case Operation::kRecv:
+	{
+		if(res > 0)
+		{
+			markActive(op, EPOLLIN, activeChannels);
+		}
+		else if(res == 0)
+		{
+			/* 对端关闭写半部 */
+			op->channel->handleRecv(nullptr, 0);
+			markActive(op, EPOLLIN, activeChannels);
+		}
+		else if(res != -ENOBUFS)
+		{
+			markActive(op, EPOLLERR, activeChannels);
+		}
+
+		if(!more)
+		{
+			Slot &slot = slotOf(op->channel->getFd());
+			slot.recv = nullptr;
+			releaseOperation(op);
+			/* 缓冲区耗尽或被内核终止，数据仍在socket中，重新注册 */
+			if((res > 0 || res == -ENOBUFS) && (slot.channel->events() & EPOLLIN))
+				arm(slot, Operation::kRecv, 0);
+		}
+		break;
+	}
+
+	case Operation::kAccept:
+	{
+		op->channel->handleAccept(res);
+		if(unlikely(op->canceled))
+		{
+			/* 回调中移除了Channel */
+			if(!more) releaseOperation(op);
+		}
+		else if(!more)
+		{
+			Slot &slot = slotOf(op->channel->getFd());
+			slot.accept = nullptr;
+			releaseOperation(op);
+			/* EMFILE等由AcceptCallback处理后继续接受 */
+			bool fatal = res == -EINVAL || res == -EBADF || res == -ENOTSOCK ||
+			             res == -EOPNOTSUPP;
+			if(!fatal && (slot.channel->events() & EPOLLIN))
+				arm(slot, Operation::kAccept, 0);
+		}
+		break;
+	}
+
+	case Operation::kSend:
+	{
+		Slot &slot = slotOf(op->channel->getFd());
+		if(slot.send == op) slot.send = nullptr;
+		op->channel->setSendResult(res);
+		markActive(op, EPOLLOUT, activeChannels);
+		releaseOperation(op);
+		break;
+	}
+	}
+}
+
+/* 同一Channel在一轮中只加入activeChannels一次 */
+void IoUringPoller::markActive(Operation *op, int revents, ChannelList *activeChannels)
+{
+	Channel *channel = op->channel.get();
+	Slot &slot = slotOf(channel->getFd());
+	if(slot.activeStamp != iteration_)
+	{
+		slot.activeStamp = iteration_;
+		channel->set_revents(revents);
+		activeChannels->push_back(channel);
+	}
+	else
+	{
+		channel->set_revents(channel->revents() | revents);
+	}
+}
+
+IoUringPoller::Slot &IoUringPoller::slotOf(int fd)
+{
+	size_t index = static_cast<size_t>(fd);
+	if(unlikely(index >= slots_.size()))
+	{
+		Slot empty = { SP_Channel(), nullptr, 0, nullptr, nullptr, nullptr, 0 };
+		slots_.resize(std::max(index+1, 2*slots_.size()), empty);
+	}
+	return slots_[index];
+}
+
+/* 根据关注的事件与Channel的回调，决定使用poll、recv还是accept */
+void IoUringPoller::updateChannel(SP_Channel &channel)
+{
+	Slot &slot = slotOf(channel->getFd());
+	if(slot.channel == nullptr)
+	{
+		slot.channel = channel;
+	}
+	assert(slot.channel == channel);
+
+	const int events = channel->events();
+	const bool reading = events & (EPOLLIN | EPOLLPRI);
+	const bool wantRecv = reading && channel->hasRecvCallback();
+	const bool wantAccept = reading && channel->hasAcceptCallback();
+
+	unsigned pollMask = static_cast<unsigned>(events) & ~static_cast<unsigned>(EPOLLET);
+	if(wantRecv || wantAccept) pollMask &= ~static_cast<unsigned>(EPOLLIN | EPOLLPRI);
+
+	if(wantRecv && slot.recv == nullptr) arm(slot, Operation::kRecv, 0);
+	else if(!wantRecv && slot.recv != nullptr) cancel(slot.recv);
+
+	if(wantAccept && slot.accept == nullptr) arm(slot, Operation::kAccept, 0);
+	else if(!wantAccept && slot.accept != nullptr) cancel(slot.accept);
+
+	if(pollMask != slot.pollMask)
+	{
+		if(slot.poll != nullptr) cancel(slot.poll);
+		slot.pollMask = pollMask;
+		if(pollMask != 0) arm(slot, Operation::kPoll, pollMask);
+	}
+}
+
+void IoUringPoller::removeChannel(SP_Channel &channel)
+{
+	size_t fd = static_cast<size_t>(channel->getFd());
+	if(unlikely(fd >= slots_.size() || slots_[fd].channel != channel))
+	{
+		fprintf(stderr, "channel no found\n");
+		return ;
+	}
+
+	/* 在途请求的Operation持有Channel，fd在最后一个完成事件后才关闭 */
+	Slot &slot = slots_[fd];
+	if(slot.poll != nullptr) cancel(slot.poll);
+	if(slot.recv != nullptr) cancel(slot.recv);
+	if(slot.accept != nullptr) cancel(slot.accept);
+	if(slot.send != nullptr) cancel(slot.send);
+	slot.pollMask = 0;
+	slot.channel.reset();
+
+	/* 本轮尚未分发的事件不再处理 */
+	channel->set_revents(0);
+}
+
+bool IoUringPoller::submitSend(SP_Channel &channel, const struct iovec *iov, int iovcnt,
+                               int flags, std::shared_ptr<void> guard)
+{
+	assert(iovcnt > 0 && iovcnt <= OutputQueue::kMaxIovecs);
+
+	Slot &slot = slotOf(channel->getFd());
+	assert(slot.channel == channel);
+	assert(slot.send == nullptr);
+
+	struct io_uring_sqe *sqe = ring_->getSqe();
+	if(unlikely(sqe == nullptr)) return false;
+
+	Operation *op = newOperation(Operation::kSend, channel);
+	op->guard = std::move(guard);
+	memcpy(op->iov, iov, iovcnt * sizeof(struct iovec));
+	memset(&op->msg, 0, sizeof(op->msg));
+	op->msg.msg_iov = op->iov;
+	op->msg.msg_iovlen = iovcnt;
+
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = channel->getFd();
+	sqe->addr = reinterpret_cast<uint64_t>(&op->msg);
+	sqe->len = 1;
+	sqe->msg_flags = static_cast<uint32_t>(flags | MSG_NOSIGNAL);
+	sqe->user_data = reinterpret_cast<uint64_t>(op);
+
+	slot.send = op;
+	return true;
+}
+
+void IoUringPoller::arm(Slot &slot, Operation::Type type, unsigned pollMask)
+{
+	Operation *op = newOperation(type, slot.channel);
+	switch(type)
+	{
+	case Operation::kPoll: slot.poll = op; break;
+	case Operation::kRecv: slot.recv = op; break;
+	case Operation::kAccept: slot.accept = op; break;
+	default: assert(false);
+	}
+
+	struct io_uring_sqe *sqe = ring_->getSqe();
+	if(unlikely(sqe == nullptr))
+	{
+		/* 内核暂不接收，下一轮再提交 */
+		op->deferred = true;
+		deferred_.push_back({ op, pollMask, false });
+		return ;
+	}
+	prepareArm(sqe, op, pollMask);
+}
+
+void IoUringPoller::prepareArm(struct io_uring_sqe *sqe, Operation *op, unsigned pollMask)
+{
+	sqe->fd = op->channel->getFd();
+	sqe->user_data = reinterpret_cast<uint64_t>(op);
+
+	switch(op->type)
+	{
+	case Operation::kPoll:
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->len = IORING_POLL_ADD_MULTI;
+		sqe->poll32_events = pollMask;
+		break;
+
+	case Operation::kRecv:
+		sqe->opcode = IORING_OP_RECV;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = kBufferGroup;
+		break;
+
+	case Operation::kAccept:
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+		break;
+
+	default:
+		assert(false);
+	}
+}
+
+/* 取消后Operation仍要等到最后一个完成事件才能复用 */
+void IoUringPoller::cancel(Operation *&op)
+{
+	op->canceled = true;
+
+	/* 注册尚未提交，由flushDeferred直接回收 */
+	if(!op->deferred)
+	{
+		struct io_uring_sqe *sqe = ring_->getSqe();
+		if(likely(sqe != nullptr))
+		{
+			prepareCancel(sqe, op);
+		}
+		else
+		{
+			/* 不能丢弃：multishot请求会一直持有Channel */
+			op->deferred = true;
+			deferred_.push_back({ op, 0, true });
+		}
+	}
+	op = nullptr;
+}
+
+void IoUringPoller::prepareCancel(struct io_uring_sqe *sqe, Operation *op)
+{
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->addr = reinterpret_cast<uint64_t>(op);
+	sqe->user_data = 0;
+}
+
+/* 按推迟的顺序提交，SQ再次满时剩余项留到下一轮 */
+void IoUringPoller::flushDeferred()
+{
+	size_t done = 0;
+	for(; done < deferred_.size(); ++done)
+	{
+		Operation *op = deferred_[done].op;
+		if(!deferred_[done].cancel && op->canceled)
+		{
+			/* 注册未提交就被取消，内核中没有它 */
+			op->deferred = false;
+			releaseOperation(op);
+			continue;
+		}
+		if(deferred_[done].cancel && op->finished)
+		{
+			/* 请求已自行结束，无需再取消 */
+			op->deferred = false;
+			releaseOperation(op);
+			continue;
+		}
+
+		struct io_uring_sqe *sqe = ring_->getSqe();
+		if(unlikely(sqe == nullptr)) break;
+
+		op->deferred = false;
+		if(deferred_[done].cancel) prepareCancel(sqe, op);
+		else prepareArm(sqe, op, deferred_[done].pollMask);
+	}
+	deferred_.erase(deferred_.begin(), deferred_.begin() + done);
+}
+
+IoUringPoller::Operation *IoUringPoller::newOperation(Operation::Type type,
+                                                      const SP_Channel &channel)
+{
+	Operation *op;
+	if(freeOps_.empty())
+	{
+		allOps_.emplace_back(new Operation);
+		op = allOps_.back().get();
+	}
+	else
+	{
+		op = freeOps_.back();
+		freeOps_.pop_back();
+	}
+
+	op->type = type;
+	op->canceled = false;
+	op->deferred = false;
+	op->finished = false;
+	op->channel = channel;
+	return op;
+}
+
+void IoUringPoller::releaseOperation(Operation *op)
+{
+	/* 释放guard可能析构HttpHandler，先移出 */
+	SP_Channel channel(std::move(op->channel));
+	std::shared_ptr<void> guard(std::move(op->guard));
+	/* 推迟的取消仍指向它，提交前不能复用 */
+	if(unlikely(op->deferred))
+	{
+		op->finished = true;
+		return ;
+	}
+	freeOps_.push_back(op);
+}
+
+void IoUringPoller::recycleBuffer(unsigned bid)
+{
+	/* 旧版uapi头文件的bufs[]在C++中偏移为8，按环首地址直接计算 */
+	struct io_uring_buf *buf = reinterpret_cast<struct io_uring_buf *>(bufRing_) +
+	                           (bufTail_ & (kBufferCount - 1));
+	buf->addr = reinterpret_cast<uint64_t>(buffers_ + bid * kBufferSize);
+	buf->len = kBufferSize;
+	buf->bid = static_cast<uint16_t>(bid);
+	++bufTail_;
+	__atomic_store_n(&bufRing_->tail, static_cast<uint16_t>(bufTail_), __ATOMIC_RELEASE);
+}
+
+} //namespace webserver
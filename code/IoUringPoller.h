@@ -0,0 +1,127 @@
+#ifndef code_IoUringPoller_h
+#define code_IoUringPoller_h
+
+#include <vector>
+#include <memory>
+
+#include <sys/socket.h>
+
+#include "Poller.h"
+#include "IoUring.h"
+#include "OutputQueue.h"
+
+namespace webserver
+{
+
+/*
+ * io_uring backend
+ * - plain channels: multishot poll, same ET semantic as Epoll
+ * - channels with a RecvCallback: multishot recv into a provided
+ *   buffer ring, data handed over while reaping, buffer recycled at once
+ * - channels with an AcceptCallback: multishot accept
+ * - submitSend: sendmsg queued as an SQE
+ * interest changes, cancellations and sends are only queued; they
+ * reach the kernel in the io_uring_enter() that waits for events,
+ * one syscall per loop iteration in the common case; when the SQ is
+ * full and the kernel refuses more, arms and cancels are deferred to
+ * the next iteration instead of being dropped
+ */
+// io_uring后端
+// 普通Channel使用multishot poll，与Epoll的边沿触发语义相同
+// 设置了RecvCallback的Channel使用multishot recv + provided buffer ring，收割时交付数据并立即归还缓冲区
+// 设置了AcceptCallback的Channel使用multishot accept
+// 关注事件的修改、取消与发送都只在用户态排队，在等待事件的io_uring_enter中一次提交
+// SQ已满且内核暂不接收时，注册与取消推迟到下一轮提交，不会丢弃
+class IoUringPoller : public Poller
+{
+public:
+	IoUringPoller();
+	~IoUringPoller() override;
+
+	/* 内核支持所需特性(6.1+)且未被禁止 */
+	static bool available();
+
+	void poll(int timeout, ChannelList *activeChannels) override;
+	void updateChannel(SP_Channel &channel) override;
+	void removeChannel(SP_Channel &channel) override;
+
+	bool completionIo() const override { return true; }
+	bool submitSend(SP_Channel &channel, const struct iovec *iov, int iovcnt,
+	                int flags, std::shared_ptr<void> guard) override;
+
+private:
+	/* 一个在途的请求，user_data即其地址 */
+	struct Operation
+	{
+		enum Type { kPoll, kRecv, kAccept, kSend };
+
+		Type type;
+		bool canceled;
+		bool deferred;		/* deferred_中有指向它的项 */
+		bool finished;		/* 推迟的取消提交前已收到最后一个完成事件 */
+		SP_Channel channel;				/* 最后一个完成事件前Channel(及fd)不会释放 */
+		std::shared_ptr<void> guard;	/* 发送完成前保持数据有效 */
+		struct msghdr msg;
+		struct iovec iov[OutputQueue::kMaxIovecs];
+	};
+
+	/* SQ已满时推迟到下一轮提交的注册或取消 */
+	struct Deferred
+	{
+		Operation *op;
+		unsigned pollMask;
+		bool cancel;
+	};
+
+	/* 以fd为下标 */
+	struct Slot
+	{
+		SP_Channel channel;
+		Operation *poll;
+		unsigned pollMask;
+		Operation *recv;
+		Operation *accept;
+		Operation *send;
+		uint64_t activeStamp;	/* 本轮已加入activeChannels */
+	};
+
+	static const unsigned kRingEntries = 1024;
+	static const unsigned kBufferGroup = 0;
+	static const unsigned kBufferCount = 128;
+	static const size_t kBufferSize = 16 << 10;
+
+	Slot &slotOf(int fd);
+	void arm(Slot &slot, Operation::Type type, unsigned pollMask);
+	void prepareArm(struct io_uring_sqe *sqe, Operation *op, unsigned pollMask);
+	void cancel(Operation *&op);
+	void prepareCancel(struct io_uring_sqe *sqe, Operation *op);
+	void flushDeferred();
+	void handleCompletion(Operation *op, int res, unsigned flags, ChannelList *activeChannels);
+	void markActive(Operation *op, int revents, ChannelList *activeChannels);
+
+	Operation *newOperation(Operation::Type type, const SP_Channel &channel);
+	void releaseOperation(Operation *op);
+
+	void recycleBuffer(unsigned bid);
+
+private:
+	std::unique_ptr<IoUring> ring_;
+	std::vector<Slot> slots_;
+	uint64_t iteration_;
+
+	/* provided buffer ring */
+	struct io_uring_buf_ring *bufRing_;
+	size_t bufRingSize_;
+	char *buffers_;
+	unsigned bufTail_;
+
+	/* 请求对象复用，allOps_持有全部 */
+	std::vector<std::unique_ptr<Operation>> allOps_;
+	std::vector<Operation *> freeOps_;
+
+	std::vector<Deferred> deferred_;
+};
+
+} //namespace webserver
+
+#endif
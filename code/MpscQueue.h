@@ -0,0 +1,91 @@
+#ifndef code_MpscQueue_h
+#define code_MpscQueue_h
+
+#include <atomic>
+
+#include "noncopyable.h"
+
+namespace webserver
+{
+
+/* 嵌入到元素中的链接，元素由使用者分配与释放 */
+struct MpscNode
+{
+	std::atomic<MpscNode *> mpscNext;
+
+	MpscNode() : mpscNext(nullptr) {}
+};
+
+/*
+ * intrusive multi-producer single-consumer queue (Vyukov)
+ *   producers: push() is one atomic exchange plus one store, no lock
+ *   consumer:  pop() only touches the tail, owned by a single thread
+ * a producer preempted between the exchange and the store makes its
+ * node (and the ones behind it) invisible to pop() for a moment;
+ * callers that need them must be notified by that producer afterwards
+ */
+// 侵入式多生产者单消费者队列
+// 生产者：一次原子交换加一次写，不加锁，可在任意线程调用
+// 消费者：只有一个线程调用pop/empty
+// 生产者在交换与链接之间被抢占时，其节点暂时不可见，
+// 需由该生产者之后的通知(如唤醒事件循环)保证被取走
+class MpscQueue : noncopyable
+{
+public:
+	MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+	void push(MpscNode *node)
+	{
+		node->mpscNext.store(nullptr, std::memory_order_relaxed);
+		MpscNode *prev = head_.exchange(node, std::memory_order_acq_rel);
+		prev->mpscNext.store(node, std::memory_order_release);
+	}
+
+	/* 按入队顺序取出一个节点，队列为空(或队首尚未链接完)时返回nullptr */
+	MpscNode *pop()
+	{
+		MpscNode *tail = tail_;
+		MpscNode *next = tail->mpscNext.load(std::memory_order_acquire);
+		if(tail == &stub_)
+		{
+			if(next == nullptr) return nullptr;
+			tail_ = next;
+			tail = next;
+			next = next->mpscNext.load(std::memory_order_acquire);
+		}
+
+		if(next != nullptr)
+		{
+			tail_ = next;
+			return tail;
+		}
+
+		/* tail之后有生产者正在链接 */
+		if(tail != head_.load(std::memory_order_acquire)) return nullptr;
+
+		/* tail是最后一个节点，放回stub后才能取走它 */
+		push(&stub_);
+		next = tail->mpscNext.load(std::memory_order_acquire);
+		if(next != nullptr)
+		{
+			tail_ = next;
+			return tail;
+		}
+		return nullptr;
+	}
+
+	/* 仅消费者调用 */
+	bool empty() const
+	{
+		return tail_ == &stub_ && stub_.mpscNext.load(std::memory_order_acquire) == nullptr;
+	}
+
+private:
+	MpscNode stub_;
+	std::atomic<MpscNode *> head_;	/* 生产者入队的位置 */
+	MpscNode *tail_;				/* 消费者出队的位置 */
+};
+
+} //namespace webserver
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef code_NodePool_h
+#define code_NodePool_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+#include "noncopyable.h"
+
+namespace webserver
+{
+
+/*
+ * fixed-size lock-free pool of raw memory for T
+ * free slots are kept in a bounded MPMC ring (Vyukov): any thread may
+ * allocate, any thread may deallocate; when the pool is exhausted
+ * allocate() falls back to operator new and deallocate() recognises
+ * such blocks by address
+ */
+// 固定容量的无锁内存池
+// 空闲块保存在有界MPMC环形队列中，任意线程都可以申请与归还
+// 池耗尽时退回operator new，归还时按地址区分
+// 只提供内存，构造与析构由使用者完成
+template <typename T>
+class NodePool : noncopyable
+{
+public:
+	/* capacity须为2的幂 */
+	explicit NodePool(size_t capacity)
+		: capacity_(capacity),
+		  mask_(capacity - 1),
+		  blocks_(new Block[capacity]),
+		  cells_(new Cell[capacity]),
+		  enqueuePos_(0),
+		  dequeuePos_(0)
+	{
+		for(size_t i=0; i<capacity_; ++i)
+		{
+			cells_[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		for(size_t i=0; i<capacity_; ++i)
+		{
+			push(&blocks_[i]);
+		}
+	}
+
+	void *allocate()
+	{
+		void *block = pop();
+		return block != nullptr ? block : ::operator new(sizeof(T));
+	}
+
+	void deallocate(void *block)
+	{
+		if(owns(block))
+		{
+			push(block);
+		}
+		else
+		{
+			::operator delete(block);
+		}
+	}
+
+private:
+	struct Block
+	{
+		alignas(T) unsigned char data[sizeof(T)];
+	};
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		void *block;
+	};
+
+	bool owns(void *block) const
+	{
+		Block *p = static_cast<Block *>(block);
+		return p >= blocks_.get() && p < blocks_.get() + capacity_;
+	}
+
+	/* 池中的块不会超过容量，不会失败 */
+	void push(void *block)
+	{
+		Cell *cell;
+		size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+		while(true)
+		{
+			cell = &cells_[pos & mask_];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if(diff == 0)
+			{
+				if(enqueuePos_.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+					break;
+			}
+			else
+			{
+				pos = enqueuePos_.load(std::memory_order_relaxed);
+			}
+		}
+		cell->block = block;
+		cell->sequence.store(pos+1, std::memory_order_release);
+	}
+
+	/* 为空时返回nullptr */
+	void *pop()
+	{
+		Cell *cell;
+		size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+		while(true)
+		{
+			cell = &cells_[pos & mask_];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos+1);
+			if(diff == 0)
+			{
+				if(dequeuePos_.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+					break;
+			}
+			else if(diff < 0)
+			{
+				return nullptr;
+			}
+			else
+			{
+				pos = dequeuePos_.load(std::memory_order_relaxed);
+			}
+		}
+		void *block = cell->block;
+		cell->sequence.store(pos+mask_+1, std::memory_order_release);
+		return block;
+	}
+
+private:
+	const size_t capacity_;
+	const size_t mask_;
+	std::unique_ptr<Block[]> blocks_;
+	std::unique_ptr<Cell[]> cells_;
+
+	/* 分属生产者与消费者，避免伪共享 */
+	alignas(64) std::atomic<size_t> enqueuePos_;
+	alignas(64) std::atomic<size_t> dequeuePos_;
+};
+
+} //namespace webserver
+
+#endif
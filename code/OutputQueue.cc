@@ -0,0 +1,182 @@
+#include "OutputQueue.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+#include "macros.h"
+
+namespace webserver
+{
+
+FileHandle::~FileHandle()
+{
+	::close(fd_);
+}
+
+void OutputQueue::append(const char *data, size_t len)
+{
+	if(len == 0) return ;
+
+	/* 小段数据追加到尾部的独占段中 */
+	if(queue_.size() > frozen_ && len < kCoalesceSize)
+	{
+		Segment &last = queue_.back();
+		if(!last.shared && !last.isFile() && last.len < kCoalesceSize)
+		{
+			last.owned.append(data, len);
+			last.len += len;
+			bytes_ += len;
+			return ;
+		}
+	}
+
+	append(std::string(data, len));
+}
+
+void OutputQueue::append(std::string &&data)
+{
+	if(data.empty()) return ;
+
+	Segment seg;
+	seg.len = data.size();
+	seg.offset = 0;
+	seg.owned = std::move(data);
+
+	bytes_ += seg.len;
+	queue_.push_back(std::move(seg));
+}
+
+void OutputQueue::append(const SP_ConstString &data, size_t offset, size_t len)
+{
+	assert(offset + len <= data->size());
+	if(len == 0) return ;
+
+	Segment seg;
+	seg.shared = data;
+	seg.offset = offset;
+	seg.len = len;
+
+	bytes_ += len;
+	queue_.push_back(std::move(seg));
+}
+
+void OutputQueue::appendFile(const SP_File &file, off_t offset, size_t len)
+{
+	if(len == 0) return ;
+
+	Segment seg;
+	seg.file = file;
+	seg.offset = static_cast<size_t>(offset);
+	seg.len = len;
+
+	bytes_ += len;
+	queue_.push_back(std::move(seg));
+}
+
+ssize_t OutputQueue::writeFd(int fd, int *savedErrno)
+{
+	assert(!queue_.empty());
+	const ssize_t n = queue_.front().isFile() ? sendFile(fd, savedErrno)
+	                                          : sendIovecs(fd, savedErrno);
+	if(n > 0)
+	{
+		retrieve(n);
+	}
+
+	return n;
+}
+
+/* 文件内容由内核直接拷贝到socket */
+ssize_t OutputQueue::sendFile(int fd, int *savedErrno)
+{
+	Segment &front = queue_.front();
+	off_t offset = static_cast<off_t>(front.offset);
+	size_t count = std::min(front.len, kMaxSendfileSize);
+
+	const ssize_t n = ::sendfile(fd, front.file->fd(), &offset, count);
+	if(unlikely(n < 0))
+	{
+		*savedErrno = errno;
+	}
+	else if(unlikely(n == 0))
+	{
+		/* 文件被截断，无法再发送剩余部分 */
+		*savedErrno = EIO;
+		return -1;
+	}
+
+	return n;
+}
+
+/* 连续的内存段组成iovec一次发出 */
+/* 后面紧跟文件段时带上MSG_MORE，让header与文件内容尽量合并成满包 */
+ssize_t OutputQueue::sendIovecs(int fd, int *savedErrno)
+{
+	struct iovec vec[kMaxIovecs];
+	bool more = false;
+	int iovcnt = fillIovecs(vec, &more);
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = vec;
+	msg.msg_iovlen = iovcnt;
+
+	const ssize_t n = ::sendmsg(fd, &msg, more ? MSG_MORE : 0);
+	if(unlikely(n < 0))
+	{
+		*savedErrno = errno;
+	}
+
+	return n;
+}
+
+int OutputQueue::fillIovecs(struct iovec *vec, bool *more) const
+{
+	int iovcnt = 0;
+	*more = false;
+
+	for(auto it = queue_.begin(); it != queue_.end(); ++it)
+	{
+		if(it->isFile())
+		{
+			*more = true;
+			break;
+		}
+		if(iovcnt == kMaxIovecs) break;
+
+		vec[iovcnt].iov_base = const_cast<char *>(it->data());
+		vec[iovcnt].iov_len = it->len;
+		++iovcnt;
+	}
+
+	return iovcnt;
+}
+
+void OutputQueue::retrieve(size_t len)
+{
+	assert(len <= bytes_);
+	assert(frozen_ == 0);
+	bytes_ -= len;
+
+	while(len > 0)
+	{
+		Segment &front = queue_.front();
+		if(len < front.len)
+		{
+			/* 部分发送，仅移动偏移 */
+			front.offset += len;
+			front.len -= len;
+			return ;
+		}
+		len -= front.len;
+		queue_.pop_front();
+	}
+}
+
+} //namespace webserver
@@ -0,0 +1,117 @@
+#ifndef code_OutputQueue_h
+#define code_OutputQueue_h
+
+#include <cassert>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "noncopyable.h"
+
+namespace webserver
+{
+
+/* 文件描述符持有者，最后一个引用释放时关闭文件 */
+class FileHandle : noncopyable
+{
+public:
+	explicit FileHandle(int fd) : fd_(fd) {}
+	~FileHandle();
+
+	int fd() const { return fd_; }
+
+private:
+	const int fd_;
+};
+
+/*
+ * scatter/gather output queue
+ * +-----------+-----------+-----------+
+ * |  segment  |  segment  |  segment  |  ---> sendmsg(fd, iov, n) / sendfile
+ * +-----------+-----------+-----------+
+ * each segment is an owned string, a slice of a shared immutable string
+ * or a range of an open file
+ */
+// 输出队列：每段数据独立保存，不做拼接
+// 发送时连续的内存段组成iovec，一次sendmsg发出
+// 已发送部分只移动段内偏移，不拷贝剩余数据
+// 文件段用sendfile发送，内容不经过用户空间
+class OutputQueue : noncopyable
+{
+public:
+	typedef std::shared_ptr<const std::string> SP_ConstString;
+	typedef std::shared_ptr<FileHandle> SP_File;
+
+	// 小于该长度的拷贝数据，合并到上一段尾部，避免iovec过多
+	static const size_t kCoalesceSize = 1024;
+	// 一次writev最多携带的段数
+	static const int kMaxIovecs = 64;
+	// 一次sendfile最多发送的字节数
+	static const size_t kMaxSendfileSize = 1 << 20;
+
+	OutputQueue() : bytes_(0), frozen_(0) {}
+
+	/* 拷贝一段数据 */
+	void append(const char *data, size_t len);
+	/* 接管string，不拷贝 */
+	void append(std::string &&data);
+	/* 引用共享只读数据的一部分，不拷贝 */
+	void append(const SP_ConstString &data, size_t offset, size_t len);
+	/* 引用文件的[offset, offset+len)，发送时sendfile */
+	void appendFile(const SP_File &file, off_t offset, size_t len);
+
+	bool empty() const { return bytes_ == 0; }
+	size_t readableBytes() const { return bytes_; }
+	size_t segments() const { return queue_.size(); }
+
+	void clear()
+	{
+		assert(frozen_ == 0);
+		queue_.clear();
+		bytes_ = 0;
+	}
+
+	/* sendmsg或sendfile一次，返回写出字节数，出错时返回-1并保存errno */
+	/* 进度保存在各段的偏移中，EAGAIN后下次继续 */
+	ssize_t writeFd(int fd, int *savedErrno);
+
+	/* 异步发送(io_uring)：由调用者提交iovec，完成后retrieve */
+	bool frontIsFile() const { return queue_.front().isFile(); }
+	/* 队首连续的内存段填入vec，后面紧跟文件段时more为true，返回段数 */
+	int fillIovecs(struct iovec *vec, bool *more) const;
+	/* 取走已发送的len字节 */
+	void retrieve(size_t len);
+	/* 前n段正在被内核读取，不能再向其中合并数据 */
+	void freeze(int n) { frozen_ = static_cast<size_t>(n); }
+	void unfreeze() { frozen_ = 0; }
+
+private:
+	struct Segment
+	{
+		std::string owned;
+		SP_ConstString shared;
+		SP_File file;
+		size_t offset;	/* 文件段时为文件偏移 */
+		size_t len;
+
+		bool isFile() const { return file != nullptr; }
+
+		const char *data() const
+		{ return (shared ? shared->data() : owned.data()) + offset; }
+	};
+
+	ssize_t sendFile(int fd, int *savedErrno);
+	ssize_t sendIovecs(int fd, int *savedErrno);
+
+private:
+	std::deque<Segment> queue_;
+	size_t bytes_;
+	size_t frozen_;
+};
+
+} //namespace webserver
+
+#endif
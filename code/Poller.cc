@@ -0,0 +1,69 @@
+#include "Poller.h"
+
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+
+#include "Epoll.h"
+#include "IoUringPoller.h"
+
+namespace webserver
+{
+
+namespace
+{
+
+std::atomic<int> g_backend(Poller::kEpoll);
+
+}
+
+Poller *Poller::newDefaultPoller()
+{
+	if(defaultBackend() == kIoUring)
+	{
+		if(IoUringPoller::available())
+		{
+			return new IoUringPoller();
+		}
+
+		/* 内核不支持或被seccomp禁止 */
+		static std::atomic<bool> warned(false);
+		if(!warned.exchange(true))
+		{
+			fprintf(stderr, "io_uring unavailable, falling back to epoll\n");
+		}
+	}
+	return new Epoll();
+}
+
+void Poller::setDefaultBackend(Backend backend)
+{
+	g_backend.store(backend);
+}
+
+Poller::Backend Poller::defaultBackend()
+{
+	return static_cast<Backend>(g_backend.load());
+}
+
+const char *Poller::backendName(Backend backend)
+{
+	return backend == kIoUring ? "io_uring" : "epoll";
+}
+
+bool Poller::parseBackend(const char *name, Backend *backend)
+{
+	if(strcmp(name, "epoll") == 0)
+	{
+		*backend = kEpoll;
+		return true;
+	}
+	if(strcmp(name, "io_uring") == 0 || strcmp(name, "uring") == 0)
+	{
+		*backend = kIoUring;
+		return true;
+	}
+	return false;
+}
+
+} //namespace webserver
@@ -0,0 +1,68 @@
+#ifndef code_Poller_h
+#define code_Poller_h
+
+#include <vector>
+#include <memory>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "noncopyable.h"
+
+namespace webserver
+{
+
+class Channel;
+
+/*
+ * io-multiplex interface
+ * obligation: add/modify/delete concerned events and
+ *             return activate channels
+ * owner: EventLoop, guaranteed by unique_ptr
+ * backends: Epoll (readiness), IoUringPoller (completion)
+ */
+// IO 多路复用接口
+// 职责： 添加/修改/删除 关注的事件 并且 返回激活的通道
+// 拥有者： EventLoop ， 由唯一指针保障
+// 后端在启动时选定，所有事件循环使用同一种后端
+class Poller : noncopyable
+{
+public:
+	typedef std::shared_ptr<Channel> SP_Channel;
+	typedef std::vector<Channel *> ChannelList;
+
+	enum Backend { kEpoll, kIoUring };
+
+	virtual ~Poller() = default;
+
+	// poll 函数用于进行事件轮询，激活的通道写入调用者复用的activeChannels。
+	// 分发路径上只有裸指针，Channel的生命周期由EventLoop延迟释放保证。
+	virtual void poll(int timeout, ChannelList *activeChannels) = 0;
+
+	// 更新和删除通道。
+	virtual void updateChannel(SP_Channel &channel) = 0;
+	virtual void removeChannel(SP_Channel &channel) = 0;
+
+	/* 完成式I/O：recv/accept由Poller代为执行，结果交给Channel的RecvCallback/AcceptCallback */
+	virtual bool completionIo() const { return false; }
+
+	/* 异步发送iov，完成后Channel的写回调被调用，结果由Channel::takeSendResult取得 */
+	/* guard在发送完成前保持iov指向的内存有效 */
+	virtual bool submitSend(SP_Channel &channel, const struct iovec *iov, int iovcnt,
+	                        int flags, std::shared_ptr<void> guard)
+	{ return false; }
+
+	/* 按启动时选定的后端创建，io_uring不可用时退回epoll */
+	static Poller *newDefaultPoller();
+
+	/* 在创建任何EventLoop之前设置 */
+	static void setDefaultBackend(Backend backend);
+	static Backend defaultBackend();
+	static const char *backendName(Backend backend);
+	/* "epoll" / "io_uring"，无法识别时返回false */
+	static bool parseBackend(const char *name, Backend *backend);
+};
+
+} //namespace webserver
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef code_SmallFunction_h
+#define code_SmallFunction_h
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace webserver
+{
+
+/*
+ * move-only replacement of std::function
+ *   callables up to kInlineSize bytes (std::bind of a member function
+ *   with a couple of pointers / shared_ptrs) live in the object itself,
+ *   larger ones fall back to the heap
+ *   one static table of function pointers per callable type, no RTTI
+ */
+// 只能移动的std::function替代品
+// 不超过kInlineSize字节、移动不抛异常的可调用对象直接存放在对象内部，不分配内存
+// 如std::bind(&EventLoop::addHttpConnection, loop, handler)只有40字节
+// 更大的对象退回堆上
+// 每种可调用类型一张静态函数表，不使用RTTI
+template <typename Signature, size_t kInlineSize = 56>
+class SmallFunction;
+
+template <typename R, typename... Args, size_t kInlineSize>
+class SmallFunction<R (Args...), kInlineSize>
+{
+public:
+	SmallFunction() noexcept : ops_(nullptr) {}
+	SmallFunction(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+	template <typename F,
+	          typename = typename std::enable_if<
+	              !std::is_same<typename std::decay<F>::type, SmallFunction>::value>::type>
+	SmallFunction(F &&f)
+		: ops_(nullptr)
+	{
+		typedef typename std::decay<F>::type Callable;
+		if(isNull(f)) return ;
+
+		if constexpr(fitsInline<Callable>())
+		{
+			::new (static_cast<void *>(storage_)) Callable(std::forward<F>(f));
+			ops_ = &InlineOps<Callable>::kOps;
+		}
+		else
+		{
+			*reinterpret_cast<Callable **>(storage_) = new Callable(std::forward<F>(f));
+			ops_ = &HeapOps<Callable>::kOps;
+		}
+	}
+
+	SmallFunction(SmallFunction &&other) noexcept
+		: ops_(other.ops_)
+	{
+		if(ops_ != nullptr)
+		{
+			ops_->move(storage_, other.storage_);
+			other.ops_ = nullptr;
+		}
+	}
+
+	SmallFunction &operator=(SmallFunction &&other) noexcept
+	{
+		if(this != &other)
+		{
+			reset();
+			if(other.ops_ != nullptr)
+			{
+				other.ops_->move(storage_, other.storage_);
+				ops_ = other.ops_;
+				other.ops_ = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	SmallFunction &operator=(std::nullptr_t) noexcept
+	{
+		reset();
+		return *this;
+	}
+
+	SmallFunction(const SmallFunction &) = delete;
+	SmallFunction &operator=(const SmallFunction &) = delete;
+
+	~SmallFunction() { reset(); }
+
+	explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+	/* 与std::function相同，调用空对象是未定义行为(此处直接崩溃) */
+	R operator()(Args... args) const
+	{
+		return ops_->invoke(storage_, std::forward<Args>(args)...);
+	}
+
+private:
+	struct Ops
+	{
+		R (*invoke)(void *storage, Args &&...args);
+		/* 移动到未初始化的dst，并析构src */
+		void (*move)(void *dst, void *src);
+		void (*destroy)(void *storage);
+	};
+
+	template <typename Callable>
+	static constexpr bool fitsInline()
+	{
+		return sizeof(Callable) <= kInlineSize &&
+		       alignof(Callable) <= alignof(std::max_align_t) &&
+		       std::is_nothrow_move_constructible<Callable>::value;
+	}
+
+	/* 空的函数指针、成员函数指针视为空 */
+	template <typename T>
+	static bool isNull(T *p) { return p == nullptr; }
+	template <typename T, typename C>
+	static bool isNull(T C::*p) { return p == nullptr; }
+	template <typename T>
+	static bool isNull(const T &) { return false; }
+
+	template <typename Callable>
+	struct InlineOps
+	{
+		static R invoke(void *storage, Args &&...args)
+		{ return (*static_cast<Callable *>(storage))(std::forward<Args>(args)...); }
+
+		static void move(void *dst, void *src)
+		{
+			Callable *from = static_cast<Callable *>(src);
+			::new (dst) Callable(std::move(*from));
+			from->~Callable();
+		}
+
+		static void destroy(void *storage)
+		{ static_cast<Callable *>(storage)->~Callable(); }
+
+		static const Ops kOps;
+	};
+
+	template <typename Callable>
+	struct HeapOps
+	{
+		static Callable *&ptr(void *storage)
+		{ return *static_cast<Callable **>(storage); }
+
+		static R invoke(void *storage, Args &&...args)
+		{ return (*ptr(storage))(std::forward<Args>(args)...); }
+
+		static void move(void *dst, void *src)
+		{ *static_cast<Callable **>(dst) = ptr(src); }
+
+		static void destroy(void *storage)
+		{ delete ptr(storage); }
+
+		static const Ops kOps;
+	};
+
+	void reset() noexcept
+	{
+		if(ops_ != nullptr)
+		{
+			ops_->destroy(storage_);
+			ops_ = nullptr;
+		}
+	}
+
+private:
+	alignas(std::max_align_t) mutable unsigned char storage_[kInlineSize];
+	const Ops *ops_;
+};
+
+template <typename R, typename... Args, size_t kInlineSize>
+template <typename Callable>
+const typename SmallFunction<R (Args...), kInlineSize>::Ops
+SmallFunction<R (Args...), kInlineSize>::InlineOps<Callable>::kOps = {
+	&InlineOps<Callable>::invoke, &InlineOps<Callable>::move, &InlineOps<Callable>::destroy
+};
+
+template <typename R, typename... Args, size_t kInlineSize>
+template <typename Callable>
+const typename SmallFunction<R (Args...), kInlineSize>::Ops
+SmallFunction<R (Args...), kInlineSize>::HeapOps<Callable>::kOps = {
+	&HeapOps<Callable>::invoke, &HeapOps<Callable>::move, &HeapOps<Callable>::destroy
+};
+
+} //namespace webserver
+
+#endif
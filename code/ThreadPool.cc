@@ -65,7 +65,7 @@ void ThreadPool::stop()
 }
 
 /* producer */
-int ThreadPool::addTask(const ThreadPool::Task &task)
+int ThreadPool::addTask(ThreadPool::Task &&task)
 {
 	// 判断任务队列是否已满，如果已满，表示无法再添加任务，直接返回 -1。
 	if(static_cast<int>(queue_.size()) >= maxQueueSize_)
@@ -119,7 +119,7 @@ ThreadPool::Task ThreadPool::take()
 	Task task;
 	if(!queue_.empty())
 	{
-		task = queue_.front();
+		task = std::move(queue_.front());
 		queue_.pop_front();
 	}
 	
@@ -8,6 +8,7 @@
 #include <functional>
 #include <memory>
 
+#include "SmallFunction.h"
 #include "Thread.h"
 #include "noncopyable.h"
 
@@ -18,7 +19,7 @@ class ThreadPool : noncopyable
 {
 public:
 	// 是一个任务的类型，是一个无参数无返回值的函数类型
-	typedef std::function<void ()> Task;
+	typedef SmallFunction<void ()> Task;
 	// 构造函数 ThreadPool(int threadNum, int maxQueueSize) 用于创建线程池对象，参数包括线程数量和任务队列的最大大小。
 	ThreadPool(int threadNum, int maxQueueSize);
 	~ThreadPool();
@@ -28,7 +29,7 @@ public:
 	void stop();
 	
 	// 函数用于向线程池中添加任务。
-	int addTask(const Task &task);
+	int addTask(Task &&task);
 	
 private:
 	// 每个线程执行的函数，它会不断地从任务队列中取出任务并执行。
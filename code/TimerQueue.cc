@@ -0,0 +1,299 @@
+#include "TimerQueue.h"
+
+#include <cassert>
+#include <cstdio>
+#include <algorithm>
+
+#include <sys/timerfd.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "macros.h"
+#include "Channel.h"
+#include "EventLoop.h"
+
+namespace webserver
+{
+
+// 截止时间在此之内时直接作为poll超时，省去timerfd_settime。
+static const int kNearDeadlineMs = 20;
+
+// 墓碑不少于此数且超过堆的一半时重建堆。
+static const size_t kCompactThreshold = 64;
+
+int createTimerFd()
+{
+	int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if(timerfd < 0)
+	{
+		fprintf(stderr, "failed in timerfd_create\n");
+		abort();
+	}
+	return timerfd;
+}
+
+TimerQueue::TimerQueue(EventLoop *loop)
+	: loop_(loop),
+	  timerFd_(createTimerFd()),
+	  timerChannel_(new Channel(timerFd_, loop_)),	/* Channel负责关闭timerFd_ */
+	  armedAt_(0),
+	  timerfdArms_(0),
+	  live_(0),
+	  tombstones_(0)
+{
+	timerChannel_->setReadCallback(std::bind(&TimerQueue::handleRead, this));
+	timerChannel_->enableReading();
+}
+
+TimerQueue::~TimerQueue()
+{
+}
+
+Timestamp TimerQueue::now()
+{
+	struct timespec ts;
+	::clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<Timestamp>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when, Timestamp interval)
+{
+	assert(loop_->isInLoopThread());
+
+	uint32_t index = allocSlot();
+	Slot &slot = slots_[index];
+	slot.callback = std::move(cb);
+	slot.interval = interval;
+	slot.queued = true;
+
+	push(Entry{ when, index, slot.generation });
+	return (static_cast<TimerId>(index + 1) << 32) | slot.generation;
+}
+
+void TimerQueue::cancel(TimerId timerId)
+{
+	assert(loop_->isInLoopThread());
+
+	uint64_t index = (timerId >> 32) - 1;
+	uint32_t generation = static_cast<uint32_t>(timerId);
+	if(index >= slots_.size()) return ;
+
+	Slot &slot = slots_[index];
+	if(!slot.active || slot.generation != generation) return ;
+
+	/* 堆中的条目留作墓碑 */
+	if(slot.queued) ++tombstones_;
+	freeSlot(static_cast<uint32_t>(index));
+
+	if(tombstones_ >= kCompactThreshold && tombstones_ * 2 > heap_.size())
+	{
+		compact();
+	}
+}
+
+int TimerQueue::pollTimeout(Timestamp current, int maxTimeoutMs)
+{
+	dropStaleTop();
+	if(heap_.empty()) return maxTimeoutMs;
+
+	const Timestamp when = heap_[0].when;
+	const Timestamp delay = when - current;
+	if(delay <= 0) return 0;
+
+	/* 向上取整，避免提前醒来再空转一轮 */
+	if(delay <= kNearDeadlineMs * 1000)
+	{
+		return std::min(maxTimeoutMs, static_cast<int>((delay + 999) / 1000));
+	}
+
+	/* 已设定的截止时间更早时不必重设，提前醒来一次即可 */
+	if(armedAt_ == 0 || when < armedAt_)
+	{
+		armTimerfd(when);
+	}
+	return maxTimeoutMs;
+}
+
+/* 只处理进入时已在堆中的条目，回调中新加的到期定时器留到下一轮 */
+void TimerQueue::processExpired(Timestamp current)
+{
+	if(heap_.empty()) return ;
+
+	for(size_t budget = heap_.size(); budget > 0 && !heap_.empty(); --budget)
+	{
+		const Entry top = heap_[0];
+		if(!isLive(top))
+		{
+			popTop();
+			--tombstones_;
+			continue;
+		}
+		if(top.when > current) break;
+
+		popTop();
+		slots_[top.index].queued = false;
+
+		/* 回调可能增删定时器(slots_会扩容)，也可能取消自身，先把回调移出槽位 */
+		TimerCallback cb(std::move(slots_[top.index].callback));
+		const Timestamp interval = slots_[top.index].interval;
+		if(interval == 0)
+		{
+			freeSlot(top.index);
+			cb();
+			continue;
+		}
+
+		cb();
+
+		Slot &slot = slots_[top.index];
+		if(slot.active && slot.generation == top.generation)
+		{
+			/* 落后太多时不补触发 */
+			Timestamp next = top.when + interval;
+			if(next <= current) next = current + interval;
+
+			slot.callback = std::move(cb);
+			slot.queued = true;
+			push(Entry{ next, top.index, top.generation });
+		}
+	}
+}
+
+uint32_t TimerQueue::allocSlot()
+{
+	uint32_t index;
+	if(!freeSlots_.empty())
+	{
+		index = freeSlots_.back();
+		freeSlots_.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(slots_.size());
+		slots_.emplace_back();
+		slots_[index].generation = 0;
+	}
+	slots_[index].active = true;
+	++live_;
+	return index;
+}
+
+/* 回调随即析构，其中持有的对象不必等到条目出堆 */
+void TimerQueue::freeSlot(uint32_t index)
+{
+	Slot &slot = slots_[index];
+	slot.callback = nullptr;
+	slot.active = false;
+	slot.queued = false;
+	++slot.generation;
+	freeSlots_.push_back(index);
+	--live_;
+}
+
+/* 四叉堆：i的子节点为4i+1..4i+4，父节点为(i-1)/4 */
+/* 比二叉堆层数少一半，下沉时比较的四个子节点在同一缓存行 */
+void TimerQueue::push(const Entry &entry)
+{
+	heap_.push_back(entry);
+	siftUp(heap_.size() - 1);
+}
+
+void TimerQueue::popTop()
+{
+	assert(!heap_.empty());
+	heap_[0] = heap_.back();
+	heap_.pop_back();
+	if(!heap_.empty()) siftDown(0);
+}
+
+void TimerQueue::siftUp(size_t pos)
+{
+	const Entry entry = heap_[pos];
+	while(pos > 0)
+	{
+		size_t parent = (pos - 1) / 4;
+		if(heap_[parent].when <= entry.when) break;
+		heap_[pos] = heap_[parent];
+		pos = parent;
+	}
+	heap_[pos] = entry;
+}
+
+void TimerQueue::siftDown(size_t pos)
+{
+	const size_t size = heap_.size();
+	const Entry entry = heap_[pos];
+	while(true)
+	{
+		size_t first = pos * 4 + 1;
+		if(first >= size) break;
+
+		size_t last = std::min(first + 4, size);
+		size_t child = first;
+		for(size_t i=first+1; i<last; ++i)
+		{
+			if(heap_[i].when < heap_[child].when) child = i;
+		}
+		if(entry.when <= heap_[child].when) break;
+
+		heap_[pos] = heap_[child];
+		pos = child;
+	}
+	heap_[pos] = entry;
+}
+
+void TimerQueue::dropStaleTop()
+{
+	while(!heap_.empty() && !isLive(heap_[0]))
+	{
+		popTop();
+		--tombstones_;
+	}
+}
+
+void TimerQueue::compact()
+{
+	heap_.erase(std::remove_if(heap_.begin(), heap_.end(),
+	                           [this](const Entry &entry) { return !isLive(entry); }),
+	            heap_.end());
+	tombstones_ = 0;
+
+	if(heap_.size() < 2) return ;
+	for(size_t i=(heap_.size()-2)/4+1; i>0; --i)
+	{
+		siftDown(i - 1);
+	}
+}
+
+/* 绝对时间，与now()同为CLOCK_MONOTONIC */
+void TimerQueue::armTimerfd(Timestamp when)
+{
+	struct itimerspec newValue;
+	bzero(&newValue, sizeof(newValue));
+	newValue.it_value.tv_sec = static_cast<time_t>(when / 1000000);
+	newValue.it_value.tv_nsec = static_cast<long>(when % 1000000) * 1000;
+
+	int ret = ::timerfd_settime(timerFd_, TFD_TIMER_ABSTIME, &newValue, nullptr);
+	if(unlikely(ret < 0))
+	{
+		perror("timerfd_settime");
+		return ;
+	}
+	armedAt_ = when;
+	++timerfdArms_;
+}
+
+/* 到期的定时器由事件循环在本轮末尾统一处理 */
+void TimerQueue::handleRead()
+{
+	uint64_t num = 0;
+	ssize_t ret = ::read(timerFd_, &num, sizeof(num));
+	if(unlikely(ret != sizeof(num)))
+	{
+		perror("timerfd read error");
+	}
+	armedAt_ = 0;
+}
+
+} //namespace webserver
@@ -0,0 +1,120 @@
+#ifndef code_TimerQueue_h
+#define code_TimerQueue_h
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "SmallFunction.h"
+#include "noncopyable.h"
+
+namespace webserver
+{
+
+class Channel;
+class EventLoop;
+
+/* 单调时钟，微秒 */
+typedef int64_t Timestamp;
+/* 高32位为槽位下标+1，低32位为槽位的代数；0表示无效 */
+typedef uint64_t TimerId;
+
+/*
+ * per-loop timer queue
+ *   any number of timers share one timerfd; a deadline closer than
+ *   kNearDeadlineMs is left to the poll timeout instead
+ *   4-ary min-heap: O(log n) insert, cancel only marks a tombstone (O(1))
+ *   and the stale heap entry is dropped when it reaches the top
+ * only used in the loop thread
+ */
+// 每个事件循环一个定时器队列
+// 所有定时器共用一个timerfd；最近的截止时间足够近时直接作为poll超时，不调用timerfd_settime
+// 四叉最小堆：插入O(log n)；取消只作废槽位(墓碑)，堆中的旧条目到达堆顶时丢弃
+// 墓碑超过一半时整体重建堆，避免大量取消后堆无限增长
+// 只能在事件循环线程中使用
+class TimerQueue : noncopyable
+{
+public:
+	typedef SmallFunction<void ()> TimerCallback;
+
+	explicit TimerQueue(EventLoop *loop);
+	~TimerQueue();
+
+	/* 精确的单调时钟，用于计算新定时器的截止时间 */
+	static Timestamp now();
+
+	/* interval为0时只触发一次 */
+	TimerId addTimer(TimerCallback cb, Timestamp when, Timestamp interval);
+	/* 已触发、已取消的id直接忽略；可在定时器回调中取消自身 */
+	void cancel(TimerId timerId);
+
+	/* 以下两个函数使用事件循环缓存的粗粒度时钟，它不超过now()，定时器只会晚到不会早到 */
+	/* 下一次poll的超时(ms)，不超过maxTimeoutMs；远的截止时间交给timerfd */
+	int pollTimeout(Timestamp current, int maxTimeoutMs);
+	/* 执行所有到期的定时器，每轮poll之后调用 */
+	void processExpired(Timestamp current);
+
+	/* 有效定时器个数 */
+	size_t size() const { return live_; }
+	/* 堆中尚未清除的已取消条目 */
+	size_t tombstones() const { return tombstones_; }
+	/* timerfd_settime的调用次数 */
+	uint64_t timerfdArms() const { return timerfdArms_; }
+
+private:
+	struct Slot
+	{
+		TimerCallback callback;
+		Timestamp interval;
+		uint32_t generation;	/* 每次释放加一，使旧id与堆中旧条目失效 */
+		bool active;
+		bool queued;			/* 堆中有该槽位当前代的条目(回调执行期间为false) */
+	};
+
+	struct Entry
+	{
+		Timestamp when;
+		uint32_t index;
+		uint32_t generation;
+	};
+
+	bool isLive(const Entry &entry) const
+	{
+		const Slot &slot = slots_[entry.index];
+		return slot.active && slot.generation == entry.generation;
+	}
+
+	uint32_t allocSlot();
+	void freeSlot(uint32_t index);
+
+	void push(const Entry &entry);
+	void popTop();
+	void siftUp(size_t pos);
+	void siftDown(size_t pos);
+	/* 丢弃堆顶的墓碑 */
+	void dropStaleTop();
+	/* 墓碑过多时只保留有效条目重建堆 */
+	void compact();
+
+	void armTimerfd(Timestamp when);
+	void handleRead();
+
+private:
+	EventLoop *loop_;
+	const int timerFd_;
+	std::shared_ptr<Channel> timerChannel_;
+	/* timerfd当前设定的截止时间，0表示未设定 */
+	Timestamp armedAt_;
+	uint64_t timerfdArms_;
+
+	std::vector<Slot> slots_;
+	std::vector<uint32_t> freeSlots_;
+	std::vector<Entry> heap_;
+	size_t live_;
+	size_t tombstones_;
+};
+
+} //namespace webserver
+
+#endif
@@ -0,0 +1,127 @@
+#include "TimingWheel.h"
+
+#include <cassert>
+
+namespace webserver
+{
+
+TimingWheel::TimingWheel(Timestamp tick, size_t buckets, Timestamp now)
+	: tick_(tick),
+	  mask_(buckets - 1),
+	  buckets_(new TimingWheelNode[buckets]),
+	  currentTick_(now / tick),
+	  size_(0),
+	  rebuckets_(0)
+{
+	assert(tick_ > 0);
+	assert(buckets > 0 && (buckets & mask_) == 0);
+	for(size_t i=0; i<buckets; ++i)
+	{
+		buckets_[i].wheelPrev = &buckets_[i];
+		buckets_[i].wheelNext = &buckets_[i];
+	}
+}
+
+/* 剩余节点由各自的持有者释放，这里只断开链接 */
+TimingWheel::~TimingWheel()
+{
+	for(size_t i=0; i<=mask_; ++i)
+	{
+		TimingWheelNode *head = &buckets_[i];
+		while(head->wheelNext != head)
+		{
+			unlink(head->wheelNext);
+		}
+	}
+}
+
+/* 截止时间推后时不移桶；提前到所在桶之前时才重新链接 */
+void TimingWheel::refresh(TimingWheelNode *node, Timestamp expireAt)
+{
+	node->expireAt = expireAt;
+	if(!node->inWheel())
+	{
+		link(node, tickOf(expireAt));
+		++size_;
+	}
+	else if(tickOf(expireAt) < node->wheelTick)
+	{
+		unlink(node);
+		link(node, tickOf(expireAt));
+	}
+}
+
+void TimingWheel::remove(TimingWheelNode *node)
+{
+	if(!node->inWheel()) return ;
+	unlink(node);
+	--size_;
+}
+
+/* 回调可能移除同一个桶中的其他节点，先把整个桶摘到局部哨兵下 */
+void TimingWheel::advance(Timestamp now)
+{
+	const int64_t target = now / tick_;
+
+	/* 停顿超过一圈时，每个桶只需扫描一次 */
+	if(target - currentTick_ > static_cast<int64_t>(mask_ + 1))
+	{
+		currentTick_ = target - static_cast<int64_t>(mask_ + 1);
+	}
+
+	while(currentTick_ < target)
+	{
+		++currentTick_;
+		TimingWheelNode *head = &buckets_[currentTick_ & mask_];
+		if(head->wheelNext == head) continue;
+
+		TimingWheelNode pending;
+		pending.wheelNext = head->wheelNext;
+		pending.wheelPrev = head->wheelPrev;
+		pending.wheelNext->wheelPrev = &pending;
+		pending.wheelPrev->wheelNext = &pending;
+		head->wheelNext = head;
+		head->wheelPrev = head;
+
+		while(pending.wheelNext != &pending)
+		{
+			TimingWheelNode *node = pending.wheelNext;
+			unlink(node);
+
+			if(node->expireAt <= now)
+			{
+				--size_;
+				if(expireCallback_) expireCallback_(node);
+			}
+			else
+			{
+				/* 刷新过，或还未转满所需的圈数 */
+				link(node, tickOf(node->expireAt));
+				++rebuckets_;
+			}
+		}
+	}
+}
+
+/* 已扫描过的刻度不会再访问，最早放到下一个刻度 */
+void TimingWheel::link(TimingWheelNode *node, int64_t tick)
+{
+	if(tick <= currentTick_) tick = currentTick_ + 1;
+
+	TimingWheelNode *head = &buckets_[tick & mask_];
+	node->wheelTick = tick;
+	node->wheelPrev = head->wheelPrev;
+	node->wheelNext = head;
+	head->wheelPrev->wheelNext = node;
+	head->wheelPrev = node;
+}
+
+void TimingWheel::unlink(TimingWheelNode *node)
+{
+	node->wheelPrev->wheelNext = node->wheelNext;
+	node->wheelNext->wheelPrev = node->wheelPrev;
+	node->wheelPrev = nullptr;
+	node->wheelNext = nullptr;
+}
+
+} //namespace webserver
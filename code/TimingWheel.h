@@ -0,0 +1,91 @@
+#ifndef code_TimingWheel_h
+#define code_TimingWheel_h
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "SmallFunction.h"
+#include "TimerQueue.h"
+#include "noncopyable.h"
+
+namespace webserver
+{
+
+/* 嵌入到被计时的对象中，链接与截止时间都不另外分配内存 */
+struct TimingWheelNode
+{
+	TimingWheelNode *wheelPrev;
+	TimingWheelNode *wheelNext;
+	/* 截止时间，刷新时只改这个值 */
+	Timestamp expireAt;
+	/* 所在桶对应的刻度 */
+	int64_t wheelTick;
+
+	TimingWheelNode()
+		: wheelPrev(nullptr), wheelNext(nullptr), expireAt(0), wheelTick(0) {}
+
+	bool inWheel() const { return wheelPrev != nullptr; }
+};
+
+/*
+ * hashed timing wheel for idle timeouts
+ *   bucket = deadline tick & mask, intrusive doubly-linked lists
+ *   refresh() only moves expireAt later; the node stays in its bucket and
+ *   is re-bucketed lazily when the wheel reaches it
+ *   a deadline more than one revolution away is visited (and re-bucketed)
+ *   once per revolution
+ *   expiry is at most one tick late
+ */
+// 哈希时间轮，用于空闲超时
+// 桶下标为截止刻度取模，桶内为侵入式双向链表，增删O(1)且不分配内存
+// 刷新只推后expireAt，节点留在原来的桶中，转到该桶时才按新的截止时间移桶
+// 超过一圈的截止时间每圈被访问一次
+// 到期最多晚一个刻度
+class TimingWheel : noncopyable
+{
+public:
+	typedef SmallFunction<void (TimingWheelNode *node)> ExpireCallback;
+
+	/* buckets须为2的幂 */
+	TimingWheel(Timestamp tick, size_t buckets, Timestamp now);
+	~TimingWheel();
+
+	/* 节点已从时间轮中移除，回调中可以释放它 */
+	void setExpireCallback(ExpireCallback cb)
+	{ expireCallback_ = std::move(cb); }
+
+	/* 加入或刷新截止时间 */
+	void refresh(TimingWheelNode *node, Timestamp expireAt);
+	/* 不在时间轮中时忽略 */
+	void remove(TimingWheelNode *node);
+	/* 扫描到now为止的各个桶，到期的节点交给回调 */
+	void advance(Timestamp now);
+
+	size_t size() const { return size_; }
+	/* 因刷新而移桶的次数 */
+	uint64_t rebuckets() const { return rebuckets_; }
+
+private:
+	/* 截止时间所在刻度，向上取整，到期扫描时必然已过截止时间 */
+	int64_t tickOf(Timestamp expireAt) const
+	{ return (expireAt + tick_ - 1) / tick_; }
+
+	void link(TimingWheelNode *node, int64_t tick);
+	static void unlink(TimingWheelNode *node);
+
+private:
+	const Timestamp tick_;
+	const size_t mask_;
+	/* 各桶的哨兵，环形链表 */
+	std::unique_ptr<TimingWheelNode[]> buckets_;
+	/* 已扫描到的刻度 */
+	int64_t currentTick_;
+	size_t size_;
+	uint64_t rebuckets_;
+	ExpireCallback expireCallback_;
+};
+
+} //namespace webserver
+
+#endif
@@ -9,7 +9,19 @@
 // #define EPOLLDEBUG 0
 
 #define SOCKET_MAXBACKLOG 	2048
-#define MAX_BUFSIZE 		1024
+
+/* 请求行与Header的最大长度 */
+#define MAX_HTTPHEADERSIZE	(64 << 10)
+/* 不超过该大小的请求体整体保留在接收缓冲区中，更大的请求体流式交付 */
+#define MAX_HTTPBODYINLINE	(64 << 10)
+
+/* 静态文件根目录 */
+#define HTTP_DOCROOT		"../../source/"
+
+/* 静态内容缓存的字节预算，为0时不使用 */
+#define CONTENT_CACHE_BYTES		(64 << 20)
+/* 超过该大小的文件不进入内容缓存，直接sendfile */
+#define CONTENT_CACHE_MAX_OBJECT	(256 << 10)
 
 /* keep-alive连接超时时间(s) */
 #define MAX_HTTPEXPIRETIME	120
@@ -4,8 +4,10 @@
 #include <sys/socket.h>
 #include <unistd.h>
 #include <netinet/tcp.h>
+#include <linux/filter.h>
 #include <signal.h>
 #include <strings.h>
+#include <cerrno>
 
 #include "config.h"
 #include "macros.h"
@@ -56,10 +58,14 @@ void Listen(int sockfd, int backlog)
 	}
 }
 
-int SocketBindListen(const webserver::InetAddress &addr)
+int SocketBindListen(const webserver::InetAddress &addr, bool reusePort)
 {
 	int sockfd = Socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | 
 	                    SOCK_CLOEXEC, IPPROTO_TCP);
+	
+	// 在bind之后设置不再生效
+	setReuseAddr(sockfd, true);
+	if(reusePort) setReusePort(sockfd, true);
 						
 	Bind(sockfd, addr.get());
 	Listen(sockfd, SOCKET_MAXBACKLOG);
@@ -107,6 +113,72 @@ void setReuseAddr(int sockfd, bool on)
                &optval, sizeof optval);
 }
 
+// 同一端口上的多个监听套接字组成一组，内核按四元组哈希把新连接分给其中一个。
+// 组内所有套接字须在bind之前设置，且属于同一用户。
+void setReusePort(int sockfd, bool on)
+{
+	int optval = on ? 1 : 0;
+	if(::setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof optval) < 0)
+	{
+		perror("setsockopt SO_REUSEPORT");
+	}
+}
+
+// ld cpu; 对每个有主的CPU: jeq #cpu, 0, 1; ret #index; 最后 ret #0xffffffff
+// 返回值不小于组内套接字数时内核按哈希选择，未绑定I/O线程的CPU仍能接受连接
+bool attachReusePortCpuFilter(int sockfd, const std::vector<int> &indexOfCpu)
+{
+	std::vector<struct sock_filter> code;
+	code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)));
+	for(size_t cpu=0; cpu<indexOfCpu.size(); ++cpu)
+	{
+		if(indexOfCpu[cpu] < 0) continue;
+		code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(cpu), 0, 1));
+		code.push_back(BPF_STMT(BPF_RET | BPF_K, static_cast<uint32_t>(indexOfCpu[cpu])));
+	}
+	code.push_back(BPF_STMT(BPF_RET | BPF_K, 0xffffffff));
+	if(code.size() > BPF_MAXINSNS)
+	{
+		fprintf(stderr, "reuseport cbpf: too many cpus\n");
+		return false;
+	}
+
+	struct sock_fprog prog;
+	prog.len = static_cast<unsigned short>(code.size());
+	prog.filter = code.data();
+	if(::setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof prog) < 0)
+	{
+		perror("setsockopt SO_ATTACH_REUSEPORT_CBPF");
+		return false;
+	}
+	return true;
+}
+
+bool setIncomingCpu(int sockfd, int cpu)
+{
+	if(::setsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof cpu) < 0)
+	{
+		perror("setsockopt SO_INCOMING_CPU");
+		return false;
+	}
+	return true;
+}
+
+// 在该套接字上阻塞读、poll时，先忙等网卡队列最多usec微秒。
+// SO_PREFER_BUSY_POLL让内核在忙轮询期间推迟软中断，由应用线程收包。
+bool setBusyPoll(int sockfd, int usec)
+{
+	if(::setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof usec) < 0)
+	{
+		return false;
+	}
+#ifdef SO_PREFER_BUSY_POLL
+	int prefer = 1;
+	::setsockopt(sockfd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof prefer);
+#endif
+	return true;
+}
+
 void Shutdown(int sockfd, int how)
 {
 	int ret = ::shutdown(sockfd, how);
@@ -133,49 +205,48 @@ void IgnoreSigpipe()
 
 /* ET mode */
 /* 读写直到EAGAIN */
-int readn(int sockfd, std::string &io_buf, bool &isZero)
+/* 数据直接读入Buffer，不再经过临时string */
+ssize_t readn(int sockfd, Buffer &io_buf, bool &isZero)
 {
-	char buf[MAX_BUFSIZE];
-	int nbytes;
-	int totalSize = 0;
+	ssize_t nbytes;
+	ssize_t totalSize = 0;
+	int savedErrno = 0;
 	
 	while(true)
 	{
-		if((nbytes = ::read(sockfd, buf, MAX_BUFSIZE)) <= 0)
+		if((nbytes = io_buf.readFd(sockfd, &savedErrno)) <= 0)
 		{
-			if(errno == EINTR) continue;
-			if(errno == EAGAIN) return totalSize;
 			if(nbytes == 0)	/* 读0 */
 			{
 				isZero = true;
 				break;
 			}
+			if(savedErrno == EINTR) continue;
+			if(savedErrno == EAGAIN) return totalSize;
 			
 			return -1;
 		}
 		
 		totalSize += nbytes;
-		io_buf += std::string(buf, buf+nbytes);
 	}
 
 	return totalSize;
 }
 
-int writen(int sockfd, std::string &io_buf)
+/* 多段数据一次writev发出，已发送部分仅移动段内偏移 */
+ssize_t writen(int sockfd, OutputQueue &io_buf)
 {
-	int nbytes;
-	int totalSize = 0;
-	int bufSize = static_cast<int>(io_buf.size());;
-	const char *pstr = reinterpret_cast<const char *>(io_buf.data());
+	ssize_t nbytes;
+	ssize_t totalSize = 0;
+	int savedErrno = 0;
 	
-	while(totalSize < bufSize)
+	while(!io_buf.empty())
 	{
-		if((nbytes = ::write(sockfd, pstr +	totalSize, 
-		                     bufSize-totalSize)) <= 0)
+		if((nbytes = io_buf.writeFd(sockfd, &savedErrno)) <= 0)
 		{
-			if(errno == EINTR) continue;
-			if(errno == EAGAIN) break;
-			//if(errno == EPIPE)
+			if(savedErrno == EINTR) continue;
+			if(savedErrno == EAGAIN) break;
+			//if(savedErrno == EPIPE)
 			
 			io_buf.clear();
 			return -1;
@@ -183,15 +254,6 @@ int writen(int sockfd, std::string &io_buf)
 		totalSize += nbytes;
 	}
 	
-	if(totalSize == bufSize) 
-	{
-		io_buf.clear();
-	}
-	else 
-	{
-		io_buf = io_buf.substr(totalSize);
-	}
-	
 	return totalSize;
 }
 
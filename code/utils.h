@@ -1,7 +1,11 @@
 #ifndef code_utils_h
 #define code_utils_h
 
+#include <vector>
+
 #include "InetAddress.h"
+#include "Buffer.h"
+#include "OutputQueue.h"
 
 namespace webserver
 {
@@ -12,14 +16,23 @@ namespace utils
 int Socket(int family, int type, int proto);
 void Bind(int sockfd, const struct sockaddr_in &addr);
 void Listen(int sockfd, int backlog);
-int SocketBindListen(const webserver::InetAddress &addr);
+/* SO_REUSEADDR(reusePort时还有SO_REUSEPORT)在bind之前设置 */
+int SocketBindListen(const webserver::InetAddress &addr, bool reusePort = false);
 void Close(int sockfd);
 
 int AcceptNb(int sockfd, webserver::InetAddress &addr);
-int readn(int sockfd, std::string &io_buf, bool &isZero);
-int writen(int sockfd, std::string &io_buf);
+ssize_t readn(int sockfd, Buffer &io_buf, bool &isZero);
+ssize_t writen(int sockfd, OutputQueue &io_buf);
 
 void setReuseAddr(int sockfd, bool on);
+void setReusePort(int sockfd, bool on);
+/* SO_REUSEPORT组的cBPF程序：按处理SYN的CPU选择组内第indexOfCpu[cpu]个套接字，
+   值为-1或CPU超出范围时退回内核的哈希选择；挂在组内任一套接字上即对整组生效 */
+bool attachReusePortCpuFilter(int sockfd, const std::vector<int> &indexOfCpu);
+/* SO_INCOMING_CPU，6.2以后的内核在SO_REUSEPORT组内优先选择与当前CPU相同的监听套接字 */
+bool setIncomingCpu(int sockfd, int cpu);
+/* SO_BUSY_POLL(及SO_PREFER_BUSY_POLL)，超过net.core.busy_read时需要CAP_NET_ADMIN */
+bool setBusyPoll(int sockfd, int usec);
 void Shutdown(int sockfd, int how);
 
 void IgnoreSigpipe();
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Acceptor.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Poller.h"
+
+using namespace webserver;
+
+// 文件描述符耗尽：监听队列中有kClients个连接，进程只剩几个空闲描述符(kFree个加上编号较小的空洞)
+// 1. 前几个连接交给回调，其余的被dropConnection接受后立即关闭，客户端读到EOF
+// 2. 回调中失败的系统调用留下errno == EMFILE，下一次成功的accept不能被当成EMFILE而泄漏
+// AcceptExhaustTest [epoll|io_uring]
+
+static const uint16_t kPort = 8101;
+static const int kClients = 20;
+static const int kFree = 5;
+
+static int connectTo(uint16_t port)
+{
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0)
+	{
+		::close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* 当前打开的最大文件描述符与打开的个数 */
+static void openFds(int *highest, int *count)
+{
+	*highest = -1;
+	*count = 0;
+	DIR *dir = opendir("/proc/self/fd");
+	assert(dir != nullptr);
+	struct dirent *entry;
+	while((entry = readdir(dir)) != nullptr)
+	{
+		if(entry->d_name[0] == '.') continue;
+		*highest = std::max(*highest, atoi(entry->d_name));
+		++*count;
+	}
+	closedir(dir);
+	/* 不计opendir自己的描述符 */
+	--*count;
+}
+
+int main(int argc, char *argv[])
+{
+	Poller::Backend backend = Poller::kEpoll;
+	if(argc > 1 && Poller::parseBackend(argv[1], &backend))
+	{
+		Poller::setDefaultBackend(backend);
+	}
+
+	EventLoop loop;
+	Acceptor acceptor(&loop, InetAddress(kPort), false);
+
+	std::vector<int> held;
+	acceptor.setNewConnectionCallback([&](int connfd) {
+		held.push_back(connfd);
+		/* 模拟回调中失败的系统调用 */
+		errno = EMFILE;
+	});
+	acceptor.listen();
+
+	/* 三次握手由内核完成，连接在监听队列中等待事件循环 */
+	std::vector<int> clients;
+	for(int i=0; i<kClients; ++i)
+	{
+		int fd = connectTo(kPort);
+		assert(fd >= 0);
+		clients.push_back(fd);
+	}
+
+	int highest, count;
+	openFds(&highest, &count);
+	const int spare = highest + 1 + kFree - count;
+	struct rlimit limit;
+	getrlimit(RLIMIT_NOFILE, &limit);
+	limit.rlim_cur = highest + 1 + kFree;
+	int ret = setrlimit(RLIMIT_NOFILE, &limit);
+	assert(ret == 0);
+	(void)ret;
+
+	int dropped = 0;
+	loop.runAfter(0.2, [&]() {
+		for(int fd : clients)
+		{
+			char c;
+			if(::recv(fd, &c, 1, MSG_DONTWAIT) == 0) ++dropped;
+		}
+		loop.quit();
+	});
+	loop.loop();
+
+	printf("held=%zu accepted=%llu dropped=%d\n", held.size(),
+	       static_cast<unsigned long long>(acceptor.accepted()), dropped);
+	assert(held.size() == static_cast<size_t>(spare));
+	assert(acceptor.accepted() == static_cast<uint64_t>(spare));
+	assert(dropped == kClients - spare);
+
+	printf("AcceptExhaustTest passed\n");
+	return 0;
+}
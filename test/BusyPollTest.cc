@@ -0,0 +1,122 @@
+#include <cassert>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Channel.h"
+#include "EventLoop.h"
+
+using namespace webserver;
+
+// 忙轮询模式：
+// 1. 密集写入期间，部分事件由0超时的空转poll取得(spinHits)
+// 2. 写入停止后，空转窗口到期，预算减半，循环转入阻塞，idleSpins不再增长
+// 3. 上限小于最小预算时，减半后的预算仍不超过上限
+
+static const int kBudgetUs = 500;
+static const int kWrites = 2000;
+static const int kSmallBudgetUs = 4;
+
+static EventLoop *g_loop;
+static int g_pipe[2];
+static int g_received = 0;
+static uint64_t g_idleSpins = 0;
+
+static void onRead()
+{
+	char buf[256];
+	ssize_t n;
+	while((n = ::read(g_pipe[0], buf, sizeof(buf))) > 0)
+	{
+		g_received += static_cast<int>(n);
+	}
+}
+
+static void report(const char *stage)
+{
+	printf("%s: useful=%llu idle=%llu hits=%llu budget=%lldus\n", stage,
+	       static_cast<unsigned long long>(g_loop->usefulPolls()),
+	       static_cast<unsigned long long>(g_loop->idleSpins()),
+	       static_cast<unsigned long long>(g_loop->spinHits()),
+	       static_cast<long long>(g_loop->busyPollBudget()));
+}
+
+static void checkSmallBudget()
+{
+	report("small");
+	/* 定时器事件之后的空转窗口到期过，预算经过了减半 */
+	assert(g_loop->idleSpins() > g_idleSpins);
+	assert(g_loop->busyPollBudget() <= kSmallBudgetUs);
+	g_loop->quit();
+}
+
+static void checkBlocked()
+{
+	report("idle");
+	/* 两次检查之间只有定时器事件，每次至多空转一个预算 */
+	assert(g_loop->idleSpins() - g_idleSpins < 10000);
+	assert(g_loop->busyPollBudget() < kBudgetUs);
+
+	g_loop->setBusyPoll(kSmallBudgetUs);
+	g_idleSpins = g_loop->idleSpins();
+	g_loop->runAfter(0.2, checkSmallBudget);
+}
+
+static void afterBurst()
+{
+	assert(g_received == kWrites);
+	report("burst");
+	assert(g_loop->spinHits() > 0);
+	assert(g_loop->usefulPolls() > 0);
+	g_idleSpins = g_loop->idleSpins();
+	g_loop->runAfter(0.2, checkBlocked);
+}
+
+int main()
+{
+	EventLoop loop;
+	g_loop = &loop;
+	loop.setBusyPoll(kBudgetUs);
+	assert(loop.busyPolling());
+
+	int ret = ::pipe2(g_pipe, O_NONBLOCK | O_CLOEXEC);
+	assert(ret == 0);
+	(void)ret;
+
+	std::shared_ptr<Channel> channel(new Channel(g_pipe[0], &loop));
+	channel->setReadCallback(onRead);
+	channel->enableReading();
+
+	std::thread writer([]() {
+		for(int i=0; i<kWrites; ++i)
+		{
+			ssize_t n = ::write(g_pipe[1], "x", 1);
+			assert(n == 1);
+			(void)n;
+			::usleep(50);
+		}
+	});
+
+	/* 写入结束后再检查 */
+	loop.runEvery(0.05, []() {
+		static bool checked = false;
+		if(!checked && g_received == kWrites)
+		{
+			checked = true;
+			afterBurst();
+		}
+	});
+
+	loop.loop();
+	writer.join();
+
+	channel->disableAll();
+	loop.removeChannel(channel);
+	channel.reset();
+	::close(g_pipe[1]);
+	printf("BusyPollTest passed\n");
+	return 0;
+}
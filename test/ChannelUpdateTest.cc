@@ -0,0 +1,89 @@
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Channel.h"
+#include "EventLoop.h"
+
+using namespace webserver;
+
+// 一轮中多次修改兴趣集合，只在下一次poll之前提交一次
+// 最终与已登记的事件相同时，不调用Poller
+
+static EventLoop *g_loop;
+static std::shared_ptr<Channel> g_channel;
+static int g_pipe[2];
+static int g_rounds = 0;
+/* EventLoop自身的Channel(wakeup、定时器)，各登记一次 */
+static uint64_t g_base = 0;
+
+static void toggleWriting(int times)
+{
+	for(int i=0; i<times; ++i)
+	{
+		g_channel->enableWriting();
+		g_channel->disableWriting();
+	}
+}
+
+static void onRead()
+{
+	char buf[16];
+	while(::read(g_pipe[0], buf, sizeof(buf)) > 0) {}
+
+	++g_rounds;
+	printf("round %d: updates=%llu poller=%llu saved=%llu\n", g_rounds,
+	       static_cast<unsigned long long>(g_loop->channelUpdates()),
+	       static_cast<unsigned long long>(g_loop->pollerUpdates()),
+	       static_cast<unsigned long long>(g_loop->savedPollerUpdates()));
+
+	if(g_rounds == 1)
+	{
+		/* pipe只登记一次，EPOLLOUT开关20次都被合并 */
+		assert(g_loop->channelUpdates() == g_base + 21);
+		assert(g_loop->pollerUpdates() == g_base + 1);
+
+		toggleWriting(5);
+		::write(g_pipe[1], "x", 1);
+	}
+	else
+	{
+		/* 最终的兴趣集合未变，不产生epoll_ctl */
+		assert(g_loop->channelUpdates() == g_base + 31);
+		assert(g_loop->pollerUpdates() == g_base + 1);
+		assert(g_loop->savedPollerUpdates() == 30);
+
+		g_channel->disableAll();
+		g_loop->removeChannel(g_channel);
+		g_loop->quit();
+	}
+}
+
+int main()
+{
+	EventLoop loop;
+	g_loop = &loop;
+	g_base = loop.channelUpdates();
+
+	int ret = ::pipe2(g_pipe, O_NONBLOCK | O_CLOEXEC);
+	assert(ret == 0);
+	(void)ret;
+
+	g_channel.reset(new Channel(g_pipe[0], &loop));
+	g_channel->setReadCallback(onRead);
+	g_channel->enableReading();
+	toggleWriting(10);
+	::write(g_pipe[1], "x", 1);
+
+	loop.loop();
+	assert(g_rounds == 2);
+
+	g_channel.reset();
+	::close(g_pipe[1]);
+	printf("ChannelUpdateTest passed\n");
+	return 0;
+}
@@ -0,0 +1,127 @@
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "EventLoop.h"
+#include "FileCache.h"
+#include "ContentCache.h"
+
+using namespace webserver;
+
+// 在临时目录中生成size字节的文件
+void writeFile(const std::string &path, size_t size)
+{
+	FILE *fp = fopen(path.c_str(), "w");
+	assert(fp != nullptr);
+	std::string data(size, 'x');
+	fwrite(data.data(), 1, data.size(), fp);
+	fclose(fp);
+}
+
+void printStats(const char *note, ContentCache &cache)
+{
+	ContentCache::Stats s = cache.stats();
+	printf("%-12s hits=%lu misses=%lu evictions=%lu rejections=%lu bytes=%zu entries=%zu\n",
+	       note, s.hits, s.misses, s.evictions, s.rejections, s.bytes, s.entries);
+}
+
+int main(int argc, char *argv[])
+{
+	char dir[] = "/tmp/ContentCacheTestXXXXXX";
+	const char *made = mkdtemp(dir);
+	assert(made != nullptr);
+	(void)made;
+	std::string root(dir);
+
+	const int kHotFiles = 8;
+	const int kColdFiles = 200;
+	const size_t kFileSize = 4096;
+
+	for(int i=0; i<kHotFiles; ++i)
+		writeFile(root + "/hot" + std::to_string(i), kFileSize);
+	for(int i=0; i<kColdFiles; ++i)
+		writeFile(root + "/cold" + std::to_string(i), kFileSize);
+
+	EventLoop loop;
+	FileCache files(&loop, root);
+
+	// 容量约能放下16个文件
+	ContentCache cache(16 * (kFileSize + 128), 64 << 10);
+
+	// 热点文件被反复访问
+	for(int round=0; round<10; ++round)
+	{
+		for(int i=0; i<kHotFiles; ++i)
+		{
+			std::string path = "hot" + std::to_string(i);
+			ContentCache::SP_ConstString body = cache.get(path, files.get(path));
+			assert(body != nullptr);
+			(void)body;
+		}
+	}
+	printStats("hot:", cache);
+
+	// 一次性扫描大量冷文件
+	for(int i=0; i<kColdFiles; ++i)
+	{
+		std::string path = "cold" + std::to_string(i);
+		ContentCache::SP_ConstString body = cache.get(path, files.get(path));
+		assert(body != nullptr && body->size() == kFileSize);
+		(void)body;
+	}
+	printStats("scan:", cache);
+
+	// 扫描后热点文件应全部命中
+	ContentCache::Stats before = cache.stats();
+	for(int i=0; i<kHotFiles; ++i)
+	{
+		std::string path = "hot" + std::to_string(i);
+		cache.get(path, files.get(path));
+	}
+	ContentCache::Stats after = cache.stats();
+	printStats("hot again:", cache);
+	assert(after.hits - before.hits == kHotFiles);
+	assert(after.bytes <= 16 * (kFileSize + 128));
+
+	// 多个线程同时命中：查找只持有读锁，命中数不丢失，热点文件仍全部在缓存中
+	const int kThreads = 4;
+	const int kRounds = 20000;
+	std::vector<FileCache::SP_Entry> hotEntries;
+	for(int i=0; i<kHotFiles; ++i)
+		hotEntries.push_back(files.get("hot" + std::to_string(i)));
+	before = cache.stats();
+	std::atomic<int> missing(0);
+	std::vector<std::thread> threads;
+	for(int t=0; t<kThreads; ++t)
+	{
+		threads.emplace_back([&]() {
+			for(int r=0; r<kRounds; ++r)
+			{
+				int i = r % kHotFiles;
+				ContentCache::SP_ConstString body = cache.get("hot" + std::to_string(i), hotEntries[i]);
+				if(body == nullptr || body->size() != kFileSize) ++missing;
+			}
+		});
+	}
+	for(auto &t : threads) t.join();
+	after = cache.stats();
+	printStats("concurrent:", cache);
+	assert(missing == 0);
+	assert(after.hits - before.hits == static_cast<uint64_t>(kThreads * kRounds));
+	assert(after.misses == before.misses);
+
+	for(int i=0; i<kHotFiles; ++i)
+		unlink((root + "/hot" + std::to_string(i)).c_str());
+	for(int i=0; i<kColdFiles; ++i)
+		unlink((root + "/cold" + std::to_string(i)).c_str());
+	rmdir(dir);
+
+	printf("ContentCacheTest passed\n");
+	return 0;
+}
@@ -0,0 +1,89 @@
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+#include "CpuPlacement.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "CountDownLatch.h"
+
+using namespace webserver;
+
+// 1. CPU列表的解析
+// 2. 各策略都能从本机拓扑得到位置
+// 3. 通过ThreadInitCallback绑定后，各事件循环线程的亲和性与位置一致
+
+static void testParseList()
+{
+	std::vector<int> cpus;
+	assert(CpuPlacement::parseCpuList("0,2,4-7", &cpus));
+	assert((cpus == std::vector<int>{ 0, 2, 4, 5, 6, 7 }));
+	assert(CpuPlacement::parseCpuList("3,1-2,3\n", &cpus));
+	assert((cpus == std::vector<int>{ 1, 2, 3 }));
+	assert(!CpuPlacement::parseCpuList("", &cpus));
+	assert(!CpuPlacement::parseCpuList("1-", &cpus));
+	assert(!CpuPlacement::parseCpuList("4-2", &cpus));
+	assert(!CpuPlacement::parseCpuList("x", &cpus));
+
+	CpuPlacement placement;
+	assert(!CpuPlacement::parse("bogus", &placement));
+	assert(!CpuPlacement::parse("100000", &placement));
+	printf("cpu list parsing ok\n");
+}
+
+static void testPolicies()
+{
+	const char *specs[] = { "cores", "numa" };
+	for(const char *spec : specs)
+	{
+		CpuPlacement placement;
+		assert(CpuPlacement::parse(spec, &placement));
+		assert(placement.slots() > 0);
+		printf("%s: %zu slots, slot 0 %s\n", spec, placement.slots(),
+		       placement.describe(0).c_str());
+	}
+}
+
+static void testBindLoops()
+{
+	std::vector<int> allowed = CpuPlacement::currentAffinity();
+	assert(!allowed.empty());
+
+	/* 只用第一个允许的CPU，单核机器上也能运行 */
+	std::string list = std::to_string(allowed[0]);
+	CpuPlacement placement;
+	assert(CpuPlacement::parse(list.c_str(), &placement));
+	assert(placement.slots() == 1);
+
+	EventLoop baseLoop;
+	EventLoopThreadPool pool(&baseLoop, 3);
+	size_t next = 0;
+	pool.start([&](EventLoop *) {
+		bool ok = placement.bindCurrentThread(next++);
+		assert(ok);
+		(void)ok;
+	});
+
+	for(int i=0; i<3; ++i)
+	{
+		EventLoop *loop = pool.getNextLoop();
+		CountDownLatch latch(1);
+		std::vector<int> affinity;
+		loop->runInLoop([&]() {
+			affinity = CpuPlacement::currentAffinity();
+			latch.countDown();
+		});
+		latch.wait();
+		assert((affinity == std::vector<int>{ allowed[0] }));
+	}
+	printf("3 loops bound to cpu %d\n", allowed[0]);
+}
+
+int main()
+{
+	testParseList();
+	testPolicies();
+	testBindLoops();
+	printf("CpuPlacementTest passed\n");
+	return 0;
+}
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <cassert>
 #include <functional>
+#include <vector>
 
 #include <sys/types.h>
 #include <unistd.h>
@@ -69,6 +70,52 @@ int main(int argc, char *argv[])
 	// 	assert(nextLoop == model.getNextLoop());
 	// }
 	
+	{
+		printf("Dispatch policies:\n");
+		webserver::EventLoopThreadPool model(&loop, 3);
+		model.start(init);
+		std::vector<webserver::EventLoop *> loops = model.getAllLoops();
+		
+		// 连接数分别为 5 2 7，getNextLoop本身不计数
+		const int counts[3] = { 5, 2, 7 };
+		for(int i=0; i<3; ++i)
+		{
+			for(int j=0; j<counts[i]; ++j) loops[i]->connectionAssigned();
+		}
+		
+		model.setDispatchPolicy(webserver::EventLoopThreadPool::kLeastConnections);
+		assert(model.getNextLoop() == loops[1]);
+		assert(model.getNextLoop() == loops[1]);
+		
+		// 每次计入一个连接，最少连接数依次追平
+		std::vector<int> picked(3, 0);
+		for(int i=0; i<8; ++i)
+		{
+			webserver::EventLoop *next = model.getNextLoop();
+			next->connectionAssigned();
+			++picked[next == loops[0] ? 0 : next == loops[1] ? 1 : 2];
+		}
+		printf("least: %d %d %d\n", picked[0], picked[1], picked[2]);
+		assert(picked[0] == 2 && picked[1] == 5 && picked[2] == 1);
+		
+		// 两个随机候选中取负载低的，负载最高的循环不会被选中
+		loops[2]->connectionAssigned();
+		model.setDispatchPolicy(webserver::EventLoopThreadPool::kPowerOfTwoChoices);
+		std::vector<int> chosen(3, 0);
+		for(int i=0; i<300; ++i)
+		{
+			webserver::EventLoop *next = model.getNextLoop();
+			++chosen[next == loops[0] ? 0 : next == loops[1] ? 1 : 2];
+		}
+		printf("p2c: %d %d %d\n", chosen[0], chosen[1], chosen[2]);
+		assert(chosen[2] == 0 && chosen[0] > 0 && chosen[1] > 0);
+		
+		webserver::EventLoopThreadPool::DispatchPolicy policy;
+		assert(webserver::EventLoopThreadPool::parseDispatchPolicy("p2c", &policy));
+		assert(policy == webserver::EventLoopThreadPool::kPowerOfTwoChoices);
+		assert(!webserver::EventLoopThreadPool::parseDispatchPolicy("random", &policy));
+	}
+	
 	loop.loop();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "EventLoop.h"
+#include "FileCache.h"
+
+using namespace webserver;
+
+// 缓存已满时按CLOCK淘汰：
+// 1. 缓存项不超过上限，新文件仍会被缓存
+// 2. 两次插入之间都被访问过的热点文件不被淘汰，始终返回同一个缓存项
+// 3. 多个线程在读锁下并发命中
+
+static const size_t kMaxEntries = 4;
+static const int kColdFiles = 32;
+static const int kReaders = 3;
+
+void writeFile(const std::string &path)
+{
+	FILE *fp = fopen(path.c_str(), "w");
+	assert(fp != nullptr);
+	fputs(path.c_str(), fp);
+	fclose(fp);
+}
+
+int main(int argc, char *argv[])
+{
+	char dir[] = "/tmp/FileCacheTestXXXXXX";
+	const char *made = mkdtemp(dir);
+	assert(made != nullptr);
+	(void)made;
+	std::string root(dir);
+
+	writeFile(root + "/hot");
+	for(int i=0; i<kColdFiles; ++i)
+		writeFile(root + "/cold" + std::to_string(i));
+
+	EventLoop loop;
+	FileCache files(&loop, root, kMaxEntries);
+
+	const FileCache::SP_Entry hot = files.get("hot");
+	assert(hot != nullptr);
+
+	std::atomic<bool> stop(false);
+	std::atomic<long> hits(0);
+	std::vector<std::thread> readers;
+	for(int i=0; i<kReaders; ++i)
+	{
+		readers.emplace_back([&]() {
+			while(!stop.load(std::memory_order_relaxed))
+			{
+				FileCache::SP_Entry entry = files.get("hot");
+				assert(entry != nullptr);
+				(void)entry;
+				++hits;
+			}
+		});
+	}
+
+	for(int i=0; i<kColdFiles; ++i)
+	{
+		FileCache::SP_Entry cold = files.get("cold" + std::to_string(i));
+		assert(cold != nullptr);
+		(void)cold;
+		/* 冷文件只访问一次，引用位未置位，先于热点文件被淘汰 */
+		FileCache::SP_Entry entry = files.get("hot");
+		assert(entry == hot);
+		assert(files.size() <= kMaxEntries);
+		(void)entry;
+	}
+
+	stop = true;
+	for(auto &t : readers) t.join();
+
+	const uint64_t evictions = files.evictions();
+	printf("entries=%zu evictions=%llu concurrent hits=%ld\n", files.size(),
+	       static_cast<unsigned long long>(evictions), hits.load());
+	assert(files.size() == kMaxEntries);
+	assert(evictions == kColdFiles + 1 - kMaxEntries);
+	(void)evictions;
+
+	unlink((root + "/hot").c_str());
+	for(int i=0; i<kColdFiles; ++i)
+		unlink((root + "/cold" + std::to_string(i)).c_str());
+	rmdir(dir);
+
+	printf("FileCacheTest passed\n");
+	return 0;
+}
@@ -0,0 +1,110 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Acceptor.h"
+#include "EventLoop.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+#include "Poller.h"
+
+using namespace webserver;
+
+// 连接风暴：主事件循环开始运行之前，监听队列中已有kConnections个连接
+// 一次可读事件全部accept，每kMaxBurst个连接为一批，每批中每个I/O线程只收到一个任务，
+// 连接在I/O线程中创建并正常应答
+// HandoffBatchTest [epoll|io_uring]：io_uring的完成事件可能分几轮交付，每轮至多一批
+
+static const uint16_t kPort = 8098;
+static const int kThreads = 3;
+static const int kConnections = 300;
+
+static int connectTo(uint16_t port)
+{
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0)
+	{
+		::close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static bool request(int fd)
+{
+	const char req[] = "GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n";
+	ssize_t n = ::write(fd, req, sizeof(req) - 1);
+	(void)n;
+
+	char buf[1024];
+	size_t len = 0;
+	ssize_t r;
+	while((r = ::read(fd, buf + len, sizeof(buf) - 1 - len)) > 0) len += r;
+	buf[len] = '\0';
+	::close(fd);
+	return strncmp(buf, "HTTP/1.1 200 OK", 15) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	Poller::Backend backend = Poller::kEpoll;
+	if(argc > 1 && Poller::parseBackend(argv[1], &backend))
+	{
+		Poller::setDefaultBackend(backend);
+	}
+
+	EventLoop mainLoop;
+	/* HttpServer不支持在运行后析构，进程退出时直接回收 */
+	HttpServer *server = new HttpServer(&mainLoop, InetAddress(kPort), kThreads);
+	server->start();
+
+	/* 三次握手由内核完成，连接在监听队列中等待主事件循环 */
+	std::vector<int> fds;
+	for(int i=0; i<kConnections; ++i)
+	{
+		int fd = connectTo(kPort);
+		assert(fd >= 0);
+		fds.push_back(fd);
+	}
+
+	int ok = 0;
+	std::thread client([&]() {
+		for(int fd : fds)
+		{
+			ok += request(fd);
+		}
+		mainLoop.quit();
+	});
+	mainLoop.loop();
+	client.join();
+
+	printf("%llu connections in %llu batches\n",
+	       static_cast<unsigned long long>(server->acceptedPerAcceptor()[0]),
+	       static_cast<unsigned long long>(server->handoffBatches()));
+	assert(ok == kConnections);
+	assert(server->acceptedPerAcceptor()[0] == kConnections);
+	if(backend == Poller::kEpoll)
+	{
+		const int bursts = (kConnections + Acceptor::kMaxBurst - 1) / Acceptor::kMaxBurst;
+		assert(server->handoffBatches() == static_cast<uint64_t>(bursts * kThreads));
+		(void)bursts;
+	}
+	else
+	{
+		assert(server->handoffBatches() < kConnections / 2);
+	}
+	printf("HandoffBatchTest passed\n");
+	return 0;
+}
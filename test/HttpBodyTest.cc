@@ -0,0 +1,176 @@
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Buffer.h"
+#include "HttpHeaders.h"
+#include "HttpBody.h"
+
+using namespace webserver;
+
+static const char kHead[] = "POST / HTTP/1.1\r\n";
+
+// 在缓冲区中构造请求头，返回请求体的起始偏移
+size_t writeHead(Buffer &buf, HttpHeaders &headers, const std::string &key, const std::string &value)
+{
+	buf.append(kHead, sizeof(kHead) - 1);
+	size_t keyOff = buf.readableBytes();
+	buf.append(key + ": " + value + "\r\n\r\n");
+	headers.add(keyOff, key.size(), keyOff + key.size() + 2, value.size());
+	return buf.readableBytes();
+}
+
+// 在缓冲区中构造带有多个字段的请求头，返回请求体的起始偏移
+size_t writeFields(Buffer &buf, HttpHeaders &headers,
+                   const std::vector<std::pair<std::string, std::string>> &fields)
+{
+	buf.append(kHead, sizeof(kHead) - 1);
+	for(const auto &field : fields)
+	{
+		size_t keyOff = buf.readableBytes();
+		buf.append(field.first + ": " + field.second + "\r\n");
+		headers.add(keyOff, field.first.size(), keyOff + field.first.size() + 2, field.second.size());
+	}
+	buf.append(std::string("\r\n"));
+	return buf.readableBytes();
+}
+
+// 只检查请求头能否确定请求体的长度，可以时通过*length返回
+bool startWith(const std::vector<std::pair<std::string, std::string>> &fields, size_t *length)
+{
+	Buffer buf;
+	HttpHeaders headers(&buf);
+	HttpBody body(1 << 20);
+	bool ok = body.start(headers, writeFields(buf, headers, fields));
+	if(ok && body.hasBody())
+	{
+		buf.append(std::string(1 << 10, 'x'));
+		HttpBody::Result ret = body.decode(buf);
+		ok = ret == HttpBody::kBodyDone;
+	}
+	*length = body.length();
+	return ok;
+}
+
+std::string chunked(const std::string &data, size_t chunkSize)
+{
+	std::string out;
+	char line[32];
+	for(size_t i=0; i<data.size(); i+=chunkSize)
+	{
+		size_t n = std::min(chunkSize, data.size() - i);
+		snprintf(line, sizeof(line), "%zx\r\n", n);
+		out += line + data.substr(i, n) + "\r\n";
+	}
+	return out + "0\r\n\r\n";
+}
+
+// 每次喂入step字节，返回解码得到的请求体
+std::string feed(const std::string &key, const std::string &value, const std::string &wire,
+                 size_t step, size_t limit, bool *streamed, size_t *maxBuffered)
+{
+	Buffer buf;
+	HttpHeaders headers(&buf);
+	size_t begin = writeHead(buf, headers, key, value);
+
+	std::string sliced;
+	HttpBody body(limit);
+	body.setSliceCallback([&](std::string_view slice) { sliced.append(slice); });
+	assert(body.start(headers, begin));
+
+	HttpBody::Result ret = HttpBody::kBodyNeedMore;
+	*maxBuffered = 0;
+	size_t fed = 0;
+	while(fed < wire.size() && ret == HttpBody::kBodyNeedMore)
+	{
+		size_t n = std::min(step, wire.size() - fed);
+		buf.append(wire.data() + fed, n);
+		fed += n;
+		ret = body.decode(buf);
+		assert(ret != HttpBody::kBodyError);
+		*maxBuffered = std::max(*maxBuffered, buf.readableBytes());
+	}
+	assert(ret == HttpBody::kBodyDone);
+
+	/* 请求头未被移动 */
+	assert(std::string(buf.peek(), sizeof(kHead) - 1) == kHead);
+	/* 请求体之后是下一个请求 */
+	size_t rest = buf.readableBytes() - body.end();
+	assert(std::string(buf.peek() + body.end(), rest) == wire.substr(fed - rest, rest));
+
+	*streamed = body.streaming();
+	return body.streaming() ? sliced : std::string(body.view(buf));
+}
+
+int main(int argc, char *argv[])
+{
+	std::string data;
+	for(int i=0; data.size() < (1 << 20); ++i) data += std::to_string(i) + ",";
+	const std::string next = "GET / HTTP/1.1\r\n\r\n";
+	const size_t kLimit = 64 << 10;
+
+	bool streamed;
+	size_t maxBuffered;
+
+	// 小请求体：整体保留，连续视图
+	std::string small = data.substr(0, 1000);
+	const size_t steps[] = { 1, 7, 1500, 1 << 20 };
+	for(size_t step : steps)
+	{
+		assert(feed("Content-Length", std::to_string(small.size()), small + next,
+		            step, kLimit, &streamed, &maxBuffered) == small);
+		assert(!streamed);
+		assert(feed("Transfer-Encoding", "chunked", chunked(small, 100) + next,
+		            step, kLimit, &streamed, &maxBuffered) == small);
+		assert(!streamed);
+	}
+
+	// 大请求体：流式交付，缓冲区不随请求体增长
+	assert(feed("Content-Length", std::to_string(data.size()), data + next,
+	            16 << 10, kLimit, &streamed, &maxBuffered) == data);
+	assert(streamed);
+	printf("Content-Length %zu bytes, max buffered %zu\n", data.size(), maxBuffered);
+	assert(maxBuffered < (40 << 10));
+
+	assert(feed("transfer-encoding", "gzip, chunked", chunked(data, 5000) + next,
+	            16 << 10, kLimit, &streamed, &maxBuffered) == data);
+	assert(streamed);
+	printf("chunked        %zu bytes, max buffered %zu\n", data.size(), maxBuffered);
+	assert(maxBuffered < kLimit + (40 << 10));
+
+	// 无法确定长度的请求
+	Buffer buf;
+	HttpHeaders headers(&buf);
+	HttpBody body(kLimit);
+	assert(!body.start(headers, writeHead(buf, headers, "Transfer-Encoding", "gzip")));
+	buf.retrieveAll(); headers.clear();
+	assert(!body.start(headers, writeHead(buf, headers, "Content-Length", "12x")));
+	buf.retrieveAll(); headers.clear();
+	writeHead(buf, headers, "Transfer-Encoding", "chunked");
+	buf.append(std::string("zz\r\n"));
+	assert(body.start(headers, buf.readableBytes() - 4));
+	assert(body.decode(buf) == HttpBody::kBodyError);
+
+	// 多个Content-Length：值全部相同时接受，否则可能被用于请求走私，拒绝
+	size_t length = 0;
+	bool ok = startWith({ { "Content-Length", "5" }, { "content-length", "5" } }, &length);
+	assert(ok && length == 5);
+	ok = startWith({ { "Content-Length", "5, 5" } }, &length);
+	assert(ok && length == 5);
+	ok = startWith({ { "Content-Length", "5" }, { "Content-Length", "6" } }, &length);
+	assert(!ok);
+	ok = startWith({ { "Content-Length", "6" }, { "Content-Length", "5" } }, &length);
+	assert(!ok);
+	ok = startWith({ { "Content-Length", "5, 6" } }, &length);
+	assert(!ok);
+	ok = startWith({ { "Content-Length", "5," } }, &length);
+	assert(!ok);
+	ok = startWith({ { "Content-Length", "5" }, { "Transfer-Encoding", "chunked" } }, &length);
+	assert(!ok);
+	(void)ok;
+
+	printf("HttpBodyTest passed\n");
+	return 0;
+}
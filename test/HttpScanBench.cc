@@ -0,0 +1,93 @@
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "HttpScanner.h"
+
+using namespace webserver;
+
+// 典型浏览器请求，约700字节
+static const char kRequest[] =
+	"GET /index.html?utm_source=newsletter&utm_medium=email HTTP/1.1\r\n"
+	"Host: www.example.com\r\n"
+	"Connection: keep-alive\r\n"
+	"Cache-Control: max-age=0\r\n"
+	"sec-ch-ua: \"Chromium\";v=\"122\", \"Not(A:Brand\";v=\"24\", \"Google Chrome\";v=\"122\"\r\n"
+	"sec-ch-ua-mobile: ?0\r\n"
+	"sec-ch-ua-platform: \"Linux\"\r\n"
+	"Upgrade-Insecure-Requests: 1\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+	"Chrome/122.0.0.0 Safari/537.36\r\n"
+	"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,"
+	"image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+	"Sec-Fetch-Site: none\r\n"
+	"Sec-Fetch-Mode: navigate\r\n"
+	"Sec-Fetch-User: ?1\r\n"
+	"Sec-Fetch-Dest: document\r\n"
+	"Accept-Encoding: gzip, deflate, br\r\n"
+	"Accept-Language: en-US,en;q=0.9,zh-CN;q=0.8,zh;q=0.7\r\n"
+	"Cookie: session=8f2a9c1e7b3d4f6a; theme=dark; _ga=GA1.2.123456789.1700000000\r\n"
+	"If-None-Match: \"61d-65ba51a100000000\"\r\n"
+	"\r\n";
+
+static const int kIterations = 1000000;
+
+size_t parseWithScanner(HttpScanner &scanner, const char *data, size_t size)
+{
+	size_t fields = 0;
+	scanner.reset();
+	scanner.scan(data, size);
+	while(scanner.hasLine())
+	{
+		fields += scanner.front().colon != HttpScanner::kNoColon;
+		scanner.pop();
+	}
+	return fields;
+}
+
+template <typename Func>
+double measure(Func func)
+{
+	auto start = std::chrono::steady_clock::now();
+	size_t sink = 0;
+	for(int i=0; i<kIterations; ++i)
+	{
+		sink += func();
+	}
+	auto end = std::chrono::steady_clock::now();
+	/* 防止被优化掉 */
+	if(sink == 0) printf("unexpected\n");
+	return std::chrono::duration<double, std::nano>(end - start).count() / kIterations;
+}
+
+int main(int argc, char *argv[])
+{
+	const std::string request(kRequest);
+	const size_t size = request.size();
+	printf("request: %zu bytes, best kernel: %s\n", size,
+	       HttpScanner::kernelName(HttpScanner::bestKernel()));
+
+	const HttpScanner::Kernel kernels[] =
+		{ HttpScanner::kScalar, HttpScanner::kSse2, HttpScanner::kAvx2 };
+	/* 各内核只与标量版本(memchr)比较，解析本身都不分配内存 */
+	size_t expected = 0;
+	double base = 0;
+	for(auto kernel : kernels)
+	{
+		if(kernel == HttpScanner::kAvx2 && HttpScanner::bestKernel() != HttpScanner::kAvx2)
+			continue;
+
+		HttpScanner scanner(kernel);
+		size_t fields = parseWithScanner(scanner, request.data(), size);
+		if(expected == 0) expected = fields;
+		assert(fields == expected);
+
+		double ns = measure([&]() { return parseWithScanner(scanner, request.data(), size); });
+		if(kernel == HttpScanner::kScalar) base = ns;
+		printf("%-8s %8.1f ns/request  (x%.2f)\n", HttpScanner::kernelName(kernel), ns, base / ns);
+	}
+
+	return 0;
+}
@@ -0,0 +1,110 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#include "EventLoop.h"
+#include "TimerQueue.h"
+
+using namespace webserver;
+
+// 缓存时钟每轮poll之后更新一次，单调不减
+// Date字符串为RFC 7231格式，与墙上时间一致，同一秒内不重新格式化
+// 忙碌的一轮之后加入的近期定时器按时触发，poll超时不包含这一轮的忙碌时间
+
+static EventLoop *g_loop;
+static Timestamp g_lastNow = 0;
+static int g_rounds = 0;
+static time_t g_firstSecond = 0;
+static time_t g_lastWall = -1;
+static uint64_t g_wallChanges = 0;
+
+static const Timestamp kBusyUs = 12 * 1000;
+static const double kDelay = 0.002;
+static Timestamp g_due = 0;
+static Timestamp g_late = -1;
+
+/* 回调中忙碌kBusyUs后加入一个kDelay之后的定时器，二者之和在poll超时负责的近期范围内 */
+static void busyRound()
+{
+	const Timestamp start = TimerQueue::now();
+	while(TimerQueue::now() - start < kBusyUs) {}
+	g_due = TimerQueue::now() + static_cast<Timestamp>(kDelay * 1000000);
+	g_loop->runAfter(kDelay, []() { g_late = TimerQueue::now() - g_due; });
+}
+
+static void checkDate()
+{
+	const std::string &date = g_loop->httpDate();
+	assert(date.size() == strlen("Sun, 06 Nov 1994 08:49:37 GMT"));
+
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	const char *end = strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+	assert(end != nullptr && *end == '\0');
+	(void)end;
+	assert(timegm(&tm) == g_loop->wallTime());
+
+	/* 墙上时间每变化一次至多格式化一次，同一秒内再次调用不格式化 */
+	if(g_loop->wallTime() != g_lastWall)
+	{
+		++g_wallChanges;
+		g_lastWall = g_loop->wallTime();
+	}
+	const uint64_t formats = g_loop->httpDateFormats();
+	assert(formats <= g_wallChanges);
+	g_loop->httpDate();
+	assert(g_loop->httpDateFormats() == formats);
+	(void)formats;
+}
+
+static void onTick()
+{
+	++g_rounds;
+	assert(g_loop->now() >= g_lastNow);
+	g_lastNow = g_loop->now();
+	checkDate();
+
+	if(g_firstSecond == 0)
+	{
+		g_firstSecond = g_loop->wallTime();
+		busyRound();
+	}
+	if(g_loop->wallTime() >= g_firstSecond + 2)
+	{
+		printf("rounds=%d formats=%llu date=%s\n", g_rounds,
+		       static_cast<unsigned long long>(g_loop->httpDateFormats()),
+		       g_loop->httpDate().c_str());
+		g_loop->quit();
+	}
+}
+
+int main()
+{
+	EventLoop loop;
+	g_loop = &loop;
+
+	/* 缓存时钟不超过精确时钟 */
+	assert(loop.now() <= TimerQueue::now());
+
+	loop.runEvery(0.05, onTick);
+	loop.loop();
+	assert(g_rounds >= 20);
+	/* 跨过两秒，每秒都重新格式化 */
+	assert(loop.httpDateFormats() >= 3);
+
+	/* 粗粒度时钟在poll前后各至多落后一个节拍，节拍较长时无法与忙碌时间区分 */
+	struct timespec res;
+	::clock_getres(CLOCK_MONOTONIC_COARSE, &res);
+	const Timestamp tickUs = res.tv_sec * 1000000 + res.tv_nsec / 1000;
+	printf("timer after busy round: %lld us late, tick %lld us\n",
+	       static_cast<long long>(g_late), static_cast<long long>(tickUs));
+	assert(g_late >= 0);
+	if(2 * tickUs < kBusyUs)
+	{
+		assert(g_late < kBusyUs);
+	}
+	printf("LoopClockTest passed\n");
+	return 0;
+}
@@ -0,0 +1,136 @@
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "EventLoop.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+
+using namespace webserver;
+
+// 空闲keep-alive连接的迁移
+// 轮流分配时第i个连接在第i%2个I/O线程，关闭偶数号连接后负载为0/kConnections/2，
+// 负载均衡把一半空闲连接迁到空闲的线程；迁移期间客户端持续在各连接上发请求，
+// 请求之间的连接随时可能被迁走，每个请求都须得到应答
+
+static const uint16_t kPort = 8099;
+static const int kConnections = 40;
+static const char kBody[] = "Hello, Alfred WebServer.";
+
+static int connectTo(uint16_t port)
+{
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0)
+	{
+		::close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* keep-alive请求，读到完整的应答体为止 */
+static bool request(int fd)
+{
+	const char req[] = "GET /hello HTTP/1.1\r\nHost: test\r\n\r\n";
+	if(::write(fd, req, sizeof(req) - 1) != sizeof(req) - 1) return false;
+
+	std::string response;
+	char buf[1024];
+	while(response.size() < sizeof(kBody) - 1 ||
+	      response.compare(response.size() - (sizeof(kBody) - 1), std::string::npos, kBody) != 0)
+	{
+		ssize_t n = ::read(fd, buf, sizeof(buf));
+		if(n <= 0) return false;
+		response.append(buf, n);
+	}
+	return response.compare(0, 15, "HTTP/1.1 200 OK") == 0;
+}
+
+static void waitFor(HttpServer *server, int first, int second)
+{
+	for(int i=0; i<100; ++i)
+	{
+		std::vector<int> connections = server->connectionsPerLoop();
+		if(connections[0] == first && connections[1] == second) return ;
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+}
+
+static bool balanced(const std::vector<int> &connections)
+{
+	return connections[0] > 0 && abs(connections[0] - connections[1]) < 4;
+}
+
+int main()
+{
+	EventLoop mainLoop;
+	/* HttpServer不支持在运行后析构，进程退出时直接回收 */
+	HttpServer *server = new HttpServer(&mainLoop, InetAddress(kPort), 2);
+	server->setRebalanceInterval(0.2);
+	server->start();
+
+	bool ok = true;
+	std::vector<int> connections;
+	std::thread client([&]() {
+		/* 逐个连接并完成一个请求，accept的顺序与连接的顺序相同 */
+		std::vector<int> fds;
+		for(int i=0; i<kConnections; ++i)
+		{
+			int fd = connectTo(kPort);
+			assert(fd >= 0);
+			ok = ok && request(fd);
+			fds.push_back(fd);
+		}
+		waitFor(server, kConnections / 2, kConnections / 2);
+
+		std::vector<int> alive;
+		for(int i=0; i<kConnections; ++i)
+		{
+			if(i % 2 == 0) ::close(fds[i]);
+			else alive.push_back(fds[i]);
+		}
+
+		/* 关闭后为0/20；正在处理请求的连接不迁移，连接数相差不到4时不再迁移 */
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while(std::chrono::steady_clock::now() < deadline)
+		{
+			for(int fd : alive)
+			{
+				ok = ok && request(fd);
+			}
+			connections = server->connectionsPerLoop();
+			if(balanced(connections)) break;
+		}
+
+		for(int fd : alive)
+		{
+			ok = ok && request(fd);
+			::close(fd);
+		}
+		mainLoop.quit();
+	});
+	mainLoop.loop();
+	client.join();
+
+	printf("connections after rebalance: %d %d\n", connections[0], connections[1]);
+	assert(ok);
+	assert(balanced(connections));
+	assert(connections[0] + connections[1] == kConnections / 2);
+	printf("MigrationTest passed\n");
+	return 0;
+}
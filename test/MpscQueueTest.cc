@@ -0,0 +1,98 @@
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "MpscQueue.h"
+
+using namespace webserver;
+
+// 多个生产者并发入队，单个消费者取出
+// 每个生产者的元素保持入队顺序，且不丢失、不重复
+
+struct Item : MpscNode
+{
+	int producer;
+	int seq;
+};
+
+static const int kProducers = 4;
+static const int kItems = 200000;
+
+static void testQueue()
+{
+	MpscQueue queue;
+	std::vector<Item> items(kProducers * kItems);
+	std::atomic<bool> start(false);
+
+	std::vector<std::thread> producers;
+	for(int p=0; p<kProducers; ++p)
+	{
+		producers.emplace_back([&, p]() {
+			while(!start.load()) {}
+			for(int i=0; i<kItems; ++i)
+			{
+				Item &item = items[p * kItems + i];
+				item.producer = p;
+				item.seq = i;
+				queue.push(&item);
+			}
+		});
+	}
+
+	start = true;
+	std::vector<int> next(kProducers, 0);
+	int received = 0;
+	while(received < kProducers * kItems)
+	{
+		MpscNode *node = queue.pop();
+		if(node == nullptr) continue;
+
+		Item *item = static_cast<Item *>(node);
+		assert(item->seq == next[item->producer]);
+		++next[item->producer];
+		++received;
+	}
+
+	for(auto &t : producers) t.join();
+	assert(queue.pop() == nullptr);
+	assert(queue.empty());
+	printf("queue: %d items from %d producers in order\n", received, kProducers);
+}
+
+// 其他线程大量queueInLoop，回调全部执行，且eventfd写入被合并
+static void testQueueInLoop()
+{
+	EventLoopThread thread;
+	EventLoop *loop = thread.startLoop();
+
+	std::atomic<int> executed(0);
+	std::vector<std::thread> producers;
+	for(int p=0; p<kProducers; ++p)
+	{
+		producers.emplace_back([&]() {
+			for(int i=0; i<kItems / 10; ++i)
+			{
+				loop->queueInLoop([&]() { ++executed; });
+			}
+		});
+	}
+	for(auto &t : producers) t.join();
+
+	while(executed.load() < kProducers * kItems / 10)
+	{
+		std::this_thread::yield();
+	}
+	printf("queueInLoop: %d functors executed\n", executed.load());
+}
+
+int main()
+{
+	testQueue();
+	testQueueInLoop();
+	printf("MpscQueueTest passed\n");
+	return 0;
+}
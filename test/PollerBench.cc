@@ -0,0 +1,159 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "EventLoop.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+#include "IoUringPoller.h"
+#include "Poller.h"
+
+using namespace webserver;
+
+// 同一负载下比较epoll与io_uring后端
+// 每个后端在子进程中启动服务器，父进程用keep-alive连接压测/hello
+// 需在build/test下运行，与mainTest相同
+// PollerBench [连接数] [秒数]
+
+static const int kServerThreads = 2;
+static const char kRequest[] = "GET /hello HTTP/1.1\r\nHost: bench\r\n\r\n";
+
+static std::atomic<bool> g_stop(false);
+static std::atomic<long> g_responses(0);
+
+static int connectTo(uint16_t port)
+{
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	int one = 1;
+	::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if(::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0)
+	{
+		::close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* 每个连接只有一个请求在途，读到数据即视为一个应答 */
+static void client(uint16_t port, int conns)
+{
+	int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+	std::vector<int> fds;
+	for(int i=0; i<conns; ++i)
+	{
+		int fd = connectTo(port);
+		if(fd < 0) continue;
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+		::write(fd, kRequest, sizeof(kRequest)-1);
+		fds.push_back(fd);
+	}
+
+	char buf[4096];
+	struct epoll_event events[64];
+	long responses = 0;
+	while(!g_stop.load(std::memory_order_relaxed))
+	{
+		int n = ::epoll_wait(epfd, events, 64, 100);
+		for(int i=0; i<n; ++i)
+		{
+			int fd = events[i].data.fd;
+			if(::read(fd, buf, sizeof(buf)) <= 0) continue;
+			++responses;
+			::write(fd, kRequest, sizeof(kRequest)-1);
+		}
+	}
+
+	g_responses += responses;
+	for(int fd : fds) ::close(fd);
+	::close(epfd);
+}
+
+static void runServer(Poller::Backend backend, uint16_t port)
+{
+	Poller::setDefaultBackend(backend);
+	EventLoop loop;
+	HttpServer server(&loop, InetAddress(port), kServerThreads);
+	server.start();
+	loop.loop();
+}
+
+static double measure(Poller::Backend backend, uint16_t port, int conns, int seconds)
+{
+	/* 避免子进程重复输出缓冲区中的内容 */
+	fflush(stdout);
+	pid_t pid = ::fork();
+	if(pid == 0)
+	{
+		/* 子进程的输出不影响结果 */
+		FILE *null = ::freopen("/dev/null", "w", stdout);
+		(void)null;
+		runServer(backend, port);
+		::_exit(0);
+	}
+
+	/* 等待服务器开始监听 */
+	for(int i=0; i<50; ++i)
+	{
+		int fd = connectTo(port);
+		if(fd >= 0)
+		{
+			::close(fd);
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	g_stop = false;
+	g_responses = 0;
+	std::thread t(client, port, conns);
+	std::this_thread::sleep_for(std::chrono::seconds(seconds));
+	g_stop = true;
+	t.join();
+
+	::kill(pid, SIGKILL);
+	::waitpid(pid, nullptr, 0);
+	return static_cast<double>(g_responses.load()) / seconds;
+}
+
+int main(int argc, char *argv[])
+{
+	int conns = argc > 1 ? atoi(argv[1]) : 64;
+	int seconds = argc > 2 ? atoi(argv[2]) : 3;
+
+	if(!IoUringPoller::available())
+	{
+		printf("io_uring unavailable, comparing epoll with its fallback\n");
+	}
+
+	double epoll = measure(Poller::kEpoll, 8081, conns, seconds);
+	printf("%-10s %10.0f req/s\n", Poller::backendName(Poller::kEpoll), epoll);
+
+	double uring = measure(Poller::kIoUring, 8082, conns, seconds);
+	printf("%-10s %10.0f req/s\n", Poller::backendName(Poller::kIoUring), uring);
+
+	printf("io_uring/epoll: %.2f\n", epoll > 0 ? uring / epoll : 0.0);
+	return 0;
+}
@@ -0,0 +1,153 @@
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "EventLoop.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+#include "Poller.h"
+
+using namespace webserver;
+
+// POST请求体交付给处理者：不超过MAX_HTTPBODYINLINE时以连续视图交付，超过时逐段交付
+// 应答中报告处理者收到的字节数与FNV-1a摘要，与客户端计算的结果比较
+// Content-Length与chunked各测一次小请求体与大请求体
+// PostBodyTest [epoll|io_uring]
+
+static const uint16_t kPort = 8100;
+static const size_t kSmall = 1000;
+static const size_t kLarge = 200 * 1024;
+
+static int connectTo(uint16_t port)
+{
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0)
+	{
+		::close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static std::string makeBody(size_t n)
+{
+	std::string body(n, '\0');
+	for(size_t i=0; i<n; ++i)
+	{
+		body[i] = static_cast<char>('a' + (i * 7 + i / 13) % 26);
+	}
+	return body;
+}
+
+static uint32_t fnv1a(const std::string &data)
+{
+	uint32_t digest = 2166136261u;
+	for(unsigned char c : data)
+	{
+		digest = (digest ^ c) * 16777619u;
+	}
+	return digest;
+}
+
+static std::string chunked(const std::string &data, size_t chunkSize)
+{
+	std::string out;
+	char line[32];
+	for(size_t i=0; i<data.size(); i+=chunkSize)
+	{
+		size_t n = std::min(chunkSize, data.size() - i);
+		snprintf(line, sizeof(line), "%zx\r\n", n);
+		out += line + data.substr(i, n) + "\r\n";
+	}
+	return out + "0\r\n\r\n";
+}
+
+static bool writeAll(int fd, const std::string &data)
+{
+	size_t sent = 0;
+	while(sent < data.size())
+	{
+		ssize_t n = ::write(fd, data.data() + sent, data.size() - sent);
+		if(n <= 0) return false;
+		sent += n;
+	}
+	return true;
+}
+
+/* 发送一个POST请求，返回处理者报告的结果是否与请求体一致 */
+static bool post(const std::string &body, bool useChunked)
+{
+	int fd = connectTo(kPort);
+	if(fd < 0) return false;
+
+	std::string req("POST /hello HTTP/1.1\r\nConnection: close\r\n");
+	if(useChunked)
+	{
+		req += "Transfer-Encoding: chunked\r\n\r\n";
+		req += chunked(body, 4096);
+	}
+	else
+	{
+		req += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+		req += body;
+	}
+	bool sent = writeAll(fd, req);
+
+	std::string resp;
+	char buf[4096];
+	ssize_t r;
+	while((r = ::read(fd, buf, sizeof(buf))) > 0) resp.append(buf, r);
+	::close(fd);
+
+	char expect[64];
+	snprintf(expect, sizeof(expect), " %zu bytes fnv1a %08x",
+	         body.size(), static_cast<unsigned>(fnv1a(body)));
+	bool ok = sent && resp.compare(0, 15, "HTTP/1.1 200 OK") == 0 &&
+	          resp.find(expect) != std::string::npos;
+	printf("%s %zu bytes: %s\n", useChunked ? "chunked" : "length ", body.size(),
+	       ok ? "ok" : resp.c_str());
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	Poller::Backend backend = Poller::kEpoll;
+	if(argc > 1 && Poller::parseBackend(argv[1], &backend))
+	{
+		Poller::setDefaultBackend(backend);
+	}
+
+	EventLoop mainLoop;
+	/* HttpServer不支持在运行后析构，进程退出时直接回收 */
+	HttpServer *server = new HttpServer(&mainLoop, InetAddress(kPort), 2);
+	server->start();
+
+	int ok = 0;
+	std::thread client([&]() {
+		ok += post(makeBody(kSmall), false);
+		ok += post(makeBody(kLarge), false);
+		ok += post(makeBody(kSmall), true);
+		ok += post(makeBody(kLarge), true);
+		ok += post(std::string(), false);
+		mainLoop.quit();
+	});
+	mainLoop.loop();
+	client.join();
+
+	assert(ok == 5);
+	printf("PostBodyTest passed\n");
+	return 0;
+}
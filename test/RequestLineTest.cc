@@ -0,0 +1,110 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "EventLoop.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+#include "Poller.h"
+
+using namespace webserver;
+
+// 请求行解析：方法与版本直接解析为枚举，未知的方法与版本应答400，不再当作GET处理
+// 路径只记录在接收缓冲区中的偏移，同一连接上流水线的多个请求各自使用自己的路径
+// RequestLineTest [epoll|io_uring]
+
+static const uint16_t kPort = 8102;
+
+static int connectTo(uint16_t port)
+{
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0)
+	{
+		::close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* 发送原始请求，读到连接关闭为止 */
+static std::string exchange(const std::string &req)
+{
+	int fd = connectTo(kPort);
+	if(fd < 0) return std::string();
+
+	ssize_t n = ::write(fd, req.data(), req.size());
+	(void)n;
+
+	std::string resp;
+	char buf[4096];
+	ssize_t r;
+	while((r = ::read(fd, buf, sizeof(buf))) > 0) resp.append(buf, r);
+	::close(fd);
+	return resp;
+}
+
+/* 应答的状态行以status开头 */
+static bool expect(const char *req, const char *status)
+{
+	std::string resp = exchange(std::string(req) + "Connection: close\r\n\r\n");
+	bool ok = resp.compare(0, strlen(status), status) == 0;
+	printf("%-28.*s -> %s\n", static_cast<int>(strcspn(req, "\r")), req,
+	       ok ? status : resp.substr(0, resp.find('\r')).c_str());
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	Poller::Backend backend = Poller::kEpoll;
+	if(argc > 1 && Poller::parseBackend(argv[1], &backend))
+	{
+		Poller::setDefaultBackend(backend);
+	}
+
+	EventLoop mainLoop;
+	/* HttpServer不支持在运行后析构，进程退出时直接回收 */
+	HttpServer *server = new HttpServer(&mainLoop, InetAddress(kPort), 1);
+	server->start();
+
+	int failed = 0;
+	std::thread client([&]() {
+		failed += !expect("GET /hello HTTP/1.1\r\n", "HTTP/1.1 200 OK");
+		failed += !expect("HEAD /hello HTTP/1.0\r\n", "HTTP/1.1 200 OK");
+		failed += !expect("PUT /hello HTTP/1.1\r\n", "HTTP/1.1 400");
+		failed += !expect("GETX /hello HTTP/1.1\r\n", "HTTP/1.1 400");
+		failed += !expect("get /hello HTTP/1.1\r\n", "HTTP/1.1 400");
+		failed += !expect("GET /hello HTTP/2.0\r\n", "HTTP/1.1 400");
+		failed += !expect("GET /hello HTTP/1.1x\r\n", "HTTP/1.1 400");
+		failed += !expect("GET hello HTTP/1.1\r\n", "HTTP/1.1 400");
+		failed += !expect("GET  HTTP/1.1\r\n", "HTTP/1.1 400");
+
+		/* 流水线：第二个请求的路径偏移相对取走第一个请求后的缓冲区 */
+		std::string resp = exchange("GET /nope HTTP/1.1\r\n\r\n"
+		                            "GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+		size_t second = resp.find("HTTP/1.1 ", 1);
+		bool ok = resp.compare(0, 13, "HTTP/1.1 404 ") == 0 && second != std::string::npos &&
+		          resp.compare(second, 15, "HTTP/1.1 200 OK") == 0;
+		printf("pipelined /nope, /hello      -> %s\n", ok ? "404, 200" : resp.c_str());
+		failed += !ok;
+
+		mainLoop.quit();
+	});
+	mainLoop.loop();
+	client.join();
+
+	assert(failed == 0);
+	printf("RequestLineTest passed\n");
+	return 0;
+}
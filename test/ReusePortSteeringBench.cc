@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <linux/perf_event.h>
+#include <netinet/in.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "CpuPlacement.h"
+#include "EventLoop.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+
+using namespace webserver;
+
+// reusePort模式下比较三种连接分配：内核哈希、cBPF按CPU、SO_INCOMING_CPU
+// 第i个I/O线程与第i个客户端线程绑定在同一个CPU上，客户端每个请求新建一个连接，
+// 回环上SYN的软中断在客户端的CPU上处理，按CPU分配时连接留在该CPU上
+// 报告短连接请求的p50/p99延迟，以及服务器I/O线程的cache miss(perf_event不可用时为n/a)
+// 单CPU的机器上三者没有区别；多队列网卡或veth上由RSS决定收包的CPU
+// 需在build/test下运行，与mainTest相同
+// ReusePortSteeringBench [秒数] [线程数]
+
+static const char kRequest[] = "GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n";
+
+static std::atomic<bool> g_stop(false);
+
+static void bindTo(int cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	::sched_setaffinity(0, sizeof(set), &set);
+}
+
+static int connectTo(uint16_t port)
+{
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0)
+	{
+		::close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* 当前线程的cache miss计数器，先计入内核态，不允许时只计用户态 */
+static int openCacheMissCounter()
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.exclude_hv = 1;
+	int fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+	if(fd < 0)
+	{
+		attr.exclude_kernel = 1;
+		fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+	}
+	return fd;
+}
+
+/* 子进程：运行服务器，seconds秒后把各I/O线程的cache miss之和写入管道 */
+static void runServer(uint16_t port, const std::vector<int> &cpus,
+                      HttpServer::Steering steering, double seconds, int out)
+{
+	EventLoop loop;
+	HttpServer server(&loop, InetAddress(port), static_cast<int>(cpus.size()), true);
+
+	std::atomic<size_t> nextSlot(0);
+	std::vector<int> counters(cpus.size(), -1);
+	server.setThreadInitCallback([&](EventLoop *) {
+		size_t slot = nextSlot++;
+		bindTo(cpus[slot]);
+		counters[slot] = openCacheMissCounter();
+	});
+	server.setSteering(steering);
+	server.start();
+
+	loop.runAfter(seconds, [&]() {
+		long long misses = 0;
+		for(int fd : counters)
+		{
+			long long value = 0;
+			if(fd < 0 || ::read(fd, &value, sizeof(value)) != sizeof(value))
+			{
+				misses = -1;
+				break;
+			}
+			misses += value;
+		}
+		ssize_t n = ::write(out, &misses, sizeof(misses));
+		(void)n;
+		::_exit(0);
+	});
+	loop.loop();
+}
+
+/* 每个请求：连接、发送、读到对端关闭 */
+static void client(uint16_t port, int cpu, std::vector<int> *latencies)
+{
+	bindTo(cpu);
+	char buf[1024];
+	while(!g_stop.load(std::memory_order_relaxed))
+	{
+		auto start = std::chrono::steady_clock::now();
+		int fd = connectTo(port);
+		if(fd < 0) continue;
+		ssize_t n = ::write(fd, kRequest, sizeof(kRequest)-1);
+		(void)n;
+		while(::read(fd, buf, sizeof(buf)) > 0) {}
+		::close(fd);
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - start).count();
+		latencies->push_back(static_cast<int>(us));
+	}
+}
+
+static void measure(const char *name, HttpServer::Steering steering, uint16_t port,
+                    const std::vector<int> &cpus, int seconds)
+{
+	int fds[2];
+	if(::pipe(fds) < 0) return ;
+
+	fflush(stdout);
+	pid_t pid = ::fork();
+	if(pid == 0)
+	{
+		::close(fds[0]);
+		FILE *null = ::freopen("/dev/null", "w", stdout);
+		(void)null;
+		/* 多留一秒给服务器启动 */
+		runServer(port, cpus, steering, seconds + 1.0, fds[1]);
+		::_exit(0);
+	}
+	::close(fds[1]);
+
+	for(int i=0; i<50; ++i)
+	{
+		int fd = connectTo(port);
+		if(fd >= 0)
+		{
+			::close(fd);
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	g_stop = false;
+	std::vector<std::vector<int>> latencies(cpus.size());
+	std::vector<std::thread> threads;
+	for(size_t i=0; i<cpus.size(); ++i)
+	{
+		threads.emplace_back(client, port, cpus[i], &latencies[i]);
+	}
+	std::this_thread::sleep_for(std::chrono::seconds(seconds));
+	g_stop = true;
+	for(auto &t : threads) t.join();
+
+	long long misses = -1;
+	if(::read(fds[0], &misses, sizeof(misses)) != sizeof(misses)) misses = -1;
+	::close(fds[0]);
+	::kill(pid, SIGKILL);
+	::waitpid(pid, nullptr, 0);
+
+	std::vector<int> all;
+	for(auto &v : latencies) all.insert(all.end(), v.begin(), v.end());
+	if(all.empty())
+	{
+		printf("%-8s no responses\n", name);
+		return ;
+	}
+	std::sort(all.begin(), all.end());
+	int p50 = all[all.size() / 2];
+	int p99 = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+
+	char missText[32];
+	if(misses < 0) snprintf(missText, sizeof(missText), "n/a");
+	else snprintf(missText, sizeof(missText), "%.1f", static_cast<double>(misses) / all.size());
+	printf("%-8s %8.0f req/s  p50 %5d us  p99 %5d us  misses/req %s\n", name,
+	       static_cast<double>(all.size()) / seconds, p50, p99, missText);
+}
+
+int main(int argc, char *argv[])
+{
+	int seconds = argc > 1 ? atoi(argv[1]) : 3;
+	size_t threads = argc > 2 ? static_cast<size_t>(atoi(argv[2])) : 4;
+
+	std::vector<int> cpus = CpuPlacement::currentAffinity();
+	if(cpus.size() > threads) cpus.resize(threads);
+	printf("%zu loops on cpus", cpus.size());
+	for(int cpu : cpus) printf(" %d", cpu);
+	printf("\n");
+
+	measure("hash", HttpServer::kSteerHash, 8095, cpus, seconds);
+	measure("cbpf", HttpServer::kSteerCpuFilter, 8096, cpus, seconds);
+	measure("incpu", HttpServer::kSteerIncomingCpu, 8097, cpus, seconds);
+	return 0;
+}
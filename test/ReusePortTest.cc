@@ -0,0 +1,118 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <sched.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "CpuPlacement.h"
+#include "EventLoop.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+
+using namespace webserver;
+
+// reusePort模式：每个I/O线程各有一个监听套接字
+// 短连接全部得到应答，且由内核分到了多个监听套接字
+// 按CPU分配时，I/O线程与客户端都绑定在同一个CPU上，连接全部交给第一个监听套接字
+// (回环上的收包软中断在发送方的CPU上处理)
+
+static const uint16_t kPort = 8093;
+static const uint16_t kSteeredPort = 8094;
+static const int kThreads = 3;
+static const int kConnections = 300;
+
+static void bindTo(int cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	int ret = ::sched_setaffinity(0, sizeof(set), &set);
+	assert(ret == 0);
+	(void)ret;
+}
+
+static bool request(uint16_t port)
+{
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	const char req[] = "GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n";
+	ssize_t n = ::write(fd, req, sizeof(req) - 1);
+	(void)n;
+
+	char buf[1024];
+	size_t len = 0;
+	ssize_t r;
+	while((r = ::read(fd, buf + len, sizeof(buf) - 1 - len)) > 0) len += r;
+	buf[len] = '\0';
+	::close(fd);
+	return strncmp(buf, "HTTP/1.1 200 OK", 15) == 0;
+}
+
+int main()
+{
+	EventLoop mainLoop;
+	/* HttpServer不支持在运行后析构，进程退出时直接回收 */
+	HttpServer *server = new HttpServer(&mainLoop, InetAddress(kPort), kThreads, true);
+	server->start();
+
+	const int cpu = CpuPlacement::currentAffinity().front();
+	HttpServer *steered = new HttpServer(&mainLoop, InetAddress(kSteeredPort), kThreads, true);
+	steered->setThreadInitCallback([cpu](EventLoop *) { bindTo(cpu); });
+	steered->setSteering(HttpServer::kSteerCpuFilter);
+	steered->start();
+
+	int ok = 0;
+	int steeredOk = 0;
+	std::thread client([&]() {
+		for(int i=0; i<kConnections; ++i)
+		{
+			ok += request(kPort);
+		}
+		bindTo(cpu);
+		for(int i=0; i<kConnections; ++i)
+		{
+			steeredOk += request(kSteeredPort);
+		}
+		mainLoop.quit();
+	});
+	mainLoop.loop();
+	client.join();
+
+	std::vector<uint64_t> accepted = server->acceptedPerAcceptor();
+	assert(accepted.size() == kThreads);
+	uint64_t total = 0;
+	int used = 0;
+	for(size_t i=0; i<accepted.size(); ++i)
+	{
+		printf("acceptor %zu: %llu connections\n", i, static_cast<unsigned long long>(accepted[i]));
+		total += accepted[i];
+		used += accepted[i] > 0;
+	}
+	assert(ok == kConnections);
+	assert(total == kConnections);
+	assert(used >= 2);
+
+	accepted = steered->acceptedPerAcceptor();
+	printf("steered to cpu %d: %llu/%d connections on acceptor 0\n", cpu,
+	       static_cast<unsigned long long>(accepted[0]), kConnections);
+	assert(steeredOk == kConnections);
+	assert(accepted[0] == kConnections);
+	printf("ReusePortTest passed\n");
+	return 0;
+}
@@ -0,0 +1,141 @@
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "SmallFunction.h"
+
+using namespace webserver;
+
+// 统计全部线程的堆分配次数
+// operator new/delete成对替换为malloc/free
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+static std::atomic<long> g_allocations(0);
+
+void *operator new(size_t size)
+{
+	++g_allocations;
+	void *p = malloc(size == 0 ? 1 : size);
+	if(p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static void testSmallFunction()
+{
+	int calls = 0;
+	SmallFunction<void ()> empty;
+	assert(!empty);
+
+	/* 小对象存放在内部 */
+	long before = g_allocations;
+	SmallFunction<int (int)> add([&calls](int x) { ++calls; return x + 1; });
+	assert(g_allocations == before);
+	assert(add(41) == 42);
+
+	/* 移动后原对象为空 */
+	SmallFunction<int (int)> moved(std::move(add));
+	assert(!add && moved);
+	assert(moved(1) == 2 && calls == 2);
+
+	/* 大对象退回堆上 */
+	char big[128] = "big";
+	before = g_allocations;
+	SmallFunction<size_t ()> heap([big]() { return std::string(big).size(); });
+	assert(g_allocations == before + 1);
+	SmallFunction<size_t ()> heapMoved;
+	heapMoved = std::move(heap);
+	assert(!heap && heapMoved() == 3);
+
+	/* 析构被捕获的对象 */
+	std::shared_ptr<int> counted(new int(7));
+	{
+		SmallFunction<int ()> holder([counted]() { return *counted; });
+		assert(counted.use_count() == 2 && holder() == 7);
+	}
+	assert(counted.use_count() == 1);
+
+	void (*nullFunc)() = nullptr;
+	SmallFunction<void ()> fromNull(nullFunc);
+	assert(!fromNull);
+
+	printf("SmallFunction: sizeof=%zu\n", sizeof(SmallFunction<void ()>));
+}
+
+// 与HttpServer::newConnection投递连接的回调形状相同：
+// std::bind(&EventLoop::addHttpConnection, loop, handler)
+struct Connection
+{
+	int fd;
+};
+
+struct Acceptor
+{
+	std::atomic<int> accepted;
+
+	Acceptor() : accepted(0) {}
+	void addConnection(std::shared_ptr<Connection> conn) { accepted += conn->fd > 0; }
+};
+
+static const int kConnections = 512;
+
+static long dispatch(EventLoop *loop, Acceptor &acceptor,
+                     std::vector<std::shared_ptr<Connection>> &conns)
+{
+	int target = acceptor.accepted + static_cast<int>(conns.size());
+	long before = g_allocations;
+	for(auto &conn : conns)
+	{
+		loop->queueInLoop(std::bind(&Acceptor::addConnection, &acceptor, conn));
+	}
+	while(acceptor.accepted < target)
+	{
+		std::this_thread::yield();
+	}
+	return g_allocations - before;
+}
+
+static void testDispatch()
+{
+	EventLoopThread thread;
+	EventLoop *loop = thread.startLoop();
+
+	Acceptor acceptor;
+	std::vector<std::shared_ptr<Connection>> conns;
+	for(int i=0; i<kConnections; ++i)
+	{
+		conns.emplace_back(new Connection{i+1});
+	}
+
+	/* 预热：线程局部数据等一次性分配 */
+	dispatch(loop, acceptor, conns);
+	long allocations = dispatch(loop, acceptor, conns);
+	printf("dispatch: %d connections, %ld allocations\n", kConnections, allocations);
+	assert(allocations == 0);
+
+	/* 对比：std::function无法内联存放该回调 */
+	long before = g_allocations;
+	{
+		std::function<void ()> f(std::bind(&Acceptor::addConnection, &acceptor, conns[0]));
+		f();
+	}
+	printf("std::function: %ld allocations per callback\n", g_allocations - before);
+}
+
+int main()
+{
+	testSmallFunction();
+	testDispatch();
+	printf("SmallFunctionTest passed\n");
+	return 0;
+}
@@ -0,0 +1,116 @@
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "EventLoop.h"
+#include "TimerQueue.h"
+
+using namespace webserver;
+
+// 一个事件循环内：
+// 1. 乱序加入的一次性定时器按截止时间触发
+// 2. 取消的定时器不触发，墓碑被清理
+// 3. 周期定时器在回调中取消自身
+// 4. 大量加入/取消的开销
+
+static EventLoop *g_loop;
+static const int kOrdered = 200;
+
+static std::vector<int> g_fired;
+static int g_periodic = 0;
+static TimerId g_periodicId = 0;
+static int g_canceledFired = 0;
+static Timestamp g_start;
+
+static void checkOrder()
+{
+	assert(static_cast<int>(g_fired.size()) == kOrdered);
+	for(int i=1; i<kOrdered; ++i)
+	{
+		assert(g_fired[i-1] <= g_fired[i]);
+	}
+	assert(g_periodic == 5);
+	assert(g_canceledFired == 0);
+	assert(TimerQueue::now() - g_start >= 200 * 1000);
+
+	const TimerQueue &queue = g_loop->timerQueue();
+	printf("ordered: %d timers fired in deadline order, periodic fired %d times\n",
+	       kOrdered, g_periodic);
+	printf("live=%zu tombstones=%zu timerfd arms=%llu\n", queue.size(), queue.tombstones(),
+	       static_cast<unsigned long long>(queue.timerfdArms()));
+	g_loop->quit();
+}
+
+static void onPeriodic()
+{
+	if(++g_periodic == 5)
+	{
+		g_loop->cancel(g_periodicId);
+		/* 重复取消无影响 */
+		g_loop->cancel(g_periodicId);
+	}
+}
+
+static void benchAddCancel()
+{
+	const int kTimers = 1000000;
+	std::vector<TimerId> ids(kTimers);
+	const size_t base = g_loop->timerQueue().size();
+
+	auto begin = std::chrono::steady_clock::now();
+	for(int i=0; i<kTimers; ++i)
+	{
+		ids[i] = g_loop->runAfter(60 + (i % 1000) * 0.001, []() { ++g_canceledFired; });
+	}
+	auto added = std::chrono::steady_clock::now();
+	for(int i=0; i<kTimers; ++i)
+	{
+		g_loop->cancel(ids[i]);
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	assert(g_loop->timerQueue().size() == base);
+	double addNs = std::chrono::duration<double, std::nano>(added - begin).count() / kTimers;
+	double cancelNs = std::chrono::duration<double, std::nano>(end - added).count() / kTimers;
+	printf("bench: %d timers, add %.1f ns, cancel %.1f ns, tombstones left %zu\n",
+	       kTimers, addNs, cancelNs, g_loop->timerQueue().tombstones());
+}
+
+int main()
+{
+	EventLoop loop;
+	g_loop = &loop;
+
+	benchAddCancel();
+	g_start = TimerQueue::now();
+
+	srand(1);
+	for(int i=0; i<kOrdered; ++i)
+	{
+		int ms = rand() % 100;
+		loop.runAfter(ms * 0.001, [ms]() { g_fired.push_back(ms); });
+	}
+
+	/* 一半取消，另一半在触发前取消 */
+	std::vector<TimerId> canceled;
+	for(int i=0; i<100; ++i)
+	{
+		canceled.push_back(loop.runAfter(0.05, []() { ++g_canceledFired; }));
+	}
+	for(int i=0; i<50; ++i)
+	{
+		loop.cancel(canceled[i]);
+	}
+	loop.runAfter(0.01, [&canceled]() {
+		for(int i=50; i<100; ++i) g_loop->cancel(canceled[i]);
+	});
+
+	g_periodicId = loop.runEvery(0.02, onPeriodic);
+	loop.runAt(g_start + 200 * 1000, checkOrder);
+
+	loop.loop();
+	printf("TimerQueueTest passed\n");
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include <sys/time.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "TimingWheel.h"
+
+using namespace webserver;
+
+// 模拟空闲连接的KeepAlive超时，时间为虚拟时钟
+// 1. 全部连接加入，随后每个刻度刷新其中一部分
+// 2. 停止刷新，全部连接到期，检查到期时间最多晚一个刻度
+// 与原先的std::list + 哈希表(每次刷新erase再insert一个节点)对比刷新的开销
+
+static const Timestamp kTick = 1000000;
+static const Timestamp kTimeout = 120 * kTick;
+static const int kRefreshTicks = 60;
+
+static double nsSince(std::chrono::steady_clock::time_point begin, size_t ops)
+{
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - begin).count() / ops;
+}
+
+static void benchWheel(size_t connections)
+{
+	std::vector<TimingWheelNode> nodes(connections);
+	Timestamp now = 0;
+	TimingWheel wheel(kTick, 256, now);
+
+	size_t expired = 0;
+	Timestamp maxLate = 0;
+	wheel.setExpireCallback([&](TimingWheelNode *node) {
+		++expired;
+		Timestamp late = now - node->expireAt;
+		assert(late >= 0);
+		if(late > maxLate) maxLate = late;
+	});
+
+	auto begin = std::chrono::steady_clock::now();
+	for(size_t i=0; i<connections; ++i)
+	{
+		wheel.refresh(&nodes[i], now + kTimeout);
+	}
+	double insertNs = nsSince(begin, connections);
+
+	/* 每个刻度刷新1/8的连接，刻度内的时间均匀分布 */
+	size_t refreshes = 0;
+	size_t next = 0;
+	begin = std::chrono::steady_clock::now();
+	for(int t=0; t<kRefreshTicks; ++t)
+	{
+		for(size_t i=0; i<connections/8; ++i)
+		{
+			Timestamp at = now + static_cast<Timestamp>(i) * kTick / (connections/8);
+			wheel.refresh(&nodes[next], at + kTimeout);
+			next = (next + 7919) % connections;
+			++refreshes;
+		}
+		now += kTick;
+		wheel.advance(now);
+	}
+	double refreshNs = nsSince(begin, refreshes);
+	assert(expired == 0);
+	assert(wheel.size() == connections);
+
+	/* 不再刷新，等待全部到期 */
+	begin = std::chrono::steady_clock::now();
+	int ticks = 0;
+	while(wheel.size() > 0)
+	{
+		now += kTick;
+		wheel.advance(now);
+		++ticks;
+	}
+	double expireNs = nsSince(begin, connections);
+
+	assert(expired == connections);
+	assert(maxLate <= kTick);
+	printf("wheel  %7zu conns: insert %.1f ns, refresh %.1f ns, expire %.1f ns/conn "
+	       "over %d ticks, rebuckets %llu, max late %lld ms\n",
+	       connections, insertNs, refreshNs, expireNs, ticks,
+	       static_cast<unsigned long long>(wheel.rebuckets()),
+	       static_cast<long long>(maxLate / 1000));
+}
+
+// 原先的做法：按刷新顺序排列的链表，刷新时erase再在尾部insert
+static void benchList(size_t connections)
+{
+	typedef std::pair<int, struct timeval> Entry;
+	std::list<Entry> keepAliveList;
+	std::unordered_map<int, std::list<Entry>::iterator> nodes;
+	nodes.reserve(connections);
+
+	struct timeval tv = { 0, 0 };
+	for(size_t i=0; i<connections; ++i)
+	{
+		int fd = static_cast<int>(i);
+		nodes[fd] = keepAliveList.insert(keepAliveList.end(), std::make_pair(fd, tv));
+	}
+
+	size_t refreshes = 0;
+	size_t next = 0;
+	auto begin = std::chrono::steady_clock::now();
+	for(int t=0; t<kRefreshTicks; ++t)
+	{
+		for(size_t i=0; i<connections/8; ++i)
+		{
+			int fd = static_cast<int>(next);
+			tv.tv_sec = t + kTimeout / kTick;
+			auto it = nodes.find(fd);
+			keepAliveList.erase(it->second);
+			it->second = keepAliveList.insert(keepAliveList.end(), std::make_pair(fd, tv));
+			next = (next + 7919) % connections;
+			++refreshes;
+		}
+	}
+	printf("list   %7zu conns: refresh %.1f ns\n", connections, nsSince(begin, refreshes));
+}
+
+int main()
+{
+	const size_t kConnections[] = { 100000, 1000000 };
+	for(size_t connections : kConnections)
+	{
+		benchWheel(connections);
+		benchList(connections);
+	}
+	printf("TimingWheelBench passed\n");
+	return 0;
+}
@@ -1,19 +1,114 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <unistd.h>
+#include "CpuPlacement.h"
 #include "HttpServer.h"
 #include "EventLoop.h"
 #include "InetAddress.h"
+#include "Poller.h"
 
-/* 6核12线程 */
+/* -t n I/O线程数，默认为放置策略的位置数，未指定策略时为在线CPU数 */
+/* -a cores|numa|cpu列表 I/O线程的CPU与NUMA放置 */
+/* -p epoll|io_uring 选择事件后端 */
+/* -r 每个I/O线程各自监听SO_REUSEPORT套接字并accept */
+/* -d rr|least|p2c 主事件循环accept时的分发策略 */
+/* -m s 每隔s秒把空闲的keep-alive连接从负载最高的I/O线程迁到最低的(epoll) */
+/* -c bpf|cpu reusePort时按收包CPU分配连接(cBPF程序或SO_INCOMING_CPU)，需配合-a */
+/* -b us I/O线程忙轮询的预算上限，-s us 对连接设置SO_BUSY_POLL(需配合-b) */
 int main(int argc, char *argv[])
 {
+	int opt;
+	int numThreads = 0;
+	webserver::CpuPlacement placement;
+	int busyPollUs = 0;
+	int socketBusyPollUs = 0;
+	bool reusePort = false;
+	webserver::HttpServer::Steering steering = webserver::HttpServer::kSteerHash;
+	webserver::EventLoopThreadPool::DispatchPolicy dispatch = webserver::EventLoopThreadPool::kRoundRobin;
+	double rebalanceInterval = 0;
+	while((opt = ::getopt(argc, argv, "t:a:p:rc:d:m:b:s:")) != -1)
+	{
+		if(opt == 'r')
+		{
+			reusePort = true;
+			continue;
+		}
+		if(opt == 'c' && (strcmp(optarg, "bpf") == 0 || strcmp(optarg, "cpu") == 0))
+		{
+			steering = optarg[0] == 'b' ? webserver::HttpServer::kSteerCpuFilter
+			                            : webserver::HttpServer::kSteerIncomingCpu;
+			continue;
+		}
+		if(opt == 't' && atoi(optarg) > 0)
+		{
+			numThreads = atoi(optarg);
+			continue;
+		}
+		if(opt == 'd' && webserver::EventLoopThreadPool::parseDispatchPolicy(optarg, &dispatch))
+		{
+			continue;
+		}
+		if(opt == 'm' && atof(optarg) > 0)
+		{
+			rebalanceInterval = atof(optarg);
+			continue;
+		}
+		if(opt == 'a' && webserver::CpuPlacement::parse(optarg, &placement))
+		{
+			continue;
+		}
+		webserver::Poller::Backend backend;
+		if(opt == 'p' && webserver::Poller::parseBackend(optarg, &backend))
+		{
+			// 必须在创建任何事件循环之前设置
+			webserver::Poller::setDefaultBackend(backend);
+			continue;
+		}
+		if(opt == 'b' || opt == 's')
+		{
+			(opt == 'b' ? busyPollUs : socketBusyPollUs) = atoi(optarg);
+			continue;
+		}
+		std::cerr << "usage: " << argv[0]
+		          << " [-t threads] [-a cores|numa|cpu_list] [-p epoll|io_uring] [-r] [-c bpf|cpu] [-d rr|least|p2c] [-m rebalance_s]"
+		          << " [-b busy_poll_us] [-s socket_busy_poll_us]" << std::endl;
+		return 1;
+	}
+	
+	if(numThreads == 0)
+	{
+		numThreads = placement.slots() > 0 ? static_cast<int>(placement.slots())
+		                                    : static_cast<int>(::sysconf(_SC_NPROCESSORS_ONLN));
+	}
+
 	webserver::InetAddress self_addr(8080);
 
 	//  创建了一个事件循环对象 EventLoop，这是一个通常在异步网络编程中使用的概念，用于处理事件的循环。
 	webserver::EventLoop mainLoop;
 	
 	// 创建了一个 HttpServer 对象，该对象用于处理 HTTP 请求。
-	// 构造函数的参数包括之前创建的事件循环对象 mainLoop，服务器监听的地址 self_addr，以及似乎是服务器的线程池大小（可能是 3 个线程）。
-	webserver::HttpServer server(&mainLoop, self_addr, 12);
+	// 构造函数的参数包括之前创建的事件循环对象 mainLoop，服务器监听的地址 self_addr，以及I/O线程数。
+	webserver::HttpServer server(&mainLoop, self_addr, numThreads, reusePort);
+	server.setSteering(steering);
+	server.setDispatchPolicy(dispatch);
+	server.setRebalanceInterval(rebalanceInterval);
+	
+	// I/O线程依次启动，按启动顺序分配放置位置
+	std::atomic<size_t> nextSlot(0);
+	server.setThreadInitCallback([&](webserver::EventLoop *loop) {
+		size_t slot = nextSlot++;
+		if(placement.policy() != webserver::CpuPlacement::kNone)
+		{
+			placement.bindCurrentThread(slot);
+			std::cout << "loop " << slot << ": " << placement.describe(slot) << std::endl;
+		}
+		if(busyPollUs > 0)
+		{
+			loop->setBusyPoll(busyPollUs, socketBusyPollUs);
+		}
+	});
 	
 	server.start();
 	
@@ -21,4 +116,4 @@ int main(int argc, char *argv[])
 	mainLoop.loop();
 	
 	return 0;
-}
\ No newline at end of file
+}